@@ -0,0 +1,490 @@
+//  This file is part of libBitmapWag.
+//
+//  libBitmapWag is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libBitmapWag is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libBitmapWag.  If not, see <https://www.gnu.org/licenses/>.
+
+// bench.c times the libBitmapWag API across every bit depth and several image
+// sizes and prints the results as JSON. It is built and run by `make bench'.
+
+// clock_gettime needs POSIX
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BitmapWag.h"
+
+// APP_NAME is used for stderr outputs in this program
+// it should be provided by the makefile, if not, it is redfined here.
+#ifndef APP_NAME
+    #define APP_NAME "bitmap-bench"
+#endif
+
+// Bit depths and image sizes that are timed
+static const unsigned bitDepths[] = {1, 2, 4, 8, 16, 24, 32};
+static const unsigned sizes[] = {64, 256, 1024, 4096, 16384};
+
+#define NUM_BIT_DEPTHS (sizeof(bitDepths) / sizeof(bitDepths[0]))
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+// Most trials of one benchmark
+#define MAX_TRIALS 100
+
+// Operations that are timed
+typedef enum {
+    BENCH_INITIALIZE,
+    BENCH_SET_PIXEL,
+    BENCH_GET_PIXEL,
+    BENCH_WRITE,
+    BENCH_READ,
+    NUM_BENCH_OPS
+} BenchOp;
+
+static const char * const opNames[NUM_BENCH_OPS] = {
+    "InitializeBitmapWag",
+    "SetBitmapWagPixel",
+    "GetBitmapWagPixel",
+    "WriteBitmapWag",
+    "ReadBitmapWag"
+};
+
+// Command line settings
+typedef struct {
+    unsigned maxSize;
+    unsigned trials;
+    unsigned warmup;
+    unsigned threads;
+    const char * filePath;
+    const char * outputPath;
+} BenchSettings;
+
+// Colors written to the images, palette images use the first 2^bpp of them
+static BitmapWagRgbQuad colors[256];
+
+// Sum of every pixel read, printed so reads can't be optimized away
+static volatile unsigned long checksum;
+
+/**
+ * @return a monotonic time in seconds
+ */
+static double Now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * Sets every pixel of an image to a repeating pattern of colors
+ *
+ * @param img image to set the pixels of
+ * @param numColors number of colors in the pattern, a power of two
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError SetPixels(BitmapWagImg * img, const unsigned numColors)
+{
+    const unsigned width = GetBitmapWagWidth(img);
+    const unsigned height = GetBitmapWagHeight(img);
+
+    for(unsigned j = 0; j < height; j++)
+    {
+        for(unsigned i = 0; i < width; i++)
+        {
+            const BitmapWagRgbQuad color = colors[(i + j) & (numColors - 1)];
+            BitmapWagError error = SetBitmapWagPixel(img, i, j, color.rgbRed,
+                color.rgbGreen, color.rgbBlue);
+
+            if(error)
+            {
+                return error;
+            }
+        }
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * Gets every pixel of an image
+ *
+ * @param img image to get the pixels of
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError GetPixels(const BitmapWagImg * img)
+{
+    const unsigned width = GetBitmapWagWidth(img);
+    const unsigned height = GetBitmapWagHeight(img);
+    unsigned long sum = 0;
+
+    for(unsigned j = 0; j < height; j++)
+    {
+        for(unsigned i = 0; i < width; i++)
+        {
+            BitmapWagRgbQuad color;
+            BitmapWagError error = GetBitmapWagPixel(img, i, j, &color);
+
+            if(error)
+            {
+                return error;
+            }
+
+            sum += color.rgbRed + color.rgbGreen + color.rgbBlue;
+        }
+    }
+
+    checksum += sum;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * Runs one trial of an operation
+ *
+ * @param op operation to time
+ * @param img image set up for the operation, NULL for BENCH_INITIALIZE and
+ *        BENCH_READ
+ * @param size width and height of the image
+ * @param bitsPerPixel bits per pixel of the image
+ * @param settings command line settings
+ * @param seconds pointer to populate with the time taken by the operation
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError RunTrial(const BenchOp op, BitmapWagImg * img,
+    const unsigned size, const unsigned bitsPerPixel,
+    const BenchSettings * settings, double * seconds)
+{
+    const unsigned numColors = (bitsPerPixel <= 8) ? 1u << bitsPerPixel : 256;
+    BitmapWagImg * newImg = NULL;
+    BitmapWagError error = BITMAPWAG_SUCCESS;
+    double start;
+
+    // Trials that fail before the clock starts take no time
+    *seconds = 0;
+
+    // Construction isn't part of the timed operation
+    if(op == BENCH_INITIALIZE || op == BENCH_READ)
+    {
+        newImg = ConstructBitmapWag();
+
+        if(newImg == NULL)
+        {
+            return BITMAPWAG_NULL;
+        }
+    }
+
+    start = Now();
+
+    switch(op)
+    {
+        case BENCH_INITIALIZE:
+            error = InitializeBitmapWag(newImg, size, size, bitsPerPixel);
+            break;
+        case BENCH_SET_PIXEL:
+            error = SetPixels(img, numColors);
+            break;
+        case BENCH_GET_PIXEL:
+            error = GetPixels(img);
+            break;
+        case BENCH_WRITE:
+            error = WriteBitmapWag(img, settings->filePath);
+            break;
+        case BENCH_READ:
+            error = ReadBitmapWag(newImg, settings->filePath);
+            break;
+        default:
+            break;
+    }
+
+    *seconds = Now() - start;
+
+    if(newImg != NULL)
+    {
+        FreeBitmapWag(newImg);
+    }
+
+    // Not enough memory for the colorUsed array only slows down palette
+    // images, so it doesn't fail the benchmark
+    return (error == BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE) ?
+        BITMAPWAG_SUCCESS : error;
+}
+
+/**
+ * Compares two doubles for qsort
+ */
+static int CompareSeconds(const void * a, const void * b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Times an operation and prints its result as a JSON object
+ *
+ * @param output stream to print the result to
+ * @param op operation to time
+ * @param img image set up for the operation
+ * @param size width and height of the image
+ * @param bitsPerPixel bits per pixel of the image
+ * @param settings command line settings
+ * @param first non-zero if this is the first result printed
+ */
+static void Benchmark(FILE * output, const BenchOp op, BitmapWagImg * img,
+    const unsigned size, const unsigned bitsPerPixel,
+    const BenchSettings * settings, const int first)
+{
+    const double pixels = (double) size * size;
+    // Bytes of image data, rows are padded to four bytes
+    const double bytes = (double) ((((unsigned long long) size * bitsPerPixel
+        + 31) / 32) * 4) * size;
+    // Pixel functions are timed per pixel, everything else per call
+    const double ops = (op == BENCH_SET_PIXEL || op == BENCH_GET_PIXEL) ?
+        pixels : 1;
+    double seconds[MAX_TRIALS];
+    BitmapWagError error = BITMAPWAG_SUCCESS;
+
+    for(unsigned t = 0; t < settings->warmup + settings->trials && !error;
+        t++)
+    {
+        double trialSeconds;
+
+        error = RunTrial(op, img, size, bitsPerPixel, settings,
+            &trialSeconds);
+
+        if(t >= settings->warmup)
+        {
+            seconds[t - settings->warmup] = trialSeconds;
+        }
+    }
+
+    fprintf(output, "%s    {\"op\": \"%s\", \"bpp\": %u, \"width\": %u, "
+        "\"height\": %u, ", first ? "" : ",\n", opNames[op], bitsPerPixel,
+        size, size);
+
+    if(error)
+    {
+        fprintf(output, "\"error\": \"%s\"}", ErrorsToStringBitmapWag(error));
+        fprintf(stderr, "%s: error: %s %u bpp %ux%u: %s.\n", APP_NAME,
+            opNames[op], bitsPerPixel, size, size,
+            ErrorsToStringBitmapWag(error));
+        return;
+    }
+
+    qsort(seconds, settings->trials, sizeof(double), CompareSeconds);
+
+    const double median = (settings->trials & 1) ?
+        seconds[settings->trials / 2] :
+        (seconds[settings->trials / 2 - 1] + seconds[settings->trials / 2])
+        / 2;
+
+    fprintf(output, "\"ops\": %.0f, \"bytes\": %.0f, \"median_s\": %.9f, "
+        "\"min_s\": %.9f, \"max_s\": %.9f, \"ns_per_op\": %.3f, "
+        "\"mpixel_per_s\": %.3f, \"mb_per_s\": %.3f}", ops, bytes, median,
+        seconds[0], seconds[settings->trials - 1], median * 1e9 / ops,
+        pixels / median / 1e6, bytes / median / 1e6);
+}
+
+/**
+ * Prints the command line usage
+ */
+static void Usage(void)
+{
+    fprintf(stderr,
+        "usage: %s [-s max size] [-t trials] [-w warmup] [-j threads] "
+        "[-f file] [-o output]\n"
+        "  -s  largest image width and height, up to 16384 (default 4096)\n"
+        "  -t  timed trials of every benchmark (default 5)\n"
+        "  -w  untimed warmup runs of every benchmark (default 1)\n"
+        "  -j  threads passed to SetBitmapWagThreads, 0 for one per "
+        "processor (default 1)\n"
+        "  -f  bitmap file the read and write benchmarks use "
+        "(default bench.bmp)\n"
+        "  -o  file to write the JSON results to (default stdout)\n",
+        APP_NAME);
+}
+
+/**
+ * Parses the command line
+ *
+ * @return 0 if successful
+ */
+static int ParseArguments(int argc, char ** argv, BenchSettings * settings)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+        {
+            return -1;
+        }
+
+        if(argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0'
+            || i + 1 >= argc)
+        {
+            fprintf(stderr, "%s: error: bad argument %s.\n", APP_NAME,
+                argv[i]);
+            return -1;
+        }
+
+        const char * value = argv[++i];
+
+        switch(argv[i - 1][1])
+        {
+            case 's':
+                settings->maxSize = (unsigned) strtoul(value, NULL, 10);
+                break;
+            case 't':
+                settings->trials = (unsigned) strtoul(value, NULL, 10);
+                break;
+            case 'w':
+                settings->warmup = (unsigned) strtoul(value, NULL, 10);
+                break;
+            case 'j':
+                settings->threads = (unsigned) strtoul(value, NULL, 10);
+                break;
+            case 'f':
+                settings->filePath = value;
+                break;
+            case 'o':
+                settings->outputPath = value;
+                break;
+            default:
+                fprintf(stderr, "%s: error: unknown option %s.\n", APP_NAME,
+                    argv[i - 1]);
+                return -1;
+        }
+    }
+
+    if(settings->trials < 1 || settings->trials > MAX_TRIALS)
+    {
+        fprintf(stderr, "%s: error: trials shall be 1 to %d.\n", APP_NAME,
+            MAX_TRIALS);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Main function is the start of the program
+int main(int argc, char ** argv)
+{
+    BenchSettings settings = {4096, 5, 1, 1, "bench.bmp", NULL};
+    FILE * output = stdout;
+    BitmapWagError error;
+    int first = 1;
+
+    if(ParseArguments(argc, argv, &settings))
+    {
+        Usage();
+        return -1;
+    }
+
+    error = SetBitmapWagThreads(settings.threads);
+
+    if(error)
+    {
+        fprintf(stderr, "%s: error: SetBitmapWagThreads: %s.\n", APP_NAME,
+            ErrorsToStringBitmapWag(error));
+        return -1;
+    }
+
+    if(settings.outputPath != NULL)
+    {
+        output = fopen(settings.outputPath, "w");
+
+        if(output == NULL)
+        {
+            fprintf(stderr, "%s: error: cannot open %s.\n", APP_NAME,
+                settings.outputPath);
+            return -1;
+        }
+    }
+
+    // Distinct colors, 17, 29 and 53 are odd so every channel is a
+    // permutation of 0 to 255
+    for(unsigned i = 0; i < 256; i++)
+    {
+        colors[i] = (BitmapWagRgbQuad){(i * 17) & 0xFF, (i * 29) & 0xFF,
+            (i * 53) & 0xFF, 0};
+    }
+
+    fprintf(output, "{\n  \"library\": \"libBitmapWag\",\n"
+        "  \"version\": \"%u.%u.%u\",\n  \"threads\": %u,\n  \"trials\": %u,\n"
+        "  \"warmup\": %u,\n  \"results\": [\n", MajorVersionBitmapWag(),
+        MinorVersionBitmapWag(), PatchVersionBitmapWag(),
+        GetBitmapWagThreads(), settings.trials, settings.warmup);
+
+    for(unsigned s = 0; s < NUM_SIZES && sizes[s] <= settings.maxSize; s++)
+    {
+        for(unsigned b = 0; b < NUM_BIT_DEPTHS; b++)
+        {
+            const unsigned size = sizes[s];
+            const unsigned bitsPerPixel = bitDepths[b];
+            const unsigned numColors = (bitsPerPixel <= 8) ?
+                1u << bitsPerPixel : 256;
+
+            fprintf(stderr, "%s: info: %u bpp %ux%u\n", APP_NAME,
+                bitsPerPixel, size, size);
+
+            Benchmark(output, BENCH_INITIALIZE, NULL, size, bitsPerPixel,
+                &settings, first);
+            first = 0;
+
+            // The other benchmarks share one image
+            BitmapWagImg * img = ConstructBitmapWag();
+            error = InitializeBitmapWag(img, size, size, bitsPerPixel);
+
+            if(error == BITMAPWAG_SUCCESS
+                || error == BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+            {
+                error = SetPixels(img, numColors);
+            }
+
+            if(error)
+            {
+                fprintf(stderr, "%s: error: %u bpp %ux%u: %s.\n", APP_NAME,
+                    bitsPerPixel, size, size, ErrorsToStringBitmapWag(error));
+                FreeBitmapWag(img);
+                continue;
+            }
+
+            Benchmark(output, BENCH_SET_PIXEL, img, size, bitsPerPixel,
+                &settings, first);
+            Benchmark(output, BENCH_GET_PIXEL, img, size, bitsPerPixel,
+                &settings, first);
+            Benchmark(output, BENCH_WRITE, img, size, bitsPerPixel,
+                &settings, first);
+            Benchmark(output, BENCH_READ, NULL, size, bitsPerPixel,
+                &settings, first);
+
+            FreeBitmapWag(img);
+        }
+    }
+
+    fprintf(output, "\n  ],\n  \"checksum\": %lu\n}\n", checksum);
+
+    if(output != stdout)
+    {
+        fclose(output);
+    }
+
+    remove(settings.filePath);
+
+    return 0;
+}
@@ -0,0 +1,957 @@
+//  This file is part of libBitmapWag.
+//
+//  libBitmapWag is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libBitmapWag is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libBitmapWag.  If not, see <https://www.gnu.org/licenses/>.
+
+// bmpwag.c converts, re-encodes and validates every bitmap in a directory
+// with a pool of worker threads, then prints how long each stage took.
+
+// Directories, threads and clock_gettime need POSIX
+#ifndef _POSIX_C_SOURCE
+    #define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BitmapWag.h"
+
+// APP_NAME is used for stderr outputs in this program
+// it should be provided by the makefile, if not, it is redfined here.
+#ifndef APP_NAME
+    #define APP_NAME "bmpwag"
+#endif
+
+// Most worker threads
+#define MAX_WORKERS 256
+
+// Commands the tool runs on every file
+typedef enum {
+    // Write every file to the output directory, changing its bit depth or
+    // compression when asked to
+    COMMAND_CONVERT,
+    // Read every file and report the ones that can't be read
+    COMMAND_VALIDATE
+} Command;
+
+// Stages of the work done on a file that are timed
+typedef enum {
+    STAGE_READ,
+    STAGE_CONVERT,
+    STAGE_WRITE,
+    NUM_STAGES
+} Stage;
+
+static const char * const stageNames[NUM_STAGES] = {
+    "read",
+    "convert",
+    "write"
+};
+
+// Command line settings
+typedef struct {
+    Command command;
+    // bits per pixel files are converted to, 0 keeps the bits per pixel
+    uint16_t bitsPerPixel;
+    // nonzero if compression was given, otherwise files keep theirs
+    int setCompression;
+    BitmapWagCompression compression;
+    // dithering used when a file has too many colors for its new palette
+    BitmapWagDither dither;
+    unsigned workers;
+    int recursive;
+    const char * inputDir;
+    const char * outputDir;
+} ToolSettings;
+
+// Paths of the files to work on, relative to the input directory
+typedef struct {
+    char ** paths;
+    size_t count;
+    size_t capacity;
+} FileList;
+
+// Time spent in and work done by each stage
+typedef struct {
+    double seconds[NUM_STAGES];
+    unsigned long long files[NUM_STAGES];
+    unsigned long long bytes[NUM_STAGES];
+    unsigned long long pixels[NUM_STAGES];
+} StageTotals;
+
+// A worker thread, its images are reused from file to file
+typedef struct {
+    pthread_t thread;
+    const ToolSettings * settings;
+    const FileList * files;
+    // next file no worker has claimed yet, shared by every worker
+    size_t * nextFile;
+    BitmapWagImg * src;
+    BitmapWagImg * dst;
+    BitmapWagRgbQuad * colors;
+    size_t colorsCapacity;
+    StageTotals totals;
+    unsigned long long ok;
+    unsigned long long failed;
+} Worker;
+
+/**
+ * @return a monotonic time in seconds
+ */
+static double Now(void)
+{
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+/**
+ * @return size of a file in bytes, 0 if it can't be found
+ */
+static unsigned long long FileSize(const char * path)
+{
+    struct stat info;
+
+    return (stat(path, &info) == 0) ? (unsigned long long) info.st_size : 0;
+}
+
+/**
+ * Joins a directory and a relative path
+ *
+ * @return the joined path, which the caller frees, or NULL
+ */
+static char * JoinPath(const char * dir, const char * name)
+{
+    const size_t size = strlen(dir) + strlen(name) + 2;
+    char * path = (char *) malloc(size);
+
+    if(path != NULL)
+    {
+        snprintf(path, size, "%s/%s", dir, name);
+    }
+
+    return path;
+}
+
+/**
+ * @return nonzero if a file name ends with .bmp, in any case
+ */
+static int IsBitmapName(const char * name)
+{
+    const size_t length = strlen(name);
+
+    return length > 4 && strcasecmp(name + length - 4, ".bmp") == 0;
+}
+
+/**
+ * Adds a path to a file list
+ *
+ * @return 0 if successful
+ */
+static int AddFile(FileList * list, char * path)
+{
+    if(list->count == list->capacity)
+    {
+        const size_t capacity = list->capacity ? 2 * list->capacity : 1024;
+        char ** paths = (char **) realloc(list->paths,
+            capacity * sizeof(char *));
+
+        if(paths == NULL)
+        {
+            return -1;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+
+    list->paths[list->count++] = path;
+
+    return 0;
+}
+
+/**
+ * Lists the bitmaps in a directory, creating the matching directory under
+ * the output directory when converting
+ *
+ * @param settings command line settings
+ * @param list list to add the bitmaps to
+ * @param relative directory to list relative to the input directory, "" for
+ *        the input directory itself
+ * @return 0 if successful
+ */
+static int ListFiles(const ToolSettings * settings, FileList * list,
+    const char * relative)
+{
+    char * dirPath = (relative[0] == '\0') ? strdup(settings->inputDir)
+        : JoinPath(settings->inputDir, relative);
+    int retVal = 0;
+
+    if(dirPath == NULL)
+    {
+        return -1;
+    }
+
+    DIR * dir = opendir(dirPath);
+
+    if(dir == NULL)
+    {
+        fprintf(stderr, "%s: error: cannot open directory %s.\n", APP_NAME,
+            dirPath);
+        free(dirPath);
+        return -1;
+    }
+
+    if(settings->command == COMMAND_CONVERT)
+    {
+        char * outPath = (relative[0] == '\0') ? strdup(settings->outputDir)
+            : JoinPath(settings->outputDir, relative);
+
+        if(outPath == NULL || (mkdir(outPath, 0777) != 0 && errno != EEXIST))
+        {
+            fprintf(stderr, "%s: error: cannot create directory %s.\n",
+                APP_NAME, outPath ? outPath : relative);
+            retVal = -1;
+        }
+        free(outPath);
+    }
+
+    for(struct dirent * entry = readdir(dir); entry != NULL && !retVal;
+        entry = readdir(dir))
+    {
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char * path = (relative[0] == '\0') ? strdup(entry->d_name)
+            : JoinPath(relative, entry->d_name);
+        char * fullPath = JoinPath(settings->inputDir, path ? path : "");
+        struct stat info;
+
+        if(path == NULL || fullPath == NULL)
+        {
+            retVal = -1;
+        }
+        else if(stat(fullPath, &info) != 0)
+        {
+            // Broken links and files removed while listing are skipped
+        }
+        else if(S_ISDIR(info.st_mode))
+        {
+            if(settings->recursive)
+            {
+                retVal = ListFiles(settings, list, path);
+            }
+        }
+        else if(S_ISREG(info.st_mode) && IsBitmapName(entry->d_name))
+        {
+            retVal = AddFile(list, path);
+            path = retVal ? path : NULL;
+        }
+
+        free(path);
+        free(fullPath);
+    }
+
+    closedir(dir);
+    free(dirPath);
+
+    return retVal;
+}
+
+/**
+ * Adds time and work to a stage
+ */
+static void AddStage(StageTotals * totals, const Stage stage,
+    const double seconds, const unsigned long long bytes,
+    const unsigned long long pixels)
+{
+    totals->seconds[stage] += seconds;
+    totals->files[stage]++;
+    totals->bytes[stage] += bytes;
+    totals->pixels[stage] += pixels;
+}
+
+/**
+ * Validates a file by reading every row of it. Files the streaming reader
+ * can't read, such as run length encoded files, are read whole.
+ *
+ * @param worker worker validating the file
+ * @param inPath path of the file
+ * @return BITMAPWAG_SUCCESS if the file could be read
+ */
+static BitmapWagError ValidateFile(Worker * worker, const char * inPath)
+{
+    BitmapWagReader * reader = NULL;
+    double start = Now();
+    BitmapWagError error = OpenBitmapWagReader(&reader, inPath, 0);
+    unsigned long long pixels = 0;
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        const uint8_t * rows;
+        uint32_t numRows;
+
+        pixels = (unsigned long long) GetBitmapWagReaderWidth(reader)
+            * GetBitmapWagReaderHeight(reader);
+
+        while((error = NextBitmapWagRows(reader, &rows, &numRows))
+            == BITMAPWAG_SUCCESS)
+        {
+        }
+        if(error == BITMAPWAG_END_OF_IMAGE)
+        {
+            error = BITMAPWAG_SUCCESS;
+        }
+    }
+
+    if(reader != NULL)
+    {
+        CloseBitmapWagReader(reader);
+    }
+
+    if(error == BITMAPWAG_COMPRESSION_NOT_SUPPORTED)
+    {
+        error = ReadBitmapWagInto(worker->src, inPath);
+        pixels = (unsigned long long) GetBitmapWagWidth(worker->src)
+            * GetBitmapWagHeight(worker->src);
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        AddStage(&worker->totals, STAGE_READ, Now() - start,
+            FileSize(inPath), pixels);
+    }
+
+    return error;
+}
+
+/**
+ * Converts a file a batch of rows at a time without holding the image in
+ * memory. This is possible when the file can be streamed, has no channel
+ * masks and either keeps its bits per pixel or is converted to more than 8
+ * bits per pixel, always without compression.
+ *
+ * @param worker worker converting the file
+ * @param inPath path of the file to convert
+ * @param outPath path to write the converted file to
+ * @param streamed pointer to populate with nonzero if the file was streamed,
+ *        zero if it has to be converted whole
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError StreamFile(Worker * worker, const char * inPath,
+    const char * outPath, int * streamed)
+{
+    const ToolSettings * settings = worker->settings;
+    BitmapWagReader * reader = NULL;
+    BitmapWagStream * stream = NULL;
+    BitmapWagInfo info;
+    double readSeconds = 0;
+    double writeSeconds = 0;
+    double start = Now();
+    BitmapWagError error = ReadBitmapWagInfo(inPath, &info);
+
+    // Streams can't write channel masks, files with them are converted whole
+    if(error == BITMAPWAG_SUCCESS && info.masks[0] == 0)
+    {
+        error = OpenBitmapWagReader(&reader, inPath, 0);
+    }
+    else if(error == BITMAPWAG_SUCCESS)
+    {
+        error = BITMAPWAG_MASKS_NOT_SUPPORTED;
+    }
+
+    readSeconds += Now() - start;
+    *streamed = 0;
+
+    if(error)
+    {
+        if(reader != NULL)
+        {
+            CloseBitmapWagReader(reader);
+        }
+        // Let the whole file path read the file and report any error
+        return BITMAPWAG_SUCCESS;
+    }
+
+    const uint32_t width = GetBitmapWagReaderWidth(reader);
+    const uint32_t height = GetBitmapWagReaderHeight(reader);
+    const uint16_t srcBits = GetBitmapWagReaderBitsPerPixel(reader);
+    const uint16_t dstBits = settings->bitsPerPixel ? settings->bitsPerPixel
+        : srcBits;
+    // Images keeping their bits per pixel copy their rows unchanged,
+    // everything else goes through colors
+    const int copyRows = (dstBits == srcBits);
+
+    // Streams write bottom-up, so top-down files are converted whole to keep
+    // their row order
+    if(GetBitmapWagReaderTopDown(reader) || (!copyRows && dstBits <= 8)
+        || (settings->setCompression
+        && settings->compression != BITMAPWAG_COMPRESSION_NONE))
+    {
+        CloseBitmapWagReader(reader);
+        return BITMAPWAG_SUCCESS;
+    }
+
+    *streamed = 1;
+
+    const BitmapWagRgbQuad * palette = NULL;
+    uint32_t numColors = 0;
+
+    if(copyRows && srcBits <= 8)
+    {
+        error = GetBitmapWagReaderPalette(reader, &palette, &numColors);
+    }
+    else if(!copyRows && worker->colorsCapacity < width)
+    {
+        free(worker->colors);
+        worker->colors = (BitmapWagRgbQuad *) malloc(width
+            * sizeof(BitmapWagRgbQuad));
+        worker->colorsCapacity = worker->colors ? width : 0;
+        error = worker->colors ? BITMAPWAG_SUCCESS
+            : BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        start = Now();
+        error = BeginBitmapWagStream(&stream, outPath, height, width, dstBits,
+            palette, numColors);
+        writeSeconds += Now() - start;
+    }
+
+    while(error == BITMAPWAG_SUCCESS)
+    {
+        const uint8_t * rows;
+        uint32_t numRows = 1;
+
+        start = Now();
+        error = copyRows ? NextBitmapWagRows(reader, &rows, &numRows)
+            : NextBitmapWagRowColors(reader, worker->colors);
+        readSeconds += Now() - start;
+
+        if(error)
+        {
+            break;
+        }
+
+        start = Now();
+        error = copyRows ? PushBitmapWagRows(stream, rows, numRows)
+            : PushBitmapWagRowColors(stream, worker->colors);
+        writeSeconds += Now() - start;
+    }
+
+    if(error == BITMAPWAG_END_OF_IMAGE)
+    {
+        error = BITMAPWAG_SUCCESS;
+    }
+
+    CloseBitmapWagReader(reader);
+
+    if(stream != NULL)
+    {
+        start = Now();
+        const BitmapWagError endError = EndBitmapWagStream(stream);
+        writeSeconds += Now() - start;
+
+        error = error ? error : endError;
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        const unsigned long long pixels = (unsigned long long) width * height;
+
+        AddStage(&worker->totals, STAGE_READ, readSeconds, FileSize(inPath),
+            pixels);
+        AddStage(&worker->totals, STAGE_WRITE, writeSeconds,
+            FileSize(outPath), pixels);
+    }
+
+    return error;
+}
+
+/**
+ * Converts a file by reading it whole, so its palette can be rebuilt and it
+ * can be run length encoded
+ *
+ * @param worker worker converting the file
+ * @param inPath path of the file to convert
+ * @param outPath path to write the converted file to
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ConvertFile(Worker * worker, const char * inPath,
+    const char * outPath)
+{
+    const ToolSettings * settings = worker->settings;
+    double start = Now();
+    BitmapWagError error = ReadBitmapWagInto(worker->src, inPath);
+
+    // Without the colorUsed array palette lookups are only slower
+    if(error && error != BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+    {
+        return error;
+    }
+
+    const unsigned long long pixels =
+        (unsigned long long) GetBitmapWagWidth(worker->src)
+        * GetBitmapWagHeight(worker->src);
+    const unsigned long long bytes = FileSize(inPath);
+    const uint16_t srcBits = GetBitmapWagBitsPerPixel(worker->src);
+    const uint16_t dstBits = settings->bitsPerPixel ? settings->bitsPerPixel
+        : srcBits;
+    BitmapWagImg * out = worker->src;
+    BitmapWagWriteOptions options;
+
+    AddStage(&worker->totals, STAGE_READ, Now() - start, bytes, pixels);
+    GetBitmapWagWriteOptions(worker->src, &options);
+
+    if(dstBits != srcBits)
+    {
+        start = Now();
+        out = worker->dst;
+        ResetBitmapWag(out);
+        error = ConvertBitmapWag(worker->src, out, dstBits);
+
+        // Too many colors for the new palette, build the best palette instead
+        if(error == BITMAPWAG_PALETTE_NOT_WRITTEN && dstBits <= 8)
+        {
+            const BitmapWagQuantizeOptions quantize = {0, settings->dither};
+
+            ResetBitmapWag(out);
+            error = QuantizeBitmapWag(worker->src, out, dstBits, &quantize);
+        }
+        if(error && error != BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+        {
+            return error;
+        }
+
+        AddStage(&worker->totals, STAGE_CONVERT, Now() - start, bytes,
+            pixels);
+    }
+
+    if(settings->setCompression)
+    {
+        options.compression = settings->compression;
+    }
+    // Files read run length encoded lose it when their new depth can't keep it
+    else if(dstBits != 4 && dstBits != 8)
+    {
+        options.compression = BITMAPWAG_COMPRESSION_NONE;
+    }
+
+    error = SetBitmapWagWriteOptions(out, &options);
+
+    // Run length encoded files can only be bottom-up
+    if(error == BITMAPWAG_SUCCESS 
+        && options.compression == BITMAPWAG_COMPRESSION_RLE)
+    {
+        error = SetBitmapWagTopDown(out, 0);
+    }
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        start = Now();
+        error = WriteBitmapWag(out, outPath);
+    }
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        AddStage(&worker->totals, STAGE_WRITE, Now() - start,
+            FileSize(outPath), pixels);
+    }
+
+    return error;
+}
+
+/**
+ * Body of every worker thread, claims files until none are left
+ *
+ * @param arg the Worker
+ * @return NULL
+ */
+static void * WorkFiles(void * arg)
+{
+    Worker * worker = (Worker *) arg;
+    const ToolSettings * settings = worker->settings;
+
+    for(;;)
+    {
+        const size_t index = __atomic_fetch_add(worker->nextFile, 1,
+            __ATOMIC_RELAXED);
+
+        if(index >= worker->files->count)
+        {
+            return NULL;
+        }
+
+        const char * path = worker->files->paths[index];
+        char * inPath = JoinPath(settings->inputDir, path);
+        char * outPath = JoinPath(settings->outputDir ? settings->outputDir
+            : "", path);
+        BitmapWagError error = BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+
+        if(inPath != NULL && outPath != NULL)
+        {
+            if(settings->command == COMMAND_VALIDATE)
+            {
+                error = ValidateFile(worker, inPath);
+            }
+            else
+            {
+                int streamed;
+
+                error = StreamFile(worker, inPath, outPath, &streamed);
+                if(!streamed)
+                {
+                    error = ConvertFile(worker, inPath, outPath);
+                }
+            }
+        }
+
+        if(error)
+        {
+            fprintf(stderr, "%s: error: %s: %s.\n", APP_NAME, path,
+                ErrorsToStringBitmapWag(error));
+            worker->failed++;
+        }
+        else
+        {
+            worker->ok++;
+        }
+
+        free(inPath);
+        free(outPath);
+    }
+}
+
+/**
+ * Prints the files done and the time spent in every stage
+ *
+ * @param settings command line settings
+ * @param workers workers whose totals are printed
+ * @param seconds wall clock time taken by all workers
+ */
+static void PrintSummary(const ToolSettings * settings,
+    const Worker * workers, const double seconds)
+{
+    StageTotals totals = {{0}, {0}, {0}, {0}};
+    unsigned long long ok = 0;
+    unsigned long long failed = 0;
+
+    for(unsigned w = 0; w < settings->workers; w++)
+    {
+        ok += workers[w].ok;
+        failed += workers[w].failed;
+
+        for(unsigned s = 0; s < NUM_STAGES; s++)
+        {
+            totals.seconds[s] += workers[w].totals.seconds[s];
+            totals.files[s] += workers[w].totals.files[s];
+            totals.bytes[s] += workers[w].totals.bytes[s];
+            totals.pixels[s] += workers[w].totals.pixels[s];
+        }
+    }
+
+    printf("%llu files, %llu failed, %.3f s with %u workers\n", ok + failed,
+        failed, seconds, settings->workers);
+    printf("%-8s %10s %12s %12s %12s\n", "stage", "files", "worker s",
+        "MB/s", "Mpixel/s");
+
+    // Rates are per second of worker time spent in the stage, so they show
+    // what one worker can do
+    for(unsigned s = 0; s < NUM_STAGES; s++)
+    {
+        const double stageSeconds = totals.seconds[s] > 0 ? totals.seconds[s]
+            : 1;
+
+        if(totals.files[s] == 0)
+        {
+            continue;
+        }
+
+        printf("%-8s %10llu %12.3f %12.1f %12.1f\n", stageNames[s],
+            totals.files[s], totals.seconds[s],
+            totals.bytes[s] / stageSeconds / 1e6,
+            totals.pixels[s] / stageSeconds / 1e6);
+    }
+
+    // The total is wall clock time, what every worker does together
+    const double wallSeconds = seconds > 0 ? seconds : 1;
+
+    printf("%-8s %10llu %12.3f %12.1f %12.1f\n", "total", ok, seconds,
+        totals.bytes[STAGE_READ] / wallSeconds / 1e6,
+        totals.pixels[STAGE_READ] / wallSeconds / 1e6);
+}
+
+/**
+ * Prints the command line usage
+ */
+static void Usage(void)
+{
+    fprintf(stderr,
+        "usage: %s convert [-b bpp] [-c none|rle] [-d none|ordered|fs] "
+        "[-j workers] [-R] input-dir output-dir\n"
+        "       %s validate [-j workers] [-R] input-dir\n"
+        "  convert   writes every .bmp of input-dir to output-dir, without "
+        "-b or -c\n"
+        "            files are re-encoded unchanged\n"
+        "  validate  reads every .bmp of input-dir and reports the ones "
+        "that fail\n"
+        "  -b  bits per pixel to convert to, 1, 2, 4, 8, 16, 24 or 32\n"
+        "  -c  compression to write, rle needs 4 or 8 bits per pixel\n"
+        "  -d  dithering when a file has more colors than its new palette "
+        "(default none)\n"
+        "  -j  worker threads, 0 for one per processor (default 0)\n"
+        "  -R  include subdirectories\n",
+        APP_NAME, APP_NAME);
+}
+
+/**
+ * Parses the command line
+ *
+ * @return 0 if successful
+ */
+static int ParseArguments(int argc, char ** argv, ToolSettings * settings)
+{
+    const char * dirs[2] = {NULL, NULL};
+    int numDirs = 0;
+
+    if(argc < 2)
+    {
+        return -1;
+    }
+    if(strcmp(argv[1], "convert") == 0)
+    {
+        settings->command = COMMAND_CONVERT;
+    }
+    else if(strcmp(argv[1], "validate") == 0)
+    {
+        settings->command = COMMAND_VALIDATE;
+    }
+    else
+    {
+        if(strcmp(argv[1], "-h") && strcmp(argv[1], "--help"))
+        {
+            fprintf(stderr, "%s: error: unknown command %s.\n", APP_NAME,
+                argv[1]);
+        }
+        return -1;
+    }
+
+    for(int i = 2; i < argc; i++)
+    {
+        if(argv[i][0] != '-')
+        {
+            if(numDirs == 2)
+            {
+                fprintf(stderr, "%s: error: too many directories.\n",
+                    APP_NAME);
+                return -1;
+            }
+            dirs[numDirs++] = argv[i];
+            continue;
+        }
+        if(strcmp(argv[i], "-R") == 0)
+        {
+            settings->recursive = 1;
+            continue;
+        }
+        if(argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 >= argc)
+        {
+            fprintf(stderr, "%s: error: bad argument %s.\n", APP_NAME,
+                argv[i]);
+            return -1;
+        }
+
+        const char * value = argv[++i];
+
+        switch(argv[i - 1][1])
+        {
+            case 'b':
+                settings->bitsPerPixel = (uint16_t) strtoul(value, NULL, 10);
+                break;
+            case 'c':
+                settings->setCompression = 1;
+                if(strcmp(value, "none") == 0)
+                {
+                    settings->compression = BITMAPWAG_COMPRESSION_NONE;
+                }
+                else if(strcmp(value, "rle") == 0)
+                {
+                    settings->compression = BITMAPWAG_COMPRESSION_RLE;
+                }
+                else
+                {
+                    fprintf(stderr, "%s: error: unknown compression %s.\n",
+                        APP_NAME, value);
+                    return -1;
+                }
+                break;
+            case 'd':
+                if(strcmp(value, "none") == 0)
+                {
+                    settings->dither = BITMAPWAG_DITHER_NONE;
+                }
+                else if(strcmp(value, "ordered") == 0)
+                {
+                    settings->dither = BITMAPWAG_DITHER_ORDERED;
+                }
+                else if(strcmp(value, "fs") == 0)
+                {
+                    settings->dither = BITMAPWAG_DITHER_FLOYD_STEINBERG;
+                }
+                else
+                {
+                    fprintf(stderr, "%s: error: unknown dithering %s.\n",
+                        APP_NAME, value);
+                    return -1;
+                }
+                break;
+            case 'j':
+                settings->workers = (unsigned) strtoul(value, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "%s: error: unknown option %s.\n", APP_NAME,
+                    argv[i - 1]);
+                return -1;
+        }
+    }
+
+    if(numDirs != (settings->command == COMMAND_CONVERT ? 2 : 1))
+    {
+        fprintf(stderr, "%s: error: wrong number of directories.\n",
+            APP_NAME);
+        return -1;
+    }
+    settings->inputDir = dirs[0];
+    settings->outputDir = dirs[1];
+
+    switch(settings->bitsPerPixel)
+    {
+        case 0: case 1: case 2: case 4: case 8: case 16: case 24: case 32:
+            break;
+        default:
+            fprintf(stderr, "%s: error: %u bits per pixel not supported.\n",
+                APP_NAME, settings->bitsPerPixel);
+            return -1;
+    }
+
+    if(settings->workers == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+        settings->workers = (processors > 0) ? (unsigned) processors : 1;
+    }
+    if(settings->workers > MAX_WORKERS)
+    {
+        settings->workers = MAX_WORKERS;
+    }
+
+    return 0;
+}
+
+// Main function is the start of the program
+int main(int argc, char ** argv)
+{
+    ToolSettings settings = {0};
+    FileList files = {0};
+    Worker * workers;
+    size_t nextFile = 0;
+    int retVal = 0;
+
+    if(ParseArguments(argc, argv, &settings))
+    {
+        Usage();
+        return -1;
+    }
+
+    if(ListFiles(&settings, &files, ""))
+    {
+        return -1;
+    }
+
+    workers = (Worker *) calloc(settings.workers, sizeof(Worker));
+
+    if(workers == NULL)
+    {
+        fprintf(stderr, "%s: error: out of memory.\n", APP_NAME);
+        return -1;
+    }
+
+    fprintf(stderr, "%s: info: %zu files, %u workers\n", APP_NAME,
+        files.count, settings.workers);
+
+    // Every file is worked on by one thread, the library's own threads
+    // would only compete with the workers
+    SetBitmapWagThreads(1);
+
+    const double start = Now();
+    unsigned started = 0;
+
+    for(; started < settings.workers; started++)
+    {
+        Worker * worker = &workers[started];
+
+        worker->settings = &settings;
+        worker->files = &files;
+        worker->nextFile = &nextFile;
+        worker->src = ConstructBitmapWag();
+        worker->dst = ConstructBitmapWag();
+
+        if(worker->src == NULL || worker->dst == NULL
+            || pthread_create(&worker->thread, NULL, WorkFiles, worker) != 0)
+        {
+            FreeBitmapWag(worker->src);
+            FreeBitmapWag(worker->dst);
+            break;
+        }
+    }
+
+    if(started == 0)
+    {
+        fprintf(stderr, "%s: error: cannot start a worker.\n", APP_NAME);
+        retVal = -1;
+    }
+
+    for(unsigned w = 0; w < started; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        FreeBitmapWag(workers[w].src);
+        FreeBitmapWag(workers[w].dst);
+        free(workers[w].colors);
+        retVal = workers[w].failed ? -1 : retVal;
+    }
+
+    if(started > 0)
+    {
+        settings.workers = started;
+        PrintSummary(&settings, workers, Now() - start);
+    }
+
+    for(size_t i = 0; i < files.count; i++)
+    {
+        free(files.paths[i]);
+    }
+    free(files.paths);
+    free(workers);
+
+    return retVal;
+}
@@ -0,0 +1,433 @@
+//  This file is part of libBitmapWag.
+//
+//  libBitmapWag is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  libBitmapWag is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License
+//  along with libBitmapWag.  If not, see <https://www.gnu.org/licenses/>.
+
+// check.c writes bitmaps of every pixel layout the command line tool copies
+// without a palette and checks that files it converted without -b or -c kept
+// their layout and pixels. It also checks that files with crafted headers are
+// refused rather than read past their end. It is built and run by 
+// `make check'.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "BitmapWag.h"
+
+// APP_NAME is used for stderr outputs in this program
+// it should be provided by the makefile, if not, it is redfined here.
+#ifndef APP_NAME
+    #define APP_NAME "bitmap-check"
+#endif
+
+// Dimensions of the bitmaps written, odd so rows are padded
+#define CHECK_WIDTH 37
+#define CHECK_HEIGHT 23
+
+// A file written by this program and the layout of its pixels
+typedef struct {
+    const char * name;
+    uint16_t bitsPerPixel;
+    // Red, green, blue and alpha masks, all zero for BI_RGB files
+    uint32_t masks[4];
+} CheckFile;
+
+static const CheckFile checkFiles[] = {
+    {"rgb565.bmp", 16, {0xF800, 0x07E0, 0x001F, 0}},
+    {"argb8888.bmp", 32, {0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000}},
+    {"rgb24.bmp", 24, {0, 0, 0, 0}},
+    {"rgb32.bmp", 32, {0, 0, 0, 0}}
+};
+
+#define NUM_CHECK_FILES (sizeof(checkFiles) / sizeof(checkFiles[0]))
+
+// A file whose headers describe more image bits than it holds or than can be
+// addressed, and the error reading it shall fail with
+typedef struct {
+    const char * name;
+    uint32_t width;
+    uint32_t height;
+    uint16_t bitsPerPixel;
+    // Bytes of image bits actually in the file
+    uint32_t bitsSize;
+    BitmapWagError expected;
+} CraftedFile;
+
+static const CraftedFile craftedFiles[] = {
+    // 65536 rows of 65536 bytes wrap to 65536 bytes in 32 bits
+    {"tall.bmp", 65536, 65537, 8, 65536, BITMAPWAG_BITMAPBITS_NOT_READ},
+    // A row of 2^30 32 bit pixels wraps to zero bytes in 32 bits
+    {"wide.bmp", 1u << 30, 1, 32, 4096, BITMAPWAG_IMAGE_TOO_LARGE}
+};
+
+#define NUM_CRAFTED_FILES (sizeof(craftedFiles) / sizeof(craftedFiles[0]))
+
+/**
+ * Joins a directory and a file name
+ *
+ * @return 0 if the path fit in path
+ */
+static int JoinPath(char * path, const size_t size, const char * dir,
+    const char * name)
+{
+    const int length = snprintf(path, size, "%s/%s", dir, name);
+
+    return length < 0 || (size_t) length >= size;
+}
+
+/**
+ * Writes every check file to a directory, the pixels of each a pattern of
+ * every value of every channel, alpha included
+ *
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError WriteFiles(const char * dir)
+{
+    BitmapWagError error = BITMAPWAG_SUCCESS;
+
+    for(size_t f = 0; f < NUM_CHECK_FILES && error == BITMAPWAG_SUCCESS; f++)
+    {
+        const CheckFile * file = &checkFiles[f];
+        BitmapWagImg * img = ConstructBitmapWag();
+        BitmapWagView view;
+        char path[4096];
+
+        if(JoinPath(path, sizeof(path), dir, file->name))
+        {
+            FreeBitmapWag(img);
+            return BITMAPWAG_BUFFER_TOO_SMALL;
+        }
+
+        if(file->masks[0] != 0)
+        {
+            error = InitializeBitmapWagBitfields(img, CHECK_HEIGHT,
+                CHECK_WIDTH, file->bitsPerPixel, file->masks[0],
+                file->masks[1], file->masks[2], file->masks[3]);
+        }
+        else
+        {
+            error = InitializeBitmapWag(img, CHECK_HEIGHT, CHECK_WIDTH,
+                file->bitsPerPixel);
+        }
+
+        if(error == BITMAPWAG_SUCCESS)
+        {
+            error = GetBitmapWagView(img, &view);
+        }
+
+        if(error == BITMAPWAG_SUCCESS)
+        {
+            const size_t rowBytes = ((size_t) view.width * view.bitsPerPixel
+                + 7) / 8;
+
+            for(uint32_t y = 0; y < view.height; y++)
+            {
+                for(size_t i = 0; i < rowBytes; i++)
+                {
+                    view.bits[y*view.stride + i] = (uint8_t) (i*7 + y*53);
+                }
+            }
+
+            error = WriteBitmapWag(img, path);
+        }
+
+        if(error)
+        {
+            fprintf(stderr, "%s: error: %s: %s.\n", APP_NAME, path,
+                ErrorsToStringBitmapWag(error));
+        }
+
+        FreeBitmapWag(img);
+    }
+
+    return error;
+}
+
+/**
+ * Reads a pixel of a view as a little-endian integer
+ */
+static uint32_t ViewPixel(const BitmapWagView * view, const uint32_t x,
+    const uint32_t y)
+{
+    const uint8_t * p = view->bits + y*view->stride
+        + (size_t) x * (view->bitsPerPixel / 8);
+    uint32_t pixel = 0;
+
+    for(unsigned b = 0; b < view->bitsPerPixel / 8u; b++)
+    {
+        pixel |= (uint32_t) p[b] << (8*b);
+    }
+
+    return pixel;
+}
+
+/**
+ * Checks that a file has the layout of its check file and the same pixels as
+ * the file written by WriteFiles, reading both whole
+ *
+ * @return 0 if the file matches
+ */
+static int CompareFile(const CheckFile * file, const char * inPath,
+    const char * outPath)
+{
+    BitmapWagImg * in = ConstructBitmapWag();
+    BitmapWagImg * out = ConstructBitmapWag();
+    BitmapWagView inView;
+    BitmapWagView outView;
+    BitmapWagInfo info;
+    BitmapWagError error = ReadBitmapWagInfo(outPath, &info);
+    int failed = 0;
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        error = ReadBitmapWag(in, inPath);
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        error = ReadBitmapWag(out, outPath);
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        error = GetBitmapWagView(in, &inView);
+    }
+
+    if(error == BITMAPWAG_SUCCESS)
+    {
+        error = GetBitmapWagView(out, &outView);
+    }
+
+    if(error)
+    {
+        fprintf(stderr, "%s: error: %s: %s.\n", APP_NAME, outPath,
+            ErrorsToStringBitmapWag(error));
+        failed = 1;
+    }
+    else if(info.bitsPerPixel != file->bitsPerPixel
+        || memcmp(info.masks, file->masks, sizeof(info.masks)) != 0
+        || outView.width != inView.width || outView.height != inView.height)
+    {
+        fprintf(stderr, "%s: error: %s: layout changed, %u bits per pixel, "
+            "masks %08X %08X %08X %08X.\n", APP_NAME, outPath,
+            info.bitsPerPixel, info.masks[0], info.masks[1], info.masks[2],
+            info.masks[3]);
+        failed = 1;
+    }
+    else
+    {
+        const uint32_t used = inView.masks[0] | inView.masks[1]
+            | inView.masks[2] | inView.masks[3];
+
+        for(uint32_t y = 0; y < inView.height && !failed; y++)
+        {
+            for(uint32_t x = 0; x < inView.width && !failed; x++)
+            {
+                const uint32_t expected = ViewPixel(&inView, x, y) & used;
+                const uint32_t actual = ViewPixel(&outView, x, y) & used;
+
+                if(actual != expected)
+                {
+                    fprintf(stderr, "%s: error: %s: pixel %u %u is %08X, "
+                        "expected %08X.\n", APP_NAME, outPath, x, y, actual,
+                        expected);
+                    failed = 1;
+                }
+            }
+        }
+    }
+
+    FreeBitmapWag(in);
+    FreeBitmapWag(out);
+
+    return failed;
+}
+
+/**
+ * Stores a value in little-endian order
+ */
+static void PutLittleEndian(uint8_t * dst, uint32_t value, const int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        dst[i] = (uint8_t) value;
+        value >>= 8;
+    }
+}
+
+/**
+ * Writes a crafted file, its headers, a grey palette if it has one and 
+ * bitsSize bytes of image bits
+ *
+ * @return 0 if the file was written
+ */
+static int WriteCraftedFile(const CraftedFile * file, const char * path)
+{
+    const uint32_t numColors = (file->bitsPerPixel <= 8) ? 
+        1u << file->bitsPerPixel : 0;
+    const uint32_t offBits = 14 + 40 + 4*numColors;
+    uint8_t headers[14 + 40] = {0};
+    uint8_t bytes[4096] = {0};
+    FILE * fp = fopen(path, "wb");
+    int failed = (fp == NULL);
+
+    headers[0] = 'B';
+    headers[1] = 'M';
+    PutLittleEndian(&headers[2], offBits + file->bitsSize, 4);
+    PutLittleEndian(&headers[10], offBits, 4);
+    PutLittleEndian(&headers[14], 40, 4);
+    PutLittleEndian(&headers[18], file->width, 4);
+    PutLittleEndian(&headers[22], file->height, 4);
+    PutLittleEndian(&headers[26], 1, 2);
+    PutLittleEndian(&headers[28], file->bitsPerPixel, 2);
+
+    if(!failed)
+    {
+        failed = fwrite(headers, sizeof(headers), 1, fp) != 1;
+    }
+
+    for(uint32_t i = 0; i < numColors && !failed; i++)
+    {
+        const uint8_t color[4] = {(uint8_t) i, (uint8_t) i, (uint8_t) i, 0};
+
+        failed = fwrite(color, sizeof(color), 1, fp) != 1;
+    }
+
+    for(uint32_t left = file->bitsSize; left > 0 && !failed;)
+    {
+        const uint32_t size = (left < sizeof(bytes)) ? left : sizeof(bytes);
+
+        failed = fwrite(bytes, size, 1, fp) != 1;
+        left -= size;
+    }
+
+    if(fp != NULL && fclose(fp) != 0)
+    {
+        failed = 1;
+    }
+
+    return failed;
+}
+
+/**
+ * Writes every crafted file to a directory and checks that reading it fails,
+ * mapped reads with the error the file expects
+ *
+ * @return 0 if every file was refused
+ */
+static int CheckCraftedFiles(const char * dir)
+{
+    int failed = 0;
+
+    for(size_t f = 0; f < NUM_CRAFTED_FILES; f++)
+    {
+        const CraftedFile * file = &craftedFiles[f];
+        BitmapWagImg * img = ConstructBitmapWag();
+        char path[4096];
+
+        if(JoinPath(path, sizeof(path), dir, file->name) 
+            || WriteCraftedFile(file, path))
+        {
+            fprintf(stderr, "%s: error: %s: not written.\n", APP_NAME, 
+                file->name);
+            FreeBitmapWag(img);
+            return 1;
+        }
+
+        BitmapWagError error = ReadBitmapWagMapped(img, path, 
+            BITMAPWAG_MAP_READ_ONLY);
+
+        if(error != file->expected && error != BITMAPWAG_MAP_NOT_SUPPORTED)
+        {
+            fprintf(stderr, "%s: error: %s: mapped read gave \"%s\", "
+                "expected \"%s\".\n", APP_NAME, path, 
+                ErrorsToStringBitmapWag(error), 
+                ErrorsToStringBitmapWag(file->expected));
+            failed = 1;
+        }
+        else
+        {
+            fprintf(stderr, "%s: info: %s refused.\n", APP_NAME, file->name);
+        }
+
+        FreeBitmapWag(img);
+    }
+
+    return failed;
+}
+
+/**
+ * Prints the command line usage
+ */
+static void Usage(void)
+{
+    fprintf(stderr,
+        "usage: %s write dir\n"
+        "       %s compare input-dir output-dir\n"
+        "       %s crafted dir\n"
+        "  write    writes the check files to dir\n"
+        "  compare  checks the files of output-dir, converted from "
+        "input-dir\n"
+        "           without -b or -c, kept their layout and pixels\n"
+        "  crafted  writes files with crafted headers to dir and checks "
+        "they are\n"
+        "           refused\n",
+        APP_NAME, APP_NAME, APP_NAME);
+}
+
+int main(int argc, char ** argv)
+{
+    if(argc == 3 && strcmp(argv[1], "write") == 0)
+    {
+        return WriteFiles(argv[2]) ? 1 : 0;
+    }
+
+    if(argc == 3 && strcmp(argv[1], "crafted") == 0)
+    {
+        return CheckCraftedFiles(argv[2]);
+    }
+
+    if(argc != 4 || strcmp(argv[1], "compare") != 0)
+    {
+        Usage();
+        return 2;
+    }
+
+    int failed = 0;
+
+    for(size_t f = 0; f < NUM_CHECK_FILES; f++)
+    {
+        char inPath[4096];
+        char outPath[4096];
+
+        if(JoinPath(inPath, sizeof(inPath), argv[2], checkFiles[f].name)
+            || JoinPath(outPath, sizeof(outPath), argv[3],
+            checkFiles[f].name))
+        {
+            fprintf(stderr, "%s: error: path too long.\n", APP_NAME);
+            return 1;
+        }
+
+        if(CompareFile(&checkFiles[f], inPath, outPath))
+        {
+            failed = 1;
+        }
+        else
+        {
+            fprintf(stderr, "%s: info: %s round trip ok.\n", APP_NAME,
+                checkFiles[f].name);
+        }
+    }
+
+    return failed;
+}
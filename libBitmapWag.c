@@ -13,8 +13,33 @@
 //  You should have received a copy of the GNU Lesser General Public License
 //  along with libBitmapWag.  If not, see <https://www.gnu.org/licenses/>.
 
+// Memory mapped reads need POSIX mmap and the thread pool needs POSIX 
+// threads, everything else in this library only needs the standard c libraries
+#if defined(__unix__) || defined(__unix) || \
+    (defined(__APPLE__) && defined(__MACH__))
+    #define BITMAPWAG_HAS_MMAP
+    #ifndef BITMAPWAG_NO_THREADS
+        #define BITMAPWAG_HAS_THREADS
+    #endif
+    #ifndef _POSIX_C_SOURCE
+        #define _POSIX_C_SOURCE 200809L
+    #endif
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef BITMAPWAG_HAS_MMAP
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+#ifdef BITMAPWAG_HAS_THREADS
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+#ifdef BITMAPWAG_STATS
+    #include <time.h>
+#endif
 #include "BitmapWag.h"
 
 /*
@@ -81,6 +106,38 @@ typedef struct __attribute__((__packed__)) {
     uint32_t biClrImportant;
 } BitmapWagBmih;
 
+// Values of biCompression
+#define BITMAPWAG_BI_RGB 0
+#define BITMAPWAG_BI_RLE8 1
+#define BITMAPWAG_BI_RLE4 2
+#define BITMAPWAG_BI_BITFIELDS 3
+#define BITMAPWAG_BI_ALPHABITFIELDS 6
+
+// Size of the BITMAPV4HEADER written for images with an alpha mask
+#define BITMAPWAG_V4_HEADER_SIZE 108
+// Logical color space of the BITMAPV4HEADER, 'sRGB'
+#define BITMAPWAG_LCS_SRGB 0x73524742
+
+// BitmapWagBitfields holds the channel masks of a 16 or 32 bit image with 
+// BI_BITFIELDS compression, and tables that move each channel in and out of 
+// a pixel so no per pixel division or bit scan is needed
+typedef struct {
+    // masks of the red, green, blue and alpha channels, in that order
+    uint32_t masks[4];
+    // shift is the position of the lowest set bit of each mask
+    uint8_t shift[4];
+    // drop is the number of low bits dropped from channels wider than 8 bits
+    uint8_t drop[4];
+    // decode scales the top (at most 8) bits of a channel to 0 - 255
+    uint8_t decode[4][256];
+    // encode scales 0 - 255 to the channel, already shifted into place
+    uint32_t encode[4][256];
+} BitmapWagBitfields;
+
+// Number of slots in the palette hash table, must be a power of two and at 
+// least twice the largest palette so probe sequences stay short
+#define BITMAPWAG_PALETTE_HASH_SIZE 512
+
 // Struct containing all the Bitmap structures 
 struct BitmapWagImg {
     // Bitmap file header
@@ -91,10 +148,58 @@ struct BitmapWagImg {
     BitmapWagRgbQuad * aColors;
     // image bits
     uint8_t * aBitmapBits;
+    // bottomRow is the first byte of the bottom row of the image, row y 
+    // starts y*rowStride bytes after it. rowStride is negative when topDown 
+    // is non-zero, the rows are then stored top row first and written with a
+    // negative biHeight. 
+    uint8_t * bottomRow;
+    ptrdiff_t rowStride;
+    uint8_t topDown;
     // colorUsed will be used by the bitmap array to keep track of how many 
     // colors in the pallet are being used when writing to pixels for 
     // efficiencies sake. 
     uint8_t * colorUsed;
+    // paletteHash maps a color to one plus its index in aColors, zero marks an
+    // empty slot. Only the entries flagged in colorUsed are in the table. 
+    uint16_t paletteHash[BITMAPWAG_PALETTE_HASH_SIZE];
+    // lastColor and lastIndex cache the most recent palette lookup
+    BitmapWagRgbQuad lastColor;
+    uint8_t lastIndex;
+    uint8_t lastValid;
+    // freeColor is the lowest index in colorUsed that may still be unused,
+    // palette entries are never released so it only moves forward
+    uint16_t freeColor;
+    // mapping is the start of the file mapping aBitmapBits points into when 
+    // the image was read with ReadBitmapWagMapped, NULL otherwise
+    void * mapping;
+    // mappingSize is the length of mapping in bytes
+    size_t mappingSize;
+    // readOnly is non-zero if pixels can't be set on the image
+    uint8_t readOnly;
+    // ownsPixels is non-zero if aBitmapBits was handed over to 
+    // InitializeBitmapWagExternal, it's released with freePixels called with
+    // freeUser, or with free() if freePixels is NULL
+    uint8_t ownsPixels;
+    BitmapWagFreePixels freePixels;
+    void * freeUser;
+    // writeOptions are applied every time the image is written
+    BitmapWagWriteOptions writeOptions;
+    // bitfields holds the channel masks of a BI_BITFIELDS image, NULL for the
+    // fixed layouts of 16 and 32 bit images without masks
+    BitmapWagBitfields * bitfields;
+    // allocator the struct, aBitmapBits, aColors, colorUsed and bitfields 
+    // are allocated and freed with
+    BitmapWagAllocator allocator;
+    // Buffers aBitmapBits, aColors, colorUsed and bitfields are given, and 
+    // their sizes in bytes. They outlive ResetBitmapWag and are reused by the
+    // next initialization when they are large enough. 
+    void * bitsBuffer;
+    size_t bitsCapacity;
+    void * colorsBuffer;
+    size_t colorsCapacity;
+    void * colorUsedBuffer;
+    size_t colorUsedCapacity;
+    void * bitfieldsBuffer;
     // state indicates the state of the bitmap struct, so that initializations
     // cannot occur twice so that the library prevents memory leaks. 
     BitmapWagState state;
@@ -157,9 +262,10 @@ static uint16_t ceilLog2b16_t (const uint16_t input)
  */
 static uint32_t GetRowMemory(const uint32_t width, const uint16_t bitsPerPixel)
 {
-    uint32_t rowMemory = ((bitsPerPixel < 8) 
-        * (width >> (4 - ceilLog2b16_t(bitsPerPixel)))) 
-        + (width * (bitsPerPixel >> 3)); 
+    // Round the bits in a row up to a whole number of bytes, so the last 
+    // pixels of a 1, 2 or 4 bit row that don't fill a byte still fit
+    uint32_t rowMemory = (uint32_t) 
+        ((((uint64_t) width) * bitsPerPixel + 7) >> 3);
 
     const unsigned bytesAtEnd = 4;
     // Make sure there's enough space for each row to end on a four byte bound
@@ -170,907 +276,7763 @@ static uint32_t GetRowMemory(const uint32_t width, const uint16_t bitsPerPixel)
 }
 
 /**
- * SetColorUsedArrayBitmapWag populates the 256 bit array colorUsed. 
- * This speeds up the function SetBitmapWagPixel when color palettes are used 
- * because the 256 byte array would need to be reconstructed each call 
- * otherwise. 
+ * CheckImageSizeBitmapWag checks that the rows of an image fit in the 32 bits
+ * GetRowMemory returns and that its image bits fit in a size_t, so neither 
+ * wraps around when computed. 
  * This is used internally by the libBitmapWag library. 
  *
- * @param bm pointer to a bitmap struct
- * @param colorUsed pointer to a 256 byte array for keeping track of which 
- *        colors in the color palette have been used. 
- * @return BITMAPWAG_SUCCESS if successful
+ * @param width of image
+ * @param height of image
+ * @param bitsPerPixel of each pixel
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_IMAGE_TOO_LARGE if not
  */
-static BitmapWagError SetColorUsedArrayBitmapWag(BitmapWagImg * bm, 
-    uint8_t * colorUsed)
+static BitmapWagError CheckImageSizeBitmapWag(const uint32_t width, 
+    const uint32_t height, const uint16_t bitsPerPixel)
 {
-    if(bm == NULL)
+    // Bytes of a row padded to four bytes, as GetRowMemory finds them
+    const uint64_t rowMemory = (((((uint64_t) width) * bitsPerPixel + 7) 
+        >> 3) + 3) & ~(uint64_t) 3;
+
+    if(rowMemory > UINT32_MAX 
+        || (height > 0 && rowMemory > SIZE_MAX / height))
     {
-        return BITMAPWAG_NULL;
+        return BITMAPWAG_IMAGE_TOO_LARGE;
     }
 
-    size_t bitsPerPixel = bm->bmih.biBitCount;
-    size_t width = bm->bmih.biWidth;
-    size_t height = bm->bmih.biHeight;
-
-    // Find the amount of memory that needs to be allocated for the image array
-    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+    return BITMAPWAG_SUCCESS;
+}
 
-    
-    if(colorUsed == NULL)
+/**
+ * SetRowsBitmapWag points bottomRow and rowStride at the rows of aBitmapBits
+ * in the order topDown says they are stored in
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct with aBitmapBits and topDown set
+ * @param height of image
+ * @param stride bytes from the start of one row stored to the next, the 
+ *        size of a row unless the image is external
+ */
+static void SetRowsBitmapWag(BitmapWagImg * bm, const uint32_t height, 
+    const size_t stride)
+{
+    if(bm->topDown && height > 0)
     {
-        return BITMAPWAG_COLOR_ARRAY_NULL;
+        bm->bottomRow = bm->aBitmapBits + (size_t) (height - 1)*stride;
+        bm->rowStride = -(ptrdiff_t) stride;
     }
-    // Check if the bitmap bits pointer is null
-    if(bm->aBitmapBits == NULL)
+    else
     {
-        return BITMAPWAG_BITMAPBITS_NULL;
+        bm->bottomRow = bm->aBitmapBits;
+        bm->rowStride = (ptrdiff_t) stride;
     }
+}
 
-    // If a color palette is not being used 
-    if(bm->bmih.biBitCount > 8)
-    {
-        return BITMAPWAG_NO_COLOR_PALETTE; 
-    }
+/**
+ * GetStrideBitmapWag gets the number of bytes from the start of one row 
+ * stored in aBitmapBits to the next
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to an initialized bitmap struct
+ * @return the stride of the rows
+ */
+static size_t GetStrideBitmapWag(const BitmapWagImg * bm)
+{
+    return (bm->rowStride < 0) ? (size_t) -bm->rowStride 
+        : (size_t) bm->rowStride;
+}
 
-    // Set the index, each pixel contains, to one in the colorUsed array 
-    for(uint32_t i = 0; i < width; i++)
+/**
+ * RowBitmapWag gets a row of the image bits
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to an initialized bitmap struct
+ * @param y vertical coordinate of the row (from bottom)
+ * @return the first byte of the row
+ */
+static uint8_t * RowBitmapWag(const BitmapWagImg * bm, const uint32_t y)
+{
+    return bm->bottomRow + (ptrdiff_t) y*bm->rowStride;
+}
+
+// Largest number of threads the thread pool will run, including the caller
+#define BITMAPWAG_MAX_THREADS 256
+// Jobs smaller than this many bytes run on the calling thread, and bands are 
+// never made smaller than this
+#define BITMAPWAG_MIN_BAND_BYTES (64 * 1024)
+// Number of bands each thread is given on average, more bands balance the 
+// work better when some rows are slower than others
+#define BITMAPWAG_BANDS_PER_THREAD 4
+
+// BitmapWagRowsFunc processes the rows y0 up to but not including y1 of a job
+typedef BitmapWagError (*BitmapWagRowsFunc)(void * ctx, const uint32_t y0, 
+    const uint32_t y1);
+
+#ifdef BITMAPWAG_HAS_THREADS
+// BitmapWagPool holds the worker threads and the job they are working on
+typedef struct {
+    // lock guards every member below it except nextRow and error
+    pthread_mutex_t lock;
+    // wake is signalled when a job is posted or the workers are stopped
+    pthread_cond_t wake;
+    // done is signalled when the last worker leaves a job
+    pthread_cond_t done;
+    pthread_t threads[BITMAPWAG_MAX_THREADS - 1];
+    // numThreads is the number of worker threads, the caller is not counted
+    uint32_t numThreads;
+    // generation is incremented every time a job is posted
+    uint32_t generation;
+    // busy is the number of workers that haven't left the current job
+    uint32_t busy;
+    uint8_t stop;
+    // The current job 
+    BitmapWagRowsFunc func;
+    void * ctx;
+    uint32_t numRows;
+    uint32_t bandRows;
+    // nextRow is the first row no thread has claimed yet, updated atomically
+    uint32_t nextRow;
+    // error is the first error a band returned, updated atomically
+    BitmapWagError error;
+} BitmapWagPool;
+
+static BitmapWagPool pool = {.lock = PTHREAD_MUTEX_INITIALIZER, 
+    .wake = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+
+// poolUse is held by the thread running a job or resizing the pool, callers 
+// that find it taken run their job on their own thread
+static pthread_mutex_t poolUse = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * WorkPoolBitmapWag claims bands of the current job until none are left
+ * This is used internally by the libBitmapWag library. 
+ */
+static void WorkPoolBitmapWag(void)
+{
+    for(;;)
     {
-        for(uint32_t j = 0; j < height; j++)
+        const uint32_t y0 = __atomic_fetch_add(&pool.nextRow, pool.bandRows, 
+            __ATOMIC_RELAXED);
+
+        if(y0 >= pool.numRows)
         {
-            uint8_t value = 
-            (bm->aBitmapBits)
-            [j*rowMemory + (i >> (4 - ceilLog2b16_t(bitsPerPixel)))];
+            return;
+        }
 
-            value = (((0xFF >> (8 - bitsPerPixel)) 
-                << (4 - ceilLog2b16_t(bitsPerPixel))) & value);
+        const uint32_t y1 = (pool.numRows - y0 > pool.bandRows) ? 
+            y0 + pool.bandRows : pool.numRows;
 
-            value = value >> (4 - ceilLog2b16_t(bitsPerPixel));
+        BitmapWagError error = pool.func(pool.ctx, y0, y1);
 
-            colorUsed[value] = 1;
+        if(error)
+        {
+            BitmapWagError expected = BITMAPWAG_SUCCESS;
+
+            __atomic_compare_exchange_n(&pool.error, &expected, error, 0, 
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
         }
     }
-
-    return BITMAPWAG_SUCCESS;
 }
 
-const char * ErrorsToStringBitmapWag(const BitmapWagError error)
+/**
+ * WorkerBitmapWag is the body of every worker thread in the pool
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param arg generation of the pool when the thread was created, jobs may be 
+ *        posted before the thread first runs
+ * @return NULL
+ */
+static void * WorkerBitmapWag(void * arg)
 {
-    switch(error)
+    uint32_t seen = (uint32_t) (uintptr_t) arg;
+
+    pthread_mutex_lock(&pool.lock);
+
+    for(;;)
     {
-        case BITMAPWAG_SUCCESS: 
-            return "success";
-        case BITMAPWAG_NULL: 
-            return "bitmap null";
-        case BITMAPWAG_FILE_PATH_NULL: 
-            return "bitmap file null";
-        case BITMAPWAG_CANNOT_OPEN_FILE: 
-            return "bitmap cannot open file";
-        case BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED: 
-            return "bitmap allocate bitmap bits failed";
-        case BITMAPWAG_ALLOCATE_PALETTE_FAILED: 
-            return "bitmap allocate paletter failed";
-        case BITMAPWAG_BMFH_NOT_WRITTEN:
-            return "bitmap BMFH not written";
-        case BITMAPWAG_BMIH_NOT_WRITTEN:
-            return "bitmap BMIH not written";
-        case BITMAPWAG_PALETTE_NOT_WRITTEN:
-            return "bitmap palette not written because there's no space left";
-        case BITMAPWAG_IMAGE_NOT_WRITTEN:
-            return "bitmap image portion not written";
-        case BITMAPWAG_COLOR_ARRAY_NULL:
-            return "bitmap color used array null";
-        case BITMAPWAG_NO_COLOR_PALETTE:
-            return "bitmap no color palette used in this image";
-        case BITMAPWAG_BIBITS_NOT_SUPPORTED:
-            return "bitmap the bits per pixel value is not supported";
-        case BITMAPWAG_COLOR_PTR_NULL:
-            return "bitmap color pointer null";
-        case BITMAPWAG_BITMAPBITS_NULL:
-            return "bitmap aBitmapBits null";
-        case BITMAPWAG_COLOR_PALETTE_NULL:
-            return "bitmap aColor null";
-        case BITMAPWAG_COORDINATE_WIDTH_OUT:
-            return "bitmap coordinate width out of bounds";
-        case BITMAPWAG_COORDINATE_HEIGHT_OUT:
-            return "bitmap coordinate height out of bounds";
-        case BITMAPWAG_BMFH_NOT_READ:
-            return "bitmap BMFH not read";
-        case BITMAPWAG_BMIH_NOT_READ:
-            return "bitmap BMIH not read";
-        case BITMAPWAG_ACOLORS_NOT_READ:
-            return "bitmap color palette portion of file not read";
-        case BITMAPWAG_BITMAPBITS_NOT_READ:
-            return "bitmap image portion of file not read";
-        case BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE:
-            return "failed to allocate internal colorUsed array, perfomance \
-will be degraded";
-        case BITMAPWAG_NOTCONSTRUCTED: 
-            return "bitmap not constructed, ConstructBitmapWag() needs to be \
-needs to be called";
-        case BITMAPWAG_ALREADY_INIT:
-            return "bitmap has already been initialized and would be \
-initialized twice by calling this function";
-        default: 
-            return "unknown error"; 
+        while(!pool.stop && pool.generation == seen)
+        {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+
+        if(pool.stop)
+        {
+            pthread_mutex_unlock(&pool.lock);
+            return NULL;
+        }
+
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        WorkPoolBitmapWag();
+
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.busy == 0)
+        {
+            pthread_cond_signal(&pool.done);
+        }
     }
 }
 
-BitmapWagImg * ConstructBitmapWag(void) 
+/**
+ * StopPoolBitmapWag stops and joins every worker thread
+ * This is used internally by the libBitmapWag library. 
+ * @note poolUse shall be held by the caller
+ */
+static void StopPoolBitmapWag(void)
 {
-    BitmapWagImg * output = (BitmapWagImg *) malloc(sizeof(BitmapWagImg));
-    if(output != NULL)
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for(uint32_t i = 0; i < pool.numThreads; i++)
     {
-        *output = (BitmapWagImg){0};
-        output->state = BITMAPWAG_STATE_CONSTRUCTED;
+        pthread_join(pool.threads[i], NULL);
     }
-    return output;
+
+    __atomic_store_n(&pool.numThreads, 0, __ATOMIC_RELAXED);
+    pool.stop = 0;
 }
+#endif
 
-BitmapWagError ReadBitmapWag(BitmapWagImg * bm, const char * filePath)
+/**
+ * RunRowsBitmapWag runs a job over the rows of an image, splitting the rows 
+ * into bands that are spread over the thread pool. The calling thread works 
+ * on the job too and returns once every band is done. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param func function to run on every band, it shall be safe to call from 
+ *        several threads at once on different bands
+ * @param ctx passed to func
+ * @param numRows number of rows in the job
+ * @param rowBytes approximate number of bytes func touches per row
+ * @return BITMAPWAG_SUCCESS, or the first error func returned
+ */
+static BitmapWagError RunRowsBitmapWag(BitmapWagRowsFunc func, void * ctx, 
+    const uint32_t numRows, const size_t rowBytes)
 {
-    FILE *fp;
-    size_t itemsRead;
-    BitmapWagError retVal = BITMAPWAG_SUCCESS;
+#ifdef BITMAPWAG_HAS_THREADS
+    const size_t bandMinRows = (rowBytes >= BITMAPWAG_MIN_BAND_BYTES) ? 1 
+        : BITMAPWAG_MIN_BAND_BYTES / (rowBytes ? rowBytes : 1);
 
-    if(bm == NULL)
+    if(__atomic_load_n(&pool.numThreads, __ATOMIC_RELAXED) == 0 
+        || numRows < 2*bandMinRows || pthread_mutex_trylock(&poolUse) != 0)
     {
-        return BITMAPWAG_NULL;
+        return func(ctx, 0, numRows);
     }
 
-    if (filePath == NULL)
+    // The pool may have been stopped while the lock was being taken
+    if(pool.numThreads == 0)
     {
-        return BITMAPWAG_FILE_PATH_NULL;
+        pthread_mutex_unlock(&poolUse);
+        return func(ctx, 0, numRows);
     }
 
-    // Check to make sure that the object hasn't already been initialized
-    if(bm->state == BITMAPWAG_STATE_NONE)
+    const uint32_t numBands = (pool.numThreads + 1) 
+        * BITMAPWAG_BANDS_PER_THREAD;
+    uint32_t bandRows = (numRows + numBands - 1) / numBands;
+
+    if(bandRows < bandMinRows)
     {
-        return BITMAPWAG_NOTCONSTRUCTED;
+        bandRows = bandMinRows;
     }
-    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+
+    pthread_mutex_lock(&pool.lock);
+    pool.func = func;
+    pool.ctx = ctx;
+    pool.numRows = numRows;
+    pool.bandRows = bandRows;
+    pool.nextRow = 0;
+    pool.error = BITMAPWAG_SUCCESS;
+    pool.busy = pool.numThreads;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    WorkPoolBitmapWag();
+
+    pthread_mutex_lock(&pool.lock);
+    while(pool.busy > 0)
     {
-        return BITMAPWAG_ALREADY_INIT;
+        pthread_cond_wait(&pool.done, &pool.lock);
     }
+    BitmapWagError error = pool.error;
+    pthread_mutex_unlock(&pool.lock);
 
-    bm->bmih = (BitmapWagBmih){0};
-    bm->bmfh = (BitmapWagBmfh){0};
-    bm->aColors = NULL;
-    bm->aBitmapBits = NULL;
-    bm->colorUsed = NULL;
+    pthread_mutex_unlock(&poolUse);
 
-    // open filePath as binary file for writing 
-    fp = fopen(filePath, "rb");
+    return error;
+#else
+    (void) rowBytes;
 
-    if(fp == NULL)
-    {
-        return BITMAPWAG_CANNOT_OPEN_FILE;
-    }
+    return func(ctx, 0, numRows);
+#endif
+}
 
-    // Read the bitmap file header 
-    itemsRead = fread(&(bm->bmfh), sizeof(bm->bmfh), 1, fp);
+BitmapWagError SetBitmapWagThreads(const uint32_t numThreads)
+{
+#ifdef BITMAPWAG_HAS_THREADS
+    uint32_t total = numThreads;
 
-    if(itemsRead != 1)
+    // Zero means one thread for every online processor
+    if(total == 0)
     {
-        fclose(fp);
-        return BITMAPWAG_BMFH_NOT_READ;
-    }
-
-    // Read the bitmap info header 
-    itemsRead = fread(&(bm->bmih), sizeof(bm->bmih), 1, fp);
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
 
-    if(itemsRead != 1)
-    {
-        fclose(fp);
-        return BITMAPWAG_BMIH_NOT_READ;
+        total = (processors > 0) ? (uint32_t) processors : 1;
     }
-    
-    uint16_t bitsPerPixel = bm->bmih.biBitCount;
-    uint32_t width = bm->bmih.biWidth;
-    uint32_t height = bm->bmih.biHeight;
 
-    // Find the amount of memory that needs to be allocated for the image array
-    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
-
-    // fseek ahead if the bmih was larger than this library anticipated
-    if(bm->bmih.biSize > sizeof(bm->bmih))
+    if(total > BITMAPWAG_MAX_THREADS)
     {
-        fseek(fp, bm->bmih.biSize - sizeof(bm->bmih), SEEK_CUR);
+        total = BITMAPWAG_MAX_THREADS;
     }
 
-    // Read the color palette if we're using 256-colors or less
-    if(bm->bmih.biBitCount <= 8)
-    {
-        size_t sizeOfPalette;
-        size_t sizeOfColorUsed;
-        size_t numColors;
-        if(bm->bmih.biClrUsed > 0)
-        {
-            numColors = bm->bmih.biClrUsed;
-        }
-        else
-        {
-            // Calculate number of colors based on biBitCount
-            numColors = 1 << bm->bmih.biBitCount;    
-        }
-        // Calculate size of arrays to allocate 
-        sizeOfPalette = numColors * sizeof(BitmapWagRgbQuad);
-        sizeOfColorUsed = numColors * sizeof(uint8_t);
-
-        bm->aColors = (BitmapWagRgbQuad *) malloc(sizeOfPalette);
+    pthread_mutex_lock(&poolUse);
 
-        if(bm->aColors == NULL)
-        {
-            fclose(fp);
-            return BITMAPWAG_ALLOCATE_PALETTE_FAILED;
-        }
-        // Indicate that bm has been initialized
-        bm->state = BITMAPWAG_STATE_INITIALIZED;
+    StopPoolBitmapWag();
 
-        itemsRead = fread(bm->aColors, sizeOfPalette, 1, fp);
+    BitmapWagError retVal = BITMAPWAG_SUCCESS;
 
-        if(itemsRead != 1)
+    while(pool.numThreads < total - 1)
+    {
+        if(pthread_create(&pool.threads[pool.numThreads], NULL, 
+            WorkerBitmapWag, (void *) (uintptr_t) pool.generation) != 0)
         {
-            fclose(fp);
-            return BITMAPWAG_ACOLORS_NOT_READ;
+            // Keep the threads that did start
+            retVal = BITMAPWAG_CREATE_THREAD_FAILED;
+            break;
         }
 
-        // Allocate the space for the colorUsed record
-        bm->colorUsed = (uint8_t *) malloc(sizeOfColorUsed);
-
-        // if colorUsed failed to allocate, it's not an error, and there are 
-        // fallbacks but it will really  slow down the performance of the 
-        // library so the application should be notified 
-        if(bm->colorUsed == NULL)
-        {
-            retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
-        }
-        else
-        {
-            // Initialize all values in colorUsed to be all zeros
-            for(size_t i = 0; i < numColors; i++)
-            {
-                (bm->colorUsed)[i] = 0;
-            }
-        }
-    }
-    else
-    {
-        bm->aColors = NULL;
+        __atomic_store_n(&pool.numThreads, pool.numThreads + 1, 
+            __ATOMIC_RELAXED);
     }
 
-    size_t bytesForImage = rowMemory * height;
+    pthread_mutex_unlock(&poolUse);
 
-    // Allocate the memory for the image
-    bm->aBitmapBits = (uint8_t *) malloc(bytesForImage);
+    return retVal;
+#else
+    return (numThreads == 1) ? BITMAPWAG_SUCCESS 
+        : BITMAPWAG_THREADS_NOT_SUPPORTED;
+#endif
+}
 
-    if(bm->aBitmapBits == NULL)
-    {
-        fclose(fp);
+uint32_t GetBitmapWagThreads(void)
+{
+#ifdef BITMAPWAG_HAS_THREADS
+    return __atomic_load_n(&pool.numThreads, __ATOMIC_RELAXED) + 1;
+#else
+    return 1;
+#endif
+}
+
+// The performance counters are only kept when BITMAPWAG_STATS is defined, 
+// otherwise counting and timing compile to nothing. Counters are shared by 
+// every thread, relaxed atomics keep them whole without ordering anything. 
+#ifdef BITMAPWAG_STATS
+static BitmapWagStats stats;
+
+/**
+ * NowBitmapWag reads a monotonic clock for the performance counters
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @return the time in nanoseconds
+ */
+static uint64_t NowBitmapWag(void)
+{
+    struct timespec now;
+
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#else
+    timespec_get(&now, TIME_UTC);
+#endif
+
+    return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+}
+#endif
+
+#ifdef BITMAPWAG_STATS
+    // Add amount to the counter member of stats
+    #define BITMAPWAG_COUNT(member, amount) \
+        __atomic_fetch_add(&stats.member, (amount), __ATOMIC_RELAXED)
+    // Declare start as the current time
+    #define BITMAPWAG_TIME_START(start) const uint64_t start = NowBitmapWag()
+    // Add the nanoseconds since start to the counter member of stats
+    #define BITMAPWAG_TIME_END(member, start) \
+        BITMAPWAG_COUNT(member, NowBitmapWag() - (start))
+#else
+    #define BITMAPWAG_COUNT(member, amount) ((void) 0)
+    #define BITMAPWAG_TIME_START(start) ((void) 0)
+    #define BITMAPWAG_TIME_END(member, start) ((void) 0)
+#endif
+
+BitmapWagError GetBitmapWagStats(BitmapWagStats * output)
+{
+    if(output == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+#ifdef BITMAPWAG_STATS
+    // Every member is a uint64_t counter
+    const uint64_t * counters = (const uint64_t *) &stats;
+    uint64_t * outputCounters = (uint64_t *) output;
+
+    for(size_t i = 0; i < sizeof(stats) / sizeof(uint64_t); i++)
+    {
+        outputCounters[i] = __atomic_load_n(&counters[i], __ATOMIC_RELAXED);
+    }
+
+    return BITMAPWAG_SUCCESS;
+#else
+    memset(output, 0, sizeof(*output));
+    return BITMAPWAG_STATS_NOT_SUPPORTED;
+#endif
+}
+
+BitmapWagError ResetBitmapWagStats(void)
+{
+#ifdef BITMAPWAG_STATS
+    uint64_t * counters = (uint64_t *) &stats;
+
+    for(size_t i = 0; i < sizeof(stats) / sizeof(uint64_t); i++)
+    {
+        __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
+    }
+
+    return BITMAPWAG_SUCCESS;
+#else
+    return BITMAPWAG_STATS_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * AllocBitmapWag allocates memory like malloc, every allocation the library 
+ * makes goes through it. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param size number of bytes to allocate
+ * @return pointer to the memory, NULL if it could not be allocated
+ */
+static void * AllocBitmapWag(const size_t size)
+{
+    BITMAPWAG_TIME_START(start);
+    void * memory = malloc(size);
+
+    BITMAPWAG_COUNT(allocations, 1);
+    BITMAPWAG_TIME_END(allocNs, start);
+
+    return memory;
+}
+
+// Alignment asked for by every image allocation except the image bits, that 
+// of the strictest standard type. C99 has no max_align_t, there it is found 
+// from a union of the widest types as malloc has to align for them too. 
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+    #define BITMAPWAG_ALIGN (_Alignof(max_align_t))
+#else
+    typedef struct {
+        char first;
+        union {
+            long double longDouble;
+            long long longLong;
+            void * pointer;
+            void (*function)(void);
+        } widest;
+    } BitmapWagAlignProbe;
+
+    #define BITMAPWAG_ALIGN (offsetof(BitmapWagAlignProbe, widest))
+#endif
+// Alignment asked for by the image bits, a cache line
+#define BITMAPWAG_BITS_ALIGN 64
+// Size of the blocks of an arena created with a block size of zero
+#define BITMAPWAG_ARENA_BLOCK_SIZE (1 << 20)
+
+/**
+ * DefaultAllocBitmapWag is the alloc function of the default allocator
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user unused
+ * @param size number of bytes to allocate
+ * @param align alignment of the memory, a power of two
+ * @return pointer to the memory, NULL if it could not be allocated
+ */
+static void * DefaultAllocBitmapWag(void * user, const size_t size, 
+    const size_t align)
+{
+    (void) user;
+
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+    // malloc already aligns for any standard type
+    if(align > BITMAPWAG_ALIGN)
+    {
+        // aligned_alloc needs the size to be a multiple of the alignment
+        return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+    }
+#else
+    (void) align;
+#endif
+
+    return malloc(size);
+}
+
+/**
+ * DefaultFreeBitmapWag is the free function of the default allocator
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user unused
+ * @param memory memory returned by DefaultAllocBitmapWag
+ */
+static void DefaultFreeBitmapWag(void * user, void * memory)
+{
+    (void) user;
+    free(memory);
+}
+
+// defaultAllocator is malloc and free, allocatorBitmapWag is the allocator 
+// given to images made by ConstructBitmapWag
+static const BitmapWagAllocator defaultAllocator = {DefaultAllocBitmapWag, 
+    DefaultFreeBitmapWag, NULL};
+static BitmapWagAllocator allocatorBitmapWag = {DefaultAllocBitmapWag, 
+    DefaultFreeBitmapWag, NULL};
+
+/**
+ * AllocWithBitmapWag allocates memory of an image with its allocator
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param allocator allocator of the image
+ * @param size number of bytes to allocate
+ * @param align alignment of the memory, a power of two
+ * @return pointer to the memory, NULL if it could not be allocated
+ */
+static void * AllocWithBitmapWag(const BitmapWagAllocator * allocator, 
+    const size_t size, const size_t align)
+{
+    BITMAPWAG_TIME_START(start);
+    void * memory = allocator->alloc(allocator->user, size, align);
+
+    BITMAPWAG_COUNT(allocations, 1);
+    BITMAPWAG_TIME_END(allocNs, start);
+
+    return memory;
+}
+
+/**
+ * FreeWithBitmapWag frees memory of an image with its allocator
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param allocator allocator of the image
+ * @param memory memory returned by AllocWithBitmapWag, may be NULL
+ */
+static void FreeWithBitmapWag(const BitmapWagAllocator * allocator, 
+    void * memory)
+{
+    if(memory != NULL && allocator->free != NULL)
+    {
+        allocator->free(allocator->user, memory);
+    }
+}
+
+/**
+ * ReserveBitmapWag gets one of the buffers of an image, reusing the buffer if
+ * it is large enough and replacing it with a new one otherwise
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param buffer pointer to the buffer of the image
+ * @param capacity pointer to the size of the buffer in bytes
+ * @param size number of bytes needed
+ * @param align alignment of the buffer, a power of two
+ * @return pointer to the buffer, NULL if it could not be allocated
+ */
+static void * ReserveBitmapWag(BitmapWagImg * bm, void ** buffer, 
+    size_t * capacity, const size_t size, const size_t align)
+{
+    if(*buffer != NULL && *capacity >= size)
+    {
+        return *buffer;
+    }
+
+    FreeWithBitmapWag(&(bm->allocator), *buffer);
+    *buffer = AllocWithBitmapWag(&(bm->allocator), size, align);
+    *capacity = (*buffer != NULL) ? size : 0;
+
+    return *buffer;
+}
+
+BitmapWagError SetBitmapWagAllocator(const BitmapWagAllocator * allocator)
+{
+    if(allocator == NULL)
+    {
+        allocatorBitmapWag = defaultAllocator;
+        return BITMAPWAG_SUCCESS;
+    }
+
+    if(allocator->alloc == NULL)
+    {
+        return BITMAPWAG_ALLOCATOR_NULL;
+    }
+
+    allocatorBitmapWag = *allocator;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+// One block of memory of an arena, the memory handed out follows the header
+typedef struct BitmapWagArenaBlock {
+    struct BitmapWagArenaBlock * next;
+    // bytes of memory after the header, and how many are handed out
+    size_t size;
+    size_t used;
+} BitmapWagArenaBlock;
+
+// Struct containing the state of a bump arena
+struct BitmapWagArena {
+    // blocks in the order they are used, current is the one being handed out
+    BitmapWagArenaBlock * first;
+    BitmapWagArenaBlock * current;
+    // size of the memory of a new block, unless an allocation needs more
+    size_t blockSize;
+};
+
+/**
+ * ArenaAllocBitmapWag is the alloc function of an arena's allocator. Memory 
+ * is handed out from the current block, moving on to the next block, or a 
+ * new one, when it doesn't fit. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user pointer to the BitmapWagArena
+ * @param size number of bytes to allocate
+ * @param align alignment of the memory, a power of two
+ * @return pointer to the memory, NULL if it could not be allocated
+ */
+static void * ArenaAllocBitmapWag(void * user, const size_t size, 
+    const size_t align)
+{
+    BitmapWagArena * arena = (BitmapWagArena *) user;
+    BitmapWagArenaBlock * block = arena->current;
+
+    while(block != NULL)
+    {
+        const uintptr_t start = (uintptr_t) (block + 1);
+        const uintptr_t aligned = (start + block->used + align - 1) 
+            & ~((uintptr_t) align - 1);
+
+        if(aligned - start <= block->size 
+            && size <= block->size - (aligned - start))
+        {
+            block->used = aligned - start + size;
+            arena->current = block;
+            return (void *) aligned;
+        }
+
+        // Blocks after the current one are left over from before a reset
+        block = block->next;
+
+        if(block != NULL)
+        {
+            block->used = 0;
+        }
+    }
+
+    // Nothing left fits, add a block to the end
+    const size_t needed = size + align;
+    const size_t blockSize = (needed > arena->blockSize) ? needed 
+        : arena->blockSize;
+
+    if(needed < size)
+    {
+        return NULL;
+    }
+
+    block = (BitmapWagArenaBlock *) malloc(sizeof(BitmapWagArenaBlock) 
+        + blockSize);
+
+    if(block == NULL)
+    {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = blockSize;
+    block->used = 0;
+
+    if(arena->first == NULL)
+    {
+        arena->first = block;
+    }
+    else
+    {
+        BitmapWagArenaBlock * last = arena->current;
+
+        while(last->next != NULL)
+        {
+            last = last->next;
+        }
+        last->next = block;
+    }
+    arena->current = block;
+
+    return ArenaAllocBitmapWag(user, size, align);
+}
+
+BitmapWagError CreateBitmapWagArena(BitmapWagArena ** arena, 
+    const size_t blockSize)
+{
+    if(arena == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    *arena = (BitmapWagArena *) malloc(sizeof(BitmapWagArena));
+
+    if(*arena == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_ARENA_FAILED;
+    }
+
+    (*arena)->first = NULL;
+    (*arena)->current = NULL;
+    (*arena)->blockSize = blockSize ? blockSize : BITMAPWAG_ARENA_BLOCK_SIZE;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError GetBitmapWagArenaAllocator(BitmapWagArena * arena, 
+    BitmapWagAllocator * allocator)
+{
+    if(arena == NULL || allocator == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Memory is only given back all at once, so there is no free function
+    allocator->alloc = ArenaAllocBitmapWag;
+    allocator->free = NULL;
+    allocator->user = arena;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError ResetBitmapWagArena(BitmapWagArena * arena)
+{
+    if(arena == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // The blocks are kept and handed out again from the start
+    arena->current = arena->first;
+
+    if(arena->first != NULL)
+    {
+        arena->first->used = 0;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError DestroyBitmapWagArena(BitmapWagArena * arena)
+{
+    if(arena == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    while(arena->first != NULL)
+    {
+        BitmapWagArenaBlock * next = arena->first->next;
+
+        free(arena->first);
+        arena->first = next;
+    }
+
+    free(arena);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * GetPossibleColorsBitmapWag gets the number of entries in the color palette
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct that uses a color palette
+ * @return number of entries in aColors that pixels can index
+ */
+static uint16_t GetPossibleColorsBitmapWag(const BitmapWagImg * bm)
+{
+    const uint16_t maxColors = 1 << bm->bmih.biBitCount;
+
+    if(bm->bmih.biClrUsed > 0 && bm->bmih.biClrUsed < maxColors)
+    {
+        return bm->bmih.biClrUsed;
+    }
+    return maxColors;
+}
+
+// BitmapWagColorUsedJob is the job SetColorUsedArrayBitmapWag runs on bands 
+typedef struct {
+    const BitmapWagImg * bm;
+    uint8_t * colorUsed;
+} BitmapWagColorUsedJob;
+
+/**
+ * ColorUsedRowsBitmapWag flags the palette indices found in a band of rows. 
+ * The band is scanned into a local array first so threads only share the 256 
+ * stores at the end. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagColorUsedJob
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS
+ */
+static BitmapWagError ColorUsedRowsBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagColorUsedJob * job = (const BitmapWagColorUsedJob *) ctx;
+    const BitmapWagImg * bm = job->bm;
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    // colorUsed only has an entry for each color of the palette
+    const uint16_t possibleColors = GetPossibleColorsBitmapWag(bm);
+    uint8_t seen[256] = {0};
+
+    // Number of bits to shift x by to find the byte holding the pixel
+    const uint16_t pixelShift = 4 - ceilLog2b16_t(bitsPerPixel);
+    // Mask of the pixel position within a byte
+    const uint32_t pixelMask = ~(0xFFFFFFFF << pixelShift);
+    // Mask holds the right shifted bit mask
+    const uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+    // Set the index, each pixel contains, to one in the seen array 
+    for(uint32_t j = y0; j < y1; j++)
+    {
+        const uint8_t * row = RowBitmapWag(bm, j);
+
+        for(uint32_t i = 0; i < width; i++)
+        {
+            // Amount to shift palette index by
+            const uint8_t sftAmnt = bitsPerPixel * ((~i) & pixelMask);
+
+            seen[(row[i >> pixelShift] >> sftAmnt) & mask] = 1;
+        }
+    }
+
+    // Indices past the end of the palette are left out
+    for(uint16_t i = 0; i < possibleColors; i++)
+    {
+        if(seen[i])
+        {
+            __atomic_store_n(&(job->colorUsed)[i], 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+// BitmapWagClearJob is the job InitializeBitmapWag runs to zero the image
+typedef struct {
+    uint8_t * bits;
+    size_t rowMemory;
+} BitmapWagClearJob;
+
+/**
+ * ClearRowsBitmapWag sets every byte in a band of rows to zero
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagClearJob
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS
+ */
+static BitmapWagError ClearRowsBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagClearJob * job = (const BitmapWagClearJob *) ctx;
+
+    memset(job->bits + y0*job->rowMemory, 0x00, (y1 - y0)*job->rowMemory);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * SetColorUsedArrayBitmapWag populates the 256 bit array colorUsed. 
+ * This speeds up the function SetBitmapWagPixel when color palettes are used 
+ * because the 256 byte array would need to be reconstructed each call 
+ * otherwise. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param colorUsed pointer to a 256 byte array for keeping track of which 
+ *        colors in the color palette have been used. 
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError SetColorUsedArrayBitmapWag(BitmapWagImg * bm, 
+    uint8_t * colorUsed)
+{
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    size_t bitsPerPixel = bm->bmih.biBitCount;
+    size_t width = bm->bmih.biWidth;
+    size_t height = bm->bmih.biHeight;
+
+    // Find the amount of memory that needs to be allocated for the image array
+    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+
+    
+    if(colorUsed == NULL)
+    {
+        return BITMAPWAG_COLOR_ARRAY_NULL;
+    }
+    // Check if the bitmap bits pointer is null
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    // If a color palette is not being used 
+    if(bm->bmih.biBitCount > 8)
+    {
+        return BITMAPWAG_NO_COLOR_PALETTE; 
+    }
+
+    BitmapWagColorUsedJob job = {bm, colorUsed};
+
+    BITMAPWAG_COUNT(colorUsedRebuilds, 1);
+
+    // Set the index, each pixel contains, to one in the colorUsed array 
+    return RunRowsBitmapWag(ColorUsedRowsBitmapWag, &job, height, rowMemory);
+}
+
+/**
+ * compares color a to color b for equivalence, palettes match on red, green 
+ * and blue only so rgbReserved is ignored
+ *
+ * @param a first color to compare
+ * @param b second color to compare
+ * @return non-zero if identical
+ */
+static uint32_t CompareColors(const BitmapWagRgbQuad a, 
+    const BitmapWagRgbQuad b)
+{
+    return (a.rgbBlue == b.rgbBlue) && (a.rgbGreen == b.rgbGreen) 
+        && (a.rgbRed == b.rgbRed);
+}
+
+/**
+ * HashColorBitmapWag finds the home slot of a color in the palette hash table
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param color the color to hash, rgbReserved is ignored like CompareColors
+ * @return slot index in paletteHash
+ */
+static uint32_t HashColorBitmapWag(const BitmapWagRgbQuad color)
+{
+    const uint32_t key = ((uint32_t) color.rgbBlue) 
+        | ((uint32_t) color.rgbGreen << 8) 
+        | ((uint32_t) color.rgbRed << 16);
+
+    // Fibonacci hashing, keep the top bits of the product
+    return (key * 2654435761u) >> 23;
+}
+
+/**
+ * InsertPaletteHashBitmapWag adds a palette entry to the palette hash table. 
+ * If the color is already in the table the existing entry is kept so that 
+ * lookups return the lowest index of a color, like a linear scan would. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct that uses a color palette
+ * @param index index of the entry in aColors
+ */
+static void InsertPaletteHashBitmapWag(BitmapWagImg * bm, const uint8_t index)
+{
+    const BitmapWagRgbQuad color = (bm->aColors)[index];
+    uint32_t slot = HashColorBitmapWag(color);
+
+    while((bm->paletteHash)[slot] != 0)
+    {
+        if(CompareColors((bm->aColors)[(bm->paletteHash)[slot] - 1], color))
+        {
+            return;
+        }
+        slot = (slot + 1) & (BITMAPWAG_PALETTE_HASH_SIZE - 1);
+    }
+
+    (bm->paletteHash)[slot] = index + 1;
+}
+
+/**
+ * BuildPaletteHashBitmapWag rebuilds the palette hash table, the last color 
+ * cache and the free palette entry cursor from aColors and colorUsed. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ */
+static void BuildPaletteHashBitmapWag(BitmapWagImg * bm)
+{
+    for(uint32_t i = 0; i < BITMAPWAG_PALETTE_HASH_SIZE; i++)
+    {
+        (bm->paletteHash)[i] = 0;
+    }
+    bm->lastValid = 0;
+    bm->freeColor = 0;
+
+    if(bm->bmih.biBitCount > 8 || bm->aColors == NULL 
+        || bm->colorUsed == NULL)
+    {
+        return;
+    }
+
+    const uint16_t possibleColors = GetPossibleColorsBitmapWag(bm);
+
+    for(uint16_t i = 0; i < possibleColors; i++)
+    {
+        if((bm->colorUsed)[i])
+        {
+            InsertPaletteHashBitmapWag(bm, i);
+        }
+    }
+}
+
+/**
+ * FindPaletteIndexBitmapWag finds the index of a color in the color palette. 
+ * If the color is not yet in the palette, it is placed in the first unused 
+ * palette entry. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct that uses a color palette
+ * @param color the color to look up
+ * @param index pointer to the palette index to populate
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError FindPaletteIndexBitmapWag(BitmapWagImg * bm, 
+    const BitmapWagRgbQuad color, uint8_t * index)
+{
+    const uint16_t possibleColors = GetPossibleColorsBitmapWag(bm);
+
+    BITMAPWAG_COUNT(paletteLookups, 1);
+
+    // Fall back to scanning the palette when colorUsed could not be allocated
+    if(bm->colorUsed == NULL)
+    {
+        // colorUsedInt keeps track of which indicies in a color palette are in
+        // use. Use a stack allocated array because it's relatively small and 
+        // it's much faster than dynamic allocations 
+        uint8_t colorUsedInt [256] = {0};
+
+        BITMAPWAG_COUNT(colorUsedFallbacks, 1);
+        SetColorUsedArrayBitmapWag(bm, colorUsedInt);
+
+        // Find the index of the color specified in the input
+        for(uint16_t i = 0; i < possibleColors; i++)
+        { 
+            if(CompareColors((bm->aColors)[i], color) && colorUsedInt[i])
+            {
+                // If the colors are the same and the color is being used
+                // then set the index
+                BITMAPWAG_COUNT(paletteProbes, i + 1);
+                *index = i;
+                return BITMAPWAG_SUCCESS;
+            }
+        }
+
+        BITMAPWAG_COUNT(paletteProbes, possibleColors);
+
+        // If the color is not yet in the palette, find a new place for it
+        for(uint16_t i = 0; i < possibleColors; i++)
+        {
+            if(!colorUsedInt[i])
+            {
+                BITMAPWAG_COUNT(paletteInsertions, 1);
+                (bm->aColors)[i] = color;
+                *index = i;
+                return BITMAPWAG_SUCCESS;
+            }
+        }
+
+        // There was no space left in the palette 
+        return BITMAPWAG_PALETTE_NOT_WRITTEN;
+    }
+
+    // Runs of the same color are common, check the last color looked up
+    if(bm->lastValid && CompareColors(bm->lastColor, color))
+    {
+        *index = bm->lastIndex;
+        return BITMAPWAG_SUCCESS;
+    }
+
+    // Probe the hash table for the color
+    uint32_t slot = HashColorBitmapWag(color);
+
+    while((bm->paletteHash)[slot] != 0)
+    {
+        const uint8_t i = (bm->paletteHash)[slot] - 1;
+
+        BITMAPWAG_COUNT(paletteProbes, 1);
+
+        if(CompareColors((bm->aColors)[i], color))
+        {
+            *index = i;
+            bm->lastColor = color;
+            bm->lastIndex = i;
+            bm->lastValid = 1;
+            return BITMAPWAG_SUCCESS;
+        }
+        slot = (slot + 1) & (BITMAPWAG_PALETTE_HASH_SIZE - 1);
+    }
+
+    // If the color is not yet in the palette, put it in the first unused entry
+    while(bm->freeColor < possibleColors && (bm->colorUsed)[bm->freeColor])
+    {
+        bm->freeColor++;
+    }
+
+    // If there was no space left in the palette 
+    if(bm->freeColor >= possibleColors)
+    {
+        return BITMAPWAG_PALETTE_NOT_WRITTEN;
+    }
+
+    const uint8_t i = bm->freeColor;
+
+    BITMAPWAG_COUNT(paletteInsertions, 1);
+    (bm->colorUsed)[i] = 1;
+    (bm->aColors)[i] = color;
+    // slot is the empty slot the probe ended on
+    (bm->paletteHash)[slot] = i + 1;
+
+    *index = i;
+    bm->lastColor = color;
+    bm->lastIndex = i;
+    bm->lastValid = 1;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * CheckMasksBitmapWag validates channel masks
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param masks red, green, blue and alpha masks, alpha may be zero
+ * @param bitsPerPixel 16 or 32
+ * @return BITMAPWAG_SUCCESS if the masks can be used
+ */
+static BitmapWagError CheckMasksBitmapWag(const uint32_t masks[4], 
+    const uint16_t bitsPerPixel)
+{
+    uint32_t masksUsed = 0;
+
+    if(bitsPerPixel != 16 && bitsPerPixel != 32)
+    {
+        return BITMAPWAG_MASKS_NOT_SUPPORTED;
+    }
+
+    if((masks[0] | masks[1] | masks[2]) == 0)
+    {
+        return BITMAPWAG_MASKS_NOT_SUPPORTED;
+    }
+
+    // Every mask shall be one run of bits inside the pixel, with no two masks 
+    // sharing a bit
+    for(uint16_t c = 0; c < 4; c++)
+    {
+        const uint32_t mask = masks[c];
+        const uint32_t lowest = mask & (~mask + 1);
+
+        if((bitsPerPixel == 16 && mask > 0xFFFF) 
+            || (mask & masksUsed) != 0 
+            || ((mask + lowest) & mask) != 0)
+        {
+            return BITMAPWAG_MASKS_NOT_SUPPORTED;
+        }
+
+        masksUsed |= mask;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * CreateBitfieldsBitmapWag validates channel masks and builds the tables used 
+ * to encode and decode pixels with them. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param masks red, green, blue and alpha masks, alpha may be zero
+ * @param bitsPerPixel 16 or 32
+ * @param bm pointer to the bitmap struct whose buffer holds the tables
+ * @param bitfields pointer to populate with the tables
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError CreateBitfieldsBitmapWag(const uint32_t masks[4], 
+    const uint16_t bitsPerPixel, BitmapWagImg * bm, 
+    BitmapWagBitfields ** bitfields)
+{
+    BitmapWagError error = CheckMasksBitmapWag(masks, bitsPerPixel);
+
+    if(error)
+    {
+        return error;
+    }
+
+    // The tables have a fixed size, so any buffer already there holds them
+    size_t capacity = sizeof(BitmapWagBitfields);
+    BitmapWagBitfields * output = (BitmapWagBitfields *) 
+        ReserveBitmapWag(bm, &(bm->bitfieldsBuffer), &capacity, 
+        sizeof(BitmapWagBitfields), BITMAPWAG_ALIGN);
+
+    if(output == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    for(uint16_t c = 0; c < 4; c++)
+    {
+        const uint32_t mask = masks[c];
+        uint8_t shift = 0;
+        uint8_t width = 0;
+
+        while(mask != 0 && ((mask >> shift) & 1) == 0)
+        {
+            shift++;
+        }
+        while(shift + width < 32 && ((mask >> (shift + width)) & 1) != 0)
+        {
+            width++;
+        }
+
+        const uint8_t drop = (width > 8) ? width - 8 : 0;
+        const uint32_t maxDecoded = (1u << (width - drop)) - 1;
+        const uint64_t maxValue = (((uint64_t) 1) << width) - 1;
+
+        output->masks[c] = mask;
+        output->shift[c] = shift;
+        output->drop[c] = drop;
+
+        for(uint32_t v = 0; v < 256; v++)
+        {
+            output->decode[c][v] = (v <= maxDecoded && maxDecoded > 0) 
+                ? (uint8_t) ((v*255 + maxDecoded/2) / maxDecoded) : 0;
+            output->encode[c][v] = 
+                (uint32_t) (((v*maxValue + 127) / 255) << shift);
+        }
+    }
+
+    *bitfields = output;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * DecodeBitfieldsBitmapWag converts a pixel of a BI_BITFIELDS image to a color
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bitfields tables of the image
+ * @param pixel value of the pixel
+ * @return color of the pixel, rgbReserved holds the alpha channel
+ */
+static BitmapWagRgbQuad DecodeBitfieldsBitmapWag(
+    const BitmapWagBitfields * bitfields, const uint32_t pixel)
+{
+    BitmapWagRgbQuad color;
+    uint8_t channels[4];
+
+    for(uint16_t c = 0; c < 4; c++)
+    {
+        channels[c] = bitfields->decode[c][((pixel & bitfields->masks[c]) 
+            >> bitfields->shift[c]) >> bitfields->drop[c]];
+    }
+
+    color.rgbRed = channels[0];
+    color.rgbGreen = channels[1];
+    color.rgbBlue = channels[2];
+    color.rgbReserved = channels[3];
+
+    return color;
+}
+
+/**
+ * EncodeBitfieldsBitmapWag converts a color to a pixel of a BI_BITFIELDS image
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bitfields tables of the image
+ * @param color color to convert, rgbReserved is ignored
+ * @return value of the pixel, fully opaque if the image has an alpha channel
+ */
+static uint32_t EncodeBitfieldsBitmapWag(const BitmapWagBitfields * bitfields,
+    const BitmapWagRgbQuad color)
+{
+    return bitfields->encode[0][color.rgbRed] 
+        | bitfields->encode[1][color.rgbGreen] 
+        | bitfields->encode[2][color.rgbBlue] 
+        | bitfields->encode[3][0xFF];
+}
+
+/**
+ * LoadPixelBitmapWag reads a little endian 16 or 32 bit pixel 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param pixel pointer to the first byte of the pixel, need not be aligned
+ * @param bytesPerPixel 2 or 4
+ * @return value of the pixel
+ */
+static uint32_t LoadPixelBitmapWag(const uint8_t * pixel, 
+    const uint32_t bytesPerPixel)
+{
+    uint32_t value = pixel[0] | ((uint32_t) pixel[1] << 8);
+
+    if(bytesPerPixel == 4)
+    {
+        value |= ((uint32_t) pixel[2] << 16) | ((uint32_t) pixel[3] << 24);
+    }
+
+    return value;
+}
+
+/**
+ * StorePixelBitmapWag writes a little endian 16 or 32 bit pixel 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param pixel pointer to the first byte of the pixel, need not be aligned
+ * @param bytesPerPixel 2 or 4
+ * @param value value of the pixel
+ */
+static void StorePixelBitmapWag(uint8_t * pixel, const uint32_t bytesPerPixel,
+    const uint32_t value)
+{
+    pixel[0] = (uint8_t) value;
+    pixel[1] = (uint8_t) (value >> 8);
+
+    if(bytesPerPixel == 4)
+    {
+        pixel[2] = (uint8_t) (value >> 16);
+        pixel[3] = (uint8_t) (value >> 24);
+    }
+}
+
+const char * ErrorsToStringBitmapWag(const BitmapWagError error)
+{
+    switch(error)
+    {
+        case BITMAPWAG_SUCCESS: 
+            return "success";
+        case BITMAPWAG_NULL: 
+            return "bitmap null";
+        case BITMAPWAG_FILE_PATH_NULL: 
+            return "bitmap file null";
+        case BITMAPWAG_CANNOT_OPEN_FILE: 
+            return "bitmap cannot open file";
+        case BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED: 
+            return "bitmap allocate bitmap bits failed";
+        case BITMAPWAG_ALLOCATE_PALETTE_FAILED: 
+            return "bitmap allocate paletter failed";
+        case BITMAPWAG_BMFH_NOT_WRITTEN:
+            return "bitmap BMFH not written";
+        case BITMAPWAG_BMIH_NOT_WRITTEN:
+            return "bitmap BMIH not written";
+        case BITMAPWAG_PALETTE_NOT_WRITTEN:
+            return "bitmap palette not written because there's no space left";
+        case BITMAPWAG_IMAGE_NOT_WRITTEN:
+            return "bitmap image portion not written";
+        case BITMAPWAG_COLOR_ARRAY_NULL:
+            return "bitmap color used array null";
+        case BITMAPWAG_NO_COLOR_PALETTE:
+            return "bitmap no color palette used in this image";
+        case BITMAPWAG_BIBITS_NOT_SUPPORTED:
+            return "bitmap the bits per pixel value is not supported";
+        case BITMAPWAG_COLOR_PTR_NULL:
+            return "bitmap color pointer null";
+        case BITMAPWAG_BITMAPBITS_NULL:
+            return "bitmap aBitmapBits null";
+        case BITMAPWAG_COLOR_PALETTE_NULL:
+            return "bitmap aColor null";
+        case BITMAPWAG_COORDINATE_WIDTH_OUT:
+            return "bitmap coordinate width out of bounds";
+        case BITMAPWAG_COORDINATE_HEIGHT_OUT:
+            return "bitmap coordinate height out of bounds";
+        case BITMAPWAG_BMFH_NOT_READ:
+            return "bitmap BMFH not read";
+        case BITMAPWAG_BMIH_NOT_READ:
+            return "bitmap BMIH not read";
+        case BITMAPWAG_ACOLORS_NOT_READ:
+            return "bitmap color palette portion of file not read";
+        case BITMAPWAG_BITMAPBITS_NOT_READ:
+            return "bitmap image portion of file not read";
+        case BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE:
+            return "failed to allocate internal colorUsed array, perfomance \
+will be degraded";
+        case BITMAPWAG_NOTCONSTRUCTED: 
+            return "bitmap not constructed, ConstructBitmapWag() needs to be \
+needs to be called";
+        case BITMAPWAG_ALREADY_INIT:
+            return "bitmap has already been initialized and would be \
+initialized twice by calling this function";
+        case BITMAPWAG_READ_ONLY:
+            return "bitmap is mapped read only, pixels cannot be set";
+        case BITMAPWAG_MAP_FAILED:
+            return "bitmap file could not be memory mapped";
+        case BITMAPWAG_MAP_NOT_SUPPORTED:
+            return "bitmap memory mapping is not supported on this platform";
+        case BITMAPWAG_ALLOCATE_STREAM_FAILED:
+            return "bitmap allocate stream failed";
+        case BITMAPWAG_STREAM_INCOMPLETE:
+            return "bitmap stream ended before every row was pushed";
+        case BITMAPWAG_END_OF_IMAGE:
+            return "bitmap reader has handed out every row of the image";
+        case BITMAPWAG_BUFFER_NULL:
+            return "bitmap buffer pointer null";
+        case BITMAPWAG_BUFFER_TOO_SMALL:
+            return "bitmap buffer too small to hold the encoded image";
+        case BITMAPWAG_ALLOCATE_BUFFER_FAILED:
+            return "bitmap allocate buffer failed";
+        case BITMAPWAG_IO_NULL:
+            return "bitmap io pointer or io function pointer null";
+        case BITMAPWAG_CREATE_THREAD_FAILED:
+            return "failed to create a worker thread";
+        case BITMAPWAG_THREADS_NOT_SUPPORTED:
+            return "threads are not supported on this system";
+        case BITMAPWAG_COMPRESSION_NOT_SUPPORTED:
+            return "bitmap compression not supported";
+        case BITMAPWAG_WRITE_OPTIONS_NULL:
+            return "bitmap write options pointer null";
+        case BITMAPWAG_MASKS_NOT_SUPPORTED:
+            return "bitmap channel masks not supported";
+        case BITMAPWAG_STATS_NOT_SUPPORTED:
+            return "bitmap performance counters not supported";
+        case BITMAPWAG_DITHER_NOT_SUPPORTED:
+            return "bitmap dithering not supported";
+        case BITMAPWAG_ALLOCATOR_NULL:
+            return "bitmap allocator alloc function null";
+        case BITMAPWAG_ALLOCATE_ARENA_FAILED:
+            return "bitmap arena allocation failed";
+        case BITMAPWAG_WRITE_PENDING:
+            return "bitmap write has not finished";
+        case BITMAPWAG_WRITE_QUEUE_FULL:
+            return "bitmap write queue full";
+        case BITMAPWAG_INVALID_FILE:
+            return "bitmap file offset to image bits invalid";
+        case BITMAPWAG_IMAGE_TOO_LARGE:
+            return "bitmap image too large";
+        default: 
+            return "unknown error"; 
+    }
+}
+
+BitmapWagImg * ConstructBitmapWag(void) 
+{
+    return ConstructBitmapWagWithAllocator(&allocatorBitmapWag);
+}
+
+BitmapWagImg * ConstructBitmapWagWithAllocator(
+    const BitmapWagAllocator * allocator)
+{
+    if(allocator == NULL || allocator->alloc == NULL)
+    {
+        return NULL;
+    }
+
+    BitmapWagImg * output = (BitmapWagImg *) 
+        AllocWithBitmapWag(allocator, sizeof(BitmapWagImg), BITMAPWAG_ALIGN);
+    if(output != NULL)
+    {
+        *output = (BitmapWagImg){0};
+        output->allocator = *allocator;
+        output->state = BITMAPWAG_STATE_CONSTRUCTED;
+    }
+    return output;
+}
+
+// Buffer in memory used as the user data of a memory BitmapWagIo
+typedef struct {
+    // start of the buffer
+    uint8_t * data;
+    // size of data in bytes
+    size_t size;
+    // offset of the next byte to read or write
+    size_t offset;
+} BitmapWagMemory;
+
+/**
+ * FileReadBitmapWag is the read function of a file BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user FILE pointer to read from
+ * @param data buffer to read into
+ * @param size number of bytes to read
+ * @return number of bytes read
+ */
+static size_t FileReadBitmapWag(void * user, void * data, const size_t size)
+{
+    return fread(data, sizeof(uint8_t), size, (FILE *) user);
+}
+
+/**
+ * FileWriteBitmapWag is the write function of a file BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user FILE pointer to write to
+ * @param data bytes to write
+ * @param size number of bytes to write
+ * @return number of bytes written
+ */
+static size_t FileWriteBitmapWag(void * user, const void * data, 
+    const size_t size)
+{
+    return fwrite(data, sizeof(uint8_t), size, (FILE *) user);
+}
+
+/**
+ * FileSeekBitmapWag is the seek function of a file BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user FILE pointer to seek in
+ * @param offset offset to seek to, relative to whence
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END
+ * @return zero if successful
+ */
+static int FileSeekBitmapWag(void * user, const int64_t offset, 
+    const int whence)
+{
+    return fseek((FILE *) user, (long) offset, whence);
+}
+
+/**
+ * FileTellBitmapWag is the tell function of a file BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user FILE pointer
+ * @return current offset in the file, -1 if it is not known
+ */
+static int64_t FileTellBitmapWag(void * user)
+{
+    return ftell((FILE *) user);
+}
+
+/**
+ * SetFileIoBitmapWag points a BitmapWagIo at an open file
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to populate
+ * @param fp open file
+ */
+static void SetFileIoBitmapWag(BitmapWagIo * io, FILE * fp)
+{
+    io->read = FileReadBitmapWag;
+    io->write = FileWriteBitmapWag;
+    io->seek = FileSeekBitmapWag;
+    io->tell = FileTellBitmapWag;
+    io->user = fp;
+}
+
+/**
+ * MemoryReadBitmapWag is the read function of a memory BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user BitmapWagMemory to read from
+ * @param data buffer to read into
+ * @param size number of bytes to read
+ * @return number of bytes read
+ */
+static size_t MemoryReadBitmapWag(void * user, void * data, const size_t size)
+{
+    BitmapWagMemory * memory = (BitmapWagMemory *) user;
+    size_t bytesLeft = memory->size - memory->offset;
+    size_t bytesRead = (size < bytesLeft) ? size : bytesLeft;
+
+    memcpy(data, &(memory->data)[memory->offset], bytesRead);
+    memory->offset += bytesRead;
+
+    return bytesRead;
+}
+
+/**
+ * MemoryWriteBitmapWag is the write function of a memory BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user BitmapWagMemory to write to
+ * @param data bytes to write
+ * @param size number of bytes to write
+ * @return number of bytes written
+ */
+static size_t MemoryWriteBitmapWag(void * user, const void * data, 
+    const size_t size)
+{
+    BitmapWagMemory * memory = (BitmapWagMemory *) user;
+    size_t bytesLeft = memory->size - memory->offset;
+    size_t bytesWritten = (size < bytesLeft) ? size : bytesLeft;
+
+    memcpy(&(memory->data)[memory->offset], data, bytesWritten);
+    memory->offset += bytesWritten;
+
+    return bytesWritten;
+}
+
+/**
+ * MemorySeekBitmapWag is the seek function of a memory BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user BitmapWagMemory to seek in
+ * @param offset offset to seek to, relative to whence
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END
+ * @return zero if successful
+ */
+static int MemorySeekBitmapWag(void * user, const int64_t offset, 
+    const int whence)
+{
+    BitmapWagMemory * memory = (BitmapWagMemory *) user;
+    int64_t base = 0;
+
+    if(whence == SEEK_CUR)
+    {
+        base = memory->offset;
+    }
+    else if(whence == SEEK_END)
+    {
+        base = memory->size;
+    }
+
+    if(base + offset < 0 || (uint64_t) (base + offset) > memory->size)
+    {
+        return -1;
+    }
+
+    memory->offset = base + offset;
+
+    return 0;
+}
+
+/**
+ * MemoryTellBitmapWag is the tell function of a memory BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param user BitmapWagMemory
+ * @return current offset in the buffer
+ */
+static int64_t MemoryTellBitmapWag(void * user)
+{
+    return ((BitmapWagMemory *) user)->offset;
+}
+
+/**
+ * SetMemoryIoBitmapWag points a BitmapWagIo at a buffer in memory
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to populate
+ * @param memory buffer to read from or write to
+ */
+static void SetMemoryIoBitmapWag(BitmapWagIo * io, BitmapWagMemory * memory)
+{
+    io->read = MemoryReadBitmapWag;
+    io->write = MemoryWriteBitmapWag;
+    io->seek = MemorySeekBitmapWag;
+    io->tell = MemoryTellBitmapWag;
+    io->user = memory;
+}
+
+/**
+ * ReadIoBitmapWag reads bytes through a BitmapWagIo, calling its read 
+ * function until every byte has arrived or no more bytes are available
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to read from
+ * @param dst buffer to read into
+ * @param size number of bytes to read
+ * @return 1 if every byte was read, 0 otherwise, like fread with one item
+ */
+static size_t ReadIoBitmapWag(const BitmapWagIo * io, void * dst, 
+    size_t size)
+{
+    uint8_t * bytes = (uint8_t *) dst;
+
+    while(size > 0)
+    {
+        size_t bytesRead = io->read(io->user, bytes, size);
+
+        if(bytesRead == 0 || bytesRead > size)
+        {
+            return 0;
+        }
+        BITMAPWAG_COUNT(bytesRead, bytesRead);
+        bytes += bytesRead;
+        size -= bytesRead;
+    }
+
+    return 1;
+}
+
+/**
+ * ReadIoUpToBitmapWag reads as many bytes through a BitmapWagIo as it has, up
+ * to size
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to read from
+ * @param dst buffer to read the bytes into
+ * @param size number of bytes to read
+ * @return number of bytes read, less than size at the end of the data or on 
+ *         error
+ */
+static size_t ReadIoUpToBitmapWag(const BitmapWagIo * io, void * dst, 
+    const size_t size)
+{
+    uint8_t * bytes = (uint8_t *) dst;
+    size_t total = 0;
+
+    while(total < size)
+    {
+        size_t bytesRead = io->read(io->user, bytes + total, size - total);
+
+        if(bytesRead == 0 || bytesRead > size - total)
+        {
+            break;
+        }
+        BITMAPWAG_COUNT(bytesRead, bytesRead);
+        total += bytesRead;
+    }
+
+    return total;
+}
+
+/**
+ * SkipIoBitmapWag skips ahead over bytes of a BitmapWagIo, reading and 
+ * discarding them if the BitmapWagIo can't seek
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to skip bytes of
+ * @param size number of bytes to skip
+ * @return 1 if successful, 0 if the BitmapWagIo ended before size bytes
+ */
+static int SkipIoBitmapWag(const BitmapWagIo * io, size_t size)
+{
+    uint8_t discard[256];
+
+    if(size == 0)
+    {
+        return 1;
+    }
+
+    if(io->seek != NULL && io->seek(io->user, size, SEEK_CUR) == 0)
+    {
+        return 1;
+    }
+
+    while(size > 0)
+    {
+        size_t bytesToRead = (size < sizeof(discard)) ? size : sizeof(discard);
+
+        if(!ReadIoBitmapWag(io, discard, bytesToRead))
+        {
+            return 0;
+        }
+        size -= bytesToRead;
+    }
+
+    return 1;
+}
+
+/**
+ * WriteIoBitmapWag writes bytes through a BitmapWagIo, calling its write 
+ * function until every byte has been taken
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to write to
+ * @param src bytes to write
+ * @param size number of bytes to write
+ * @return 1 if every byte was written, 0 otherwise, like fwrite with one item
+ */
+static size_t WriteIoBitmapWag(const BitmapWagIo * io, const void * src, 
+    size_t size)
+{
+    const uint8_t * bytes = (const uint8_t *) src;
+
+    while(size > 0)
+    {
+        size_t bytesWritten = io->write(io->user, bytes, size);
+
+        if(bytesWritten == 0 || bytesWritten > size)
+        {
+            return 0;
+        }
+        BITMAPWAG_COUNT(bytesWritten, bytesWritten);
+        bytes += bytesWritten;
+        size -= bytesWritten;
+    }
+
+    return 1;
+}
+
+/**
+ * ReadFileHeadersBitmapWag reads the bitmap file header, the bitmap info 
+ * header and the channel masks of a bitmap file and makes every check of 
+ * them that reading the file makes, for ReadHeadersBitmapWag and 
+ * ReadBitmapWagInfoIo alike. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param io BitmapWagIo to read from, positioned at the start of the file
+ * @param bmfh pointer to populate with the bitmap file header
+ * @param bmih pointer to populate with the bitmap info header, biHeight is 
+ *        made positive and BI_ALPHABITFIELDS becomes BI_BITFIELDS
+ * @param topDown pointer to populate with non-zero if the top row is stored 
+ *        first
+ * @param masks populated with the red, green, blue and alpha masks of 
+ *        BI_BITFIELDS images, zero for other images
+ * @param headerLeft pointer to populate with the bytes of a larger info 
+ *        header after the masks, io is left at the first of them
+ * @param paletteEnd pointer to populate with the offset of the end of the 
+ *        color palette, the first byte the image bits may start at
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_INVALID_FILE if 
+ *         bfOffBits points into the headers or the palette
+ */
+static BitmapWagError ReadFileHeadersBitmapWag(const BitmapWagIo * io, 
+    BitmapWagBmfh * bmfh, BitmapWagBmih * bmih, uint8_t * topDown, 
+    uint32_t masks[4], size_t * headerLeft, size_t * paletteEnd)
+{
+    // Bytes of the file up to the color palette
+    uint64_t headerSize = sizeof(*bmfh) + sizeof(*bmih);
+
+    *bmfh = (BitmapWagBmfh){0};
+    *bmih = (BitmapWagBmih){0};
+    *headerLeft = 0;
+
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        masks[i] = 0;
+    }
+
+    // Read the bitmap file header 
+    if(ReadIoBitmapWag(io, bmfh, sizeof(*bmfh)) != 1)
+    {
+        return BITMAPWAG_BMFH_NOT_READ;
+    }
+
+    // Read the bitmap info header 
+    if(ReadIoBitmapWag(io, bmih, sizeof(*bmih)) != 1)
+    {
+        return BITMAPWAG_BMIH_NOT_READ;
+    }
+
+    // A negative height marks a top-down image, whose rows are stored top row
+    // first. biHeight keeps the height itself and topDown the order. 
+    *topDown = ((int32_t) bmih->biHeight < 0);
+
+    if(*topDown)
+    {
+        bmih->biHeight = 0u - bmih->biHeight;
+
+        // Run length encoded images are always stored bottom row first
+        if(bmih->biCompression == BITMAPWAG_BI_RLE8 
+            || bmih->biCompression == BITMAPWAG_BI_RLE4)
+        {
+            return BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
+        }
+    }
+
+    const uint16_t bitsPerPixel = bmih->biBitCount;
+
+    // Rows of any other bits per pixel would be read past their end
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4 
+        && bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 24 
+        && bitsPerPixel != 32)
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    // Sizes worked out from a crafted header must not wrap around
+    BitmapWagError error = CheckImageSizeBitmapWag(bmih->biWidth, 
+        bmih->biHeight, bitsPerPixel);
+
+    if(error)
+    {
+        return error;
+    }
+
+    const uint32_t compression = bmih->biCompression;
+    const int hasMasks = (compression == BITMAPWAG_BI_BITFIELDS 
+        || compression == BITMAPWAG_BI_ALPHABITFIELDS);
+
+    // V2 and later headers hold the masks right after the fields this 
+    // library reads, the rest of a larger header is left to the caller
+    if(bmih->biSize > sizeof(*bmih))
+    {
+        const size_t extraSize = bmih->biSize - sizeof(*bmih);
+        const size_t masksSize = (extraSize < 4*sizeof(uint32_t)) ? extraSize 
+            : 4*sizeof(uint32_t);
+
+        if(ReadIoBitmapWag(io, masks, masksSize) != 1)
+        {
+            return BITMAPWAG_BMIH_NOT_READ;
+        }
+        *headerLeft = extraSize - masksSize;
+        headerSize += extraSize;
+    }
+    // A 40 byte header is followed by three masks, or four with 
+    // BI_ALPHABITFIELDS
+    else if(hasMasks)
+    {
+        const size_t masksSize = (compression == BITMAPWAG_BI_BITFIELDS) ? 
+            3*sizeof(uint32_t) : 4*sizeof(uint32_t);
+
+        if(ReadIoBitmapWag(io, masks, masksSize) != 1)
+        {
+            return BITMAPWAG_BMIH_NOT_READ;
+        }
+        headerSize += masksSize;
+    }
+
+    if(hasMasks)
+    {
+        error = CheckMasksBitmapWag(masks, bitsPerPixel);
+
+        if(error)
+        {
+            return error;
+        }
+
+        bmih->biCompression = BITMAPWAG_BI_BITFIELDS;
+    }
+    else
+    {
+        // The masks of a larger header only count for BI_BITFIELDS images
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            masks[i] = 0;
+        }
+    }
+
+    if(!(bmih->biCompression == BITMAPWAG_BI_RGB 
+        || bmih->biCompression == BITMAPWAG_BI_BITFIELDS
+        || (bmih->biCompression == BITMAPWAG_BI_RLE8 && bitsPerPixel == 8)
+        || (bmih->biCompression == BITMAPWAG_BI_RLE4 && bitsPerPixel == 4)))
+    {
+        return BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
+    }
+
+    // Images of 256 colors or less are followed by their color palette
+    uint64_t sizeOfPalette = 0;
+
+    if(bitsPerPixel <= 8)
+    {
+        sizeOfPalette = ((bmih->biClrUsed > 0) ? (uint64_t) bmih->biClrUsed 
+            : (1u << bitsPerPixel)) * sizeof(BitmapWagRgbQuad);
+    }
+
+    // The image bits start at bfOffBits, writers may leave a gap before them
+    if(bmfh->bfOffBits < headerSize + sizeOfPalette)
+    {
+        return BITMAPWAG_INVALID_FILE;
+    }
+    *paletteEnd = (size_t) (headerSize + sizeOfPalette);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * ReadHeadersBitmapWag reads the bitmap file header, the bitmap info header 
+ * and the color palette of a bitmap file, leaving the file positioned at the 
+ * start of the image bits. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param io BitmapWagIo to read from, positioned at the start of the file
+ * @param allocateColorUsed allocate the colorUsed array if non-zero
+ * @return BITMAPWAG_SUCCESS if successful, see ReadFileHeadersBitmapWag for
+ *         the checks made on the headers
+ * @note bm->colorUsed is left NULL if it could not be allocated, this is not
+ *       an error. 
+ */
+static BitmapWagError ReadHeadersBitmapWag(BitmapWagImg * bm, 
+    const BitmapWagIo * io, const uint8_t allocateColorUsed)
+{
+    size_t itemsRead;
+    // Red, green, blue and alpha masks of BI_BITFIELDS images
+    uint32_t masks[4];
+    // Bytes of a larger info header past the masks
+    size_t headerLeft;
+    // Offset of the first byte after the color palette
+    size_t paletteEnd;
+
+    bm->aColors = NULL;
+    bm->aBitmapBits = NULL;
+    bm->colorUsed = NULL;
+    bm->bitfields = NULL;
+
+    BitmapWagError error = ReadFileHeadersBitmapWag(io, &(bm->bmfh), 
+        &(bm->bmih), &(bm->topDown), masks, &headerLeft, &paletteEnd);
+
+    if(error)
+    {
+        return error;
+    }
+
+    if(!SkipIoBitmapWag(io, headerLeft))
+    {
+        return BITMAPWAG_BMIH_NOT_READ;
+    }
+
+    if(bm->bmih.biCompression == BITMAPWAG_BI_BITFIELDS)
+    {
+        error = CreateBitfieldsBitmapWag(masks, bm->bmih.biBitCount, bm, 
+            &(bm->bitfields));
+
+        if(error)
+        {
+            return error;
+        }
+
+        // Indicate that bm has been initialized so the masks are freed
+        bm->state = BITMAPWAG_STATE_INITIALIZED;
+    }
+
+    // Read the color palette if we're using 256-colors or less
+    if(bm->bmih.biBitCount <= 8)
+    {
+        size_t sizeOfPalette;
+        size_t sizeOfColorUsed;
+        size_t numColors;
+        if(bm->bmih.biClrUsed > 0)
+        {
+            numColors = bm->bmih.biClrUsed;
+        }
+        else
+        {
+            // Calculate number of colors based on biBitCount
+            numColors = 1 << bm->bmih.biBitCount;    
+        }
+        // Pixels can hold any index their bits allow, a shorter palette gets
+        // black entries after it so no index reads past its end
+        const size_t numEntries = (numColors > (1u << bm->bmih.biBitCount)) ?
+            numColors : (1u << bm->bmih.biBitCount);
+
+        // Calculate size of arrays to allocate 
+        sizeOfPalette = numColors * sizeof(BitmapWagRgbQuad);
+        sizeOfColorUsed = numColors * sizeof(uint8_t);
+
+        bm->aColors = (BitmapWagRgbQuad *) ReserveBitmapWag(bm, 
+            &(bm->colorsBuffer), &(bm->colorsCapacity), 
+            numEntries * sizeof(BitmapWagRgbQuad), BITMAPWAG_ALIGN);
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_ALLOCATE_PALETTE_FAILED;
+        }
+        // Indicate that bm has been initialized
+        bm->state = BITMAPWAG_STATE_INITIALIZED;
+
+        memset(&(bm->aColors)[numColors], 0, 
+            (numEntries - numColors) * sizeof(BitmapWagRgbQuad));
+        itemsRead = ReadIoBitmapWag(io, bm->aColors, sizeOfPalette);
+
+        if(itemsRead != 1)
+        {
+            return BITMAPWAG_ACOLORS_NOT_READ;
+        }
+
+        if(allocateColorUsed)
+        {
+            // Allocate the space for the colorUsed record
+            bm->colorUsed = (uint8_t *) ReserveBitmapWag(bm, 
+                &(bm->colorUsedBuffer), &(bm->colorUsedCapacity), 
+                sizeOfColorUsed, BITMAPWAG_ALIGN);
+        }
+
+        if(bm->colorUsed != NULL)
+        {
+            // Initialize all values in colorUsed to be all zeros
+            for(size_t i = 0; i < numColors; i++)
+            {
+                (bm->colorUsed)[i] = 0;
+            }
+        }
+    }
+    else
+    {
+        bm->aColors = NULL;
+    }
+
+    // Io without seek, such as pipes, read and discard the gap
+    if(!SkipIoBitmapWag(io, bm->bmfh.bfOffBits - paletteEnd))
+    {
+        return BITMAPWAG_BITMAPBITS_NOT_READ;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * SetRleIndexBitmapWag sets the palette index of one pixel decoded from run 
+ * length encoded image bits, pixels outside the image are dropped. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct with 4 or 8 bits per pixel
+ * @param x horizontal coordinate of the pixel (from left)
+ * @param y vertical coordinate of the pixel (from bottom)
+ * @param index palette index to set the pixel to
+ */
+static void SetRleIndexBitmapWag(BitmapWagImg * bm, const uint32_t x, 
+    const uint32_t y, const uint8_t index)
+{
+    if(x >= bm->bmih.biWidth || y >= bm->bmih.biHeight)
+    {
+        return;
+    }
+
+    uint8_t * row = RowBitmapWag(bm, y);
+
+    if(bm->bmih.biBitCount == 8)
+    {
+        row[x] = index;
+    }
+    else
+    {
+        // The first pixel of a byte is in the high nibble
+        const uint8_t sftAmnt = (x & 1) ? 0 : 4;
+
+        row[x >> 1] = (row[x >> 1] & ~(0x0F << sftAmnt)) 
+            | ((index & 0x0F) << sftAmnt);
+    }
+}
+
+// Encoded bits ReadRleBitmapWag holds at a time, more than the longest run
+#define BITMAPWAG_RLE_CHUNK_SIZE (1 << 16)
+
+// Where DecodeRleBitmapWag left off, so the bits can be decoded a chunk at a
+// time
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    // done is non-zero once the end of bitmap marker or the top of the image
+    // is reached
+    uint8_t done;
+} BitmapWagRleState;
+
+/**
+ * DecodeRleBitmapWag decodes a chunk of BI_RLE8 or BI_RLE4 image bits into 
+ * the zeroed aBitmapBits of a bitmap. Runs that go past the edge of the image
+ * are clipped and pixels the data skips stay at palette index zero. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct with 4 or 8 bits per pixel
+ * @param state where the previous chunk left off, zeroed for the first one
+ * @param data run length encoded image bits
+ * @param size size of data in bytes
+ * @param last non-zero if data ends the image bits, a run cut off by its end
+ *        is then decoded as far as it goes instead of left for the next 
+ *        chunk
+ * @return number of bytes of data decoded, the rest start a run that 
+ *         continues in the next chunk
+ */
+static size_t DecodeRleBitmapWag(BitmapWagImg * bm, 
+    BitmapWagRleState * state, const uint8_t * data, const size_t size, 
+    const uint8_t last)
+{
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    uint32_t x = state->x;
+    uint32_t y = state->y;
+    size_t i = 0;
+
+    while(i + 1 < size && y < bm->bmih.biHeight)
+    {
+        const uint8_t count = data[i];
+        const uint8_t value = data[i + 1];
+
+        // Encoded mode, a run of count pixels. RLE4 runs alternate between 
+        // the two indices in value. 
+        if(count > 0)
+        {
+            for(uint32_t k = 0; k < count; k++)
+            {
+                const uint8_t index = (bitsPerPixel == 8) ? value 
+                    : ((k & 1) ? (value & 0x0F) : (value >> 4));
+
+                SetRleIndexBitmapWag(bm, x + k, y, index);
+            }
+            x += count;
+            i += 2;
+        }
+        // End of line
+        else if(value == 0)
+        {
+            x = 0;
+            y++;
+            i += 2;
+        }
+        // End of bitmap
+        else if(value == 1)
+        {
+            state->done = 1;
+            i += 2;
+            break;
+        }
+        // Delta, move right and up by the next two bytes
+        else if(value == 2)
+        {
+            if(i + 3 >= size)
+            {
+                break;
+            }
+            x += data[i + 2];
+            y += data[i + 3];
+            i += 4;
+        }
+        // Absolute mode, value literal pixels padded to a 16 bit boundary
+        else
+        {
+            const size_t numBytes = (bitsPerPixel == 8) ? value 
+                : ((size_t) value + 1) >> 1;
+            const size_t paddedBytes = (numBytes + 1) & ~((size_t) 1);
+
+            // Only the last chunk may leave out the padding
+            if(i + 2 + (last ? numBytes : paddedBytes) > size)
+            {
+                break;
+            }
+
+            for(uint32_t k = 0; k < value; k++)
+            {
+                const uint8_t * pixels = data + i + 2;
+                const uint8_t index = (bitsPerPixel == 8) ? pixels[k] 
+                    : ((k & 1) ? (pixels[k >> 1] & 0x0F) 
+                    : (pixels[k >> 1] >> 4));
+
+                SetRleIndexBitmapWag(bm, x + k, y, index);
+            }
+            x += value;
+            i += 2 + paddedBytes;
+        }
+    }
+
+    if(y >= bm->bmih.biHeight)
+    {
+        state->done = 1;
+    }
+
+    state->x = x;
+    state->y = y;
+
+    return (i < size) ? i : size;
+}
+
+/**
+ * ReadRleBitmapWag reads and decodes the run length encoded image bits of a 
+ * BI_RLE8 or BI_RLE4 file a chunk at a time, so a wrong biSizeImage can't 
+ * make it allocate more than BITMAPWAG_RLE_CHUNK_SIZE. Reading stops at the
+ * end of bitmap marker, which may come before biSizeImage bytes. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct with zeroed aBitmapBits
+ * @param io I/O functions positioned at the start of the image bits
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ReadRleBitmapWag(BitmapWagImg * bm, 
+    const BitmapWagIo * io)
+{
+    size_t remaining = bm->bmih.biSizeImage;
+
+    // biSizeImage is required for compressed images, but some writers leave 
+    // it zero, so fall back to what's left of the file
+    if(remaining == 0)
+    {
+        if(bm->bmfh.bfSize <= bm->bmfh.bfOffBits)
+        {
+            return BITMAPWAG_BITMAPBITS_NOT_READ;
+        }
+        remaining = bm->bmfh.bfSize - bm->bmfh.bfOffBits;
+    }
+
+    const size_t capacity = (remaining < BITMAPWAG_RLE_CHUNK_SIZE) ? 
+        remaining : BITMAPWAG_RLE_CHUNK_SIZE;
+    uint8_t * data = (uint8_t *) AllocBitmapWag(capacity);
+
+    if(data == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    BitmapWagRleState state = {0};
+    // Bytes of data holding the start of a run the last chunk cut off
+    size_t held = 0;
+    // Non-zero once the io has no more data
+    uint8_t ended = 0;
+
+    while(remaining > 0 && !state.done && !ended)
+    {
+        const size_t bytesToRead = (capacity - held < remaining) ? 
+            capacity - held : remaining;
+        const size_t bytesRead = ReadIoUpToBitmapWag(io, data + held, 
+            bytesToRead);
+
+        ended = (bytesRead < bytesToRead);
+        held += bytesRead;
+        remaining -= bytesRead;
+
+        const size_t used = DecodeRleBitmapWag(bm, &state, data, held, 
+            remaining == 0 || ended);
+
+        memmove(data, data + used, held - used);
+        held -= used;
+    }
+
+    free(data);
+
+    // The data ran out before biSizeImage bytes without ending the bitmap
+    if(ended && !state.done)
+    {
+        return BITMAPWAG_BITMAPBITS_NOT_READ;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * ReadImageBitmapWag reads a whole bitmap through a BitmapWagIo, it is the 
+ * body of ReadBitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param io BitmapWagIo to read from
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ReadImageBitmapWag(BitmapWagImg * bm, 
+    const BitmapWagIo * io)
+{
+    size_t itemsRead;
+    BitmapWagError retVal = BITMAPWAG_SUCCESS;
+
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(io == NULL || io->read == NULL)
+    {
+        return BITMAPWAG_IO_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOTCONSTRUCTED;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    // Read the headers and the color palette 
+    retVal = ReadHeadersBitmapWag(bm, io, 1);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    // if colorUsed failed to allocate, it's not an error, and there are 
+    // fallbacks but it will really  slow down the performance of the 
+    // library so the application should be notified 
+    if(bm->bmih.biBitCount <= 8 && bm->colorUsed == NULL)
+    {
+        retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
+    }
+
+    uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    uint32_t width = bm->bmih.biWidth;
+    uint32_t height = bm->bmih.biHeight;
+    uint32_t compression = bm->bmih.biCompression;
+
+    // Find the amount of memory that needs to be allocated for the image array
+    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+
+    size_t bytesForImage = rowMemory * height;
+
+    // Allocate the memory for the image
+    bm->aBitmapBits = (uint8_t *) ReserveBitmapWag(bm, &(bm->bitsBuffer), 
+        &(bm->bitsCapacity), bytesForImage, BITMAPWAG_BITS_ALIGN);
+
+    if(bm->aBitmapBits == NULL)
+    {
         return BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED;
     }
 
-    // Indicate that bm has been initialized
-    bm->state = BITMAPWAG_STATE_INITIALIZED;
+    SetRowsBitmapWag(bm, height, rowMemory);
+
+    // Indicate that bm has been initialized
+    bm->state = BITMAPWAG_STATE_INITIALIZED;
+
+    if(compression == BITMAPWAG_BI_RLE8 || compression == BITMAPWAG_BI_RLE4)
+    {
+        // Pixels the encoded data skips over are palette index zero
+        memset(bm->aBitmapBits, 0x00, bytesForImage);
+
+        BitmapWagError error = ReadRleBitmapWag(bm, io);
+
+        if(error)
+        {
+            return error;
+        }
+
+        // The image is held uncompressed, writing it compresses it again
+        bm->bmih.biCompression = BITMAPWAG_BI_RGB;
+        bm->bmih.biSizeImage = 0;
+        bm->writeOptions.compression = BITMAPWAG_COMPRESSION_RLE;
+    }
+    else
+    {
+        // Read the image into memory 
+        itemsRead = ReadIoBitmapWag(io, bm->aBitmapBits, bytesForImage);
+
+        if(itemsRead != 1)
+        {
+            return BITMAPWAG_BITMAPBITS_NOT_READ;
+        }
+    }
+
+    // Initialize color used array
+    if(bm->bmih.biBitCount <= 8 && bm->colorUsed != NULL)
+    {
+        SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
+        // NOTE: We don't look at error values because none of them are valid
+        // for this function in this usage. 
+
+        BuildPaletteHashBitmapWag(bm);
+    }
+
+    // Return successful 
+    return retVal;
+}
+
+BitmapWagError ReadBitmapWagIo(BitmapWagImg * bm, const BitmapWagIo * io)
+{
+    BITMAPWAG_TIME_START(start);
+    const BitmapWagError retVal = ReadImageBitmapWag(bm, io);
+
+    BITMAPWAG_TIME_END(readNs, start);
+
+    return retVal;
+}
+
+BitmapWagError ReadBitmapWag(BitmapWagImg * bm, const char * filePath)
+{
+    BitmapWagIo io;
+    FILE *fp;
+    BitmapWagError retVal;
+
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if (filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOTCONSTRUCTED;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    // open filePath as binary file for reading 
+    fp = fopen(filePath, "rb");
+
+    if(fp == NULL)
+    {
+        return BITMAPWAG_CANNOT_OPEN_FILE;
+    }
+
+    SetFileIoBitmapWag(&io, fp);
+    retVal = ReadBitmapWagIo(bm, &io);
+
+    //close the file
+    fclose(fp);
+
+    return retVal;
+}
+
+BitmapWagError ReadBitmapWagInto(BitmapWagImg * bm, const char * filePath)
+{
+    BitmapWagError retVal = ResetBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    return ReadBitmapWag(bm, filePath);
+}
+
+BitmapWagError ReadBitmapWagFromMemory(BitmapWagImg * bm, const void * data,
+    const size_t size)
+{
+    BitmapWagIo io;
+    BitmapWagMemory memory = {0};
+
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(data == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    // The buffer is only read from, so casting away const is safe
+    memory.data = (uint8_t *) data;
+    memory.size = size;
+    SetMemoryIoBitmapWag(&io, &memory);
+
+    return ReadBitmapWagIo(bm, &io);
+}
+
+BitmapWagError ReadBitmapWagInfoIo(const BitmapWagIo * io, 
+    BitmapWagInfo * info)
+{
+    BitmapWagBmfh bmfh;
+    BitmapWagBmih bmih;
+    uint8_t topDown;
+    // Red, green, blue and alpha masks of BI_BITFIELDS images
+    uint32_t masks[4];
+    size_t headerLeft;
+    size_t paletteEnd;
+
+    if(io == NULL || io->read == NULL)
+    {
+        return BITMAPWAG_IO_NULL;
+    }
+
+    if(info == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    // The same checks ReadBitmapWag makes, without reading the palette
+    BitmapWagError error = ReadFileHeadersBitmapWag(io, &bmfh, &bmih, 
+        &topDown, masks, &headerLeft, &paletteEnd);
+
+    if(error)
+    {
+        return error;
+    }
+
+    if(!SkipIoBitmapWag(io, headerLeft))
+    {
+        return BITMAPWAG_BMIH_NOT_READ;
+    }
+
+    const uint16_t bitsPerPixel = bmih.biBitCount;
+
+    info->width = bmih.biWidth;
+    info->height = bmih.biHeight;
+    info->bitsPerPixel = bitsPerPixel;
+    info->topDown = topDown;
+    info->compression = (bmih.biCompression == BITMAPWAG_BI_RLE8 
+        || bmih.biCompression == BITMAPWAG_BI_RLE4) ? 
+        BITMAPWAG_COMPRESSION_RLE : BITMAPWAG_COMPRESSION_NONE;
+
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        info->masks[i] = masks[i];
+    }
+
+    info->numColors = 0;
+
+    if(bitsPerPixel <= 8)
+    {
+        info->numColors = (bmih.biClrUsed > 0) ? bmih.biClrUsed 
+            : (1u << bitsPerPixel);
+    }
+
+    info->offset = bmfh.bfOffBits;
+    // biSizeImage may be zero for uncompressed images, whose size is worked 
+    // out in 64 bits as it may not fit in 32
+    info->imageSize = (info->compression == BITMAPWAG_COMPRESSION_RLE) ? 
+        bmih.biSizeImage 
+        : (uint64_t) GetRowMemory(bmih.biWidth, bitsPerPixel) * bmih.biHeight;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError ReadBitmapWagInfo(const char * filePath, BitmapWagInfo * info)
+{
+    BitmapWagIo io;
+    FILE *fp;
+    // Room for the file header, the info header and four channel masks
+    char header[sizeof(BitmapWagBmfh) + sizeof(BitmapWagBmih) 
+        + 4*sizeof(uint32_t)];
+
+    if (filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+
+    // open filePath as binary file for reading 
+    fp = fopen(filePath, "rb");
+
+    if(fp == NULL)
+    {
+        return BITMAPWAG_CANNOT_OPEN_FILE;
+    }
+
+    // A buffer the size of the headers fetches them with one read, rather 
+    // than a read of a whole stdio buffer, and the rest of a larger info 
+    // header is seeked past as ReadBitmapWag does
+    setvbuf(fp, header, _IOFBF, sizeof(header));
+    SetFileIoBitmapWag(&io, fp);
+
+    const BitmapWagError retVal = ReadBitmapWagInfoIo(&io, info);
+
+    //close the file
+    fclose(fp);
+
+    return retVal;
+}
+
+/**
+ * ExtractRowBitmapWag copies the pixels of a region row to the start of a 
+ * row of the region image, shifting sub-byte pixels so the first pixel of the
+ * region is the first pixel of the row, and zeroes the rest of the row
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param dst first byte of the row of the region image
+ * @param src byte of the source row holding the first pixel of the region
+ * @param shift bit position of the first pixel in src, from the top bit
+ * @param bits number of bits of pixels in the region row
+ * @param rowMemory size of the row of the region image in bytes
+ */
+static void ExtractRowBitmapWag(uint8_t * dst, const uint8_t * src, 
+    const uint32_t shift, const size_t bits, const size_t rowMemory)
+{
+    const size_t numBytes = (bits + 7) >> 3;
+
+    if(shift == 0)
+    {
+        // src may already be dst, read straight into the row
+        if(src != dst)
+        {
+            memcpy(dst, src, numBytes);
+        }
+    }
+    else
+    {
+        // The source bytes cover shift more bits than the row
+        const size_t srcBytes = (shift + bits + 7) >> 3;
+
+        for(size_t i = 0; i < numBytes; i++)
+        {
+            const uint8_t next = (i + 1 < srcBytes) ? src[i + 1] : 0;
+
+            dst[i] = (uint8_t) ((src[i] << shift) | (next >> (8 - shift)));
+        }
+    }
+
+    // Clear the pixels past the end of the region and the padding
+    if((bits & 7) != 0)
+    {
+        dst[numBytes - 1] &= (uint8_t) (0xFF << (8 - (bits & 7)));
+    }
+    memset(dst + numBytes, 0x00, rowMemory - numBytes);
+}
+
+/**
+ * ReadRegionBitmapWag reads a rectangle of a bitmap file, it is the body of 
+ * ReadBitmapWagRegion
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param io BitmapWagIo positioned at the start of the file, rows are 
+ *        skipped with seek when it has one and read and discarded otherwise
+ * @param x left edge of the rectangle
+ * @param y bottom edge of the rectangle
+ * @param w width of the rectangle
+ * @param h height of the rectangle
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ReadRegionBitmapWag(BitmapWagImg * bm, 
+    const BitmapWagIo * io, const uint32_t x, const uint32_t y, 
+    const uint32_t w, const uint32_t h)
+{
+    // Read the headers and the color palette 
+    BitmapWagError retVal = ReadHeadersBitmapWag(bm, io, 1);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    if(bm->bmih.biBitCount <= 8 && bm->colorUsed == NULL)
+    {
+        retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
+    }
+
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    const uint32_t height = bm->bmih.biHeight;
+    const uint32_t compression = bm->bmih.biCompression;
+    const int rle = (compression == BITMAPWAG_BI_RLE8 
+        || compression == BITMAPWAG_BI_RLE4);
+
+    if(x > width || w > width - x)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(y > height || h > height - y)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    // Run length encoded rows can't be found without decoding every row 
+    // before them, so the whole image is decoded and the rectangle cut out. 
+    // It comes from the allocator of bm like the rest of its memory. 
+    BitmapWagImg * whole = NULL;
+
+    if(rle)
+    {
+        whole = ConstructBitmapWagWithAllocator(&(bm->allocator));
+
+        if(whole == NULL)
+        {
+            return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+        }
+
+        // Zeroed bits of the full size, with the headers ReadRleBitmapWag 
+        // needs to find the size of the encoded bits
+        BitmapWagError error = InitializeBitmapWag(whole, height, width, 
+            bitsPerPixel);
+
+        if(error == BITMAPWAG_SUCCESS 
+            || error == BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+        {
+            whole->bmfh = bm->bmfh;
+            whole->bmih = bm->bmih;
+            error = ReadRleBitmapWag(whole, io);
+        }
+
+        if(error)
+        {
+            FreeBitmapWag(whole);
+            return error;
+        }
+    }
+
+    const size_t srcRowMemory = GetRowMemory(width, bitsPerPixel);
+    const size_t rowMemory = GetRowMemory(w, bitsPerPixel);
+    // Bits of pixels in a row of the rectangle
+    const size_t bits = (size_t) w * bitsPerPixel;
+    // Byte of a source row holding the first pixel of the rectangle, and the
+    // bit position of the pixel in it
+    const size_t firstByte = ((size_t) x * bitsPerPixel) >> 3;
+    const uint32_t shift = ((size_t) x * bitsPerPixel) & 7;
+    // Bytes of a source row covering the rectangle
+    const size_t srcBytes = (shift + bits + 7) >> 3;
+
+    // Allocate the memory for the image
+    bm->aBitmapBits = (uint8_t *) ReserveBitmapWag(bm, &(bm->bitsBuffer), 
+        &(bm->bitsCapacity), rowMemory * h, BITMAPWAG_BITS_ALIGN);
+
+    // Sub-byte pixels that don't start a byte are read into scratch first
+    uint8_t * scratch = (whole == NULL && shift != 0) ? 
+        (uint8_t *) AllocBitmapWag(srcBytes) : NULL;
+
+    if(bm->aBitmapBits == NULL || (whole == NULL && shift != 0 
+        && scratch == NULL))
+    {
+        FreeBitmapWag(whole);
+        return (bm->aBitmapBits == NULL) ? 
+            BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED 
+            : BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    bm->bmih.biWidth = w;
+    bm->bmih.biHeight = h;
+    SetRowsBitmapWag(bm, h, rowMemory);
+
+    // Indicate that bm has been initialized
+    bm->state = BITMAPWAG_STATE_INITIALIZED;
+
+    // Offset of the file the io is at, the headers leave it at the bits
+    int64_t position = bm->bmfh.bfOffBits;
+
+    // Rows are read in file order so the file is only ever read forwards, 
+    // skipping to each row works with or without seek
+    for(uint32_t j = 0; j < h; j++)
+    {
+        const uint32_t row = bm->topDown ? h - 1 - j : j;
+        uint8_t * dst = RowBitmapWag(bm, row);
+
+        if(whole != NULL)
+        {
+            ExtractRowBitmapWag(dst, RowBitmapWag(whole, y + row) 
+                + firstByte, shift, bits, rowMemory);
+            continue;
+        }
+
+        // Index of the row in the file
+        const uint32_t fileRow = bm->topDown ? height - 1 - (y + row) 
+            : y + row;
+        const int64_t offset = (int64_t) bm->bmfh.bfOffBits 
+            + (int64_t) fileRow * srcRowMemory + firstByte;
+        uint8_t * src = (scratch != NULL) ? scratch : dst;
+
+        if(!SkipIoBitmapWag(io, offset - position) 
+            || (srcBytes > 0 && ReadIoBitmapWag(io, src, srcBytes) != 1))
+        {
+            retVal = BITMAPWAG_BITMAPBITS_NOT_READ;
+            break;
+        }
+        position = offset + srcBytes;
+
+        ExtractRowBitmapWag(dst, src, shift, bits, rowMemory);
+    }
+
+    free(scratch);
+
+    if(whole != NULL)
+    {
+        // The image is held uncompressed, writing it compresses it again
+        bm->bmih.biCompression = BITMAPWAG_BI_RGB;
+        bm->writeOptions.compression = BITMAPWAG_COMPRESSION_RLE;
+        FreeBitmapWag(whole);
+    }
+    bm->bmih.biSizeImage = 0;
+
+    if(retVal == BITMAPWAG_BITMAPBITS_NOT_READ)
+    {
+        return retVal;
+    }
+
+    // Initialize color used array
+    if(bm->bmih.biBitCount <= 8 && bm->colorUsed != NULL)
+    {
+        SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
+        BuildPaletteHashBitmapWag(bm);
+    }
+
+    return retVal;
+}
+
+BitmapWagError ReadBitmapWagRegion(BitmapWagImg * bm, const char * filePath,
+    const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h)
+{
+    BitmapWagIo io;
+    FILE *fp;
+
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if (filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOTCONSTRUCTED;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    // open filePath as binary file for reading 
+    fp = fopen(filePath, "rb");
+
+    if(fp == NULL)
+    {
+        return BITMAPWAG_CANNOT_OPEN_FILE;
+    }
+
+    // Every row of the rectangle is a seek and a read of just its bytes, a 
+    // stdio buffer would read a whole block around each of them
+    setvbuf(fp, NULL, _IONBF, 0);
+    SetFileIoBitmapWag(&io, fp);
+
+    BITMAPWAG_TIME_START(start);
+    const BitmapWagError retVal = ReadRegionBitmapWag(bm, &io, x, y, w, h);
+
+    BITMAPWAG_TIME_END(readNs, start);
+
+    //close the file
+    fclose(fp);
+
+    return retVal;
+}
+
+/**
+ * MapImageBitmapWag maps the image bits of a bitmap file, it is the body of 
+ * ReadBitmapWagMapped
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param filePath path of the bitmap file
+ * @param mode whether pixels can be set on the image
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError MapImageBitmapWag(BitmapWagImg * bm, 
+    const char * filePath, const BitmapWagMapMode mode)
+{
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if (filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOTCONSTRUCTED;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+#ifdef BITMAPWAG_HAS_MMAP
+    BitmapWagIo io;
+    FILE *fp;
+    struct stat fileStat;
+    BitmapWagError retVal = BITMAPWAG_SUCCESS;
+    // Pixels can only be set on copy on write mappings
+    const uint8_t readOnly = (mode != BITMAPWAG_MAP_COPY_ON_WRITE);
+
+    // open filePath as binary file for reading 
+    fp = fopen(filePath, "rb");
+
+    if(fp == NULL)
+    {
+        return BITMAPWAG_CANNOT_OPEN_FILE;
+    }
+
+    // Read the headers and the color palette, the palette is small and is 
+    // modified when pixels are set, so it's copied rather than mapped
+    SetFileIoBitmapWag(&io, fp);
+    retVal = ReadHeadersBitmapWag(bm, &io, !readOnly);
+
+    if(retVal)
+    {
+        fclose(fp);
+        return retVal;
+    }
+
+    // Compressed image bits can't be used in place
+    if(bm->bmih.biCompression != BITMAPWAG_BI_RGB 
+        && bm->bmih.biCompression != BITMAPWAG_BI_BITFIELDS)
+    {
+        fclose(fp);
+        return BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
+    }
+
+    if(!readOnly && bm->bmih.biBitCount <= 8 && bm->colorUsed == NULL)
+    {
+        retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
+    }
+
+    // Make sure the file holds every row of the image, in 64 bits so a 
+    // crafted height can't wrap the size into one the file passes
+    const uint64_t bytesForImage = (uint64_t) GetRowMemory(bm->bmih.biWidth, 
+        bm->bmih.biBitCount) * bm->bmih.biHeight;
+
+    if(fstat(fileno(fp), &fileStat) != 0 
+        || (uint64_t) fileStat.st_size < bm->bmfh.bfOffBits
+        || (uint64_t) fileStat.st_size - bm->bmfh.bfOffBits < bytesForImage)
+    {
+        fclose(fp);
+        return BITMAPWAG_BITMAPBITS_NOT_READ;
+    }
+
+    // A private mapping never writes back to the file, so it is copy on write
+    void * mapping = mmap(NULL, fileStat.st_size, 
+        PROT_READ | (readOnly ? 0 : PROT_WRITE), MAP_PRIVATE, fileno(fp), 0);
+
+    // The mapping stays valid after the file is closed
+    fclose(fp);
+
+    if(mapping == MAP_FAILED)
+    {
+        return BITMAPWAG_MAP_FAILED;
+    }
+
+    bm->mapping = mapping;
+    bm->mappingSize = fileStat.st_size;
+    bm->readOnly = readOnly;
+    bm->aBitmapBits = ((uint8_t *) mapping) + bm->bmfh.bfOffBits;
+    SetRowsBitmapWag(bm, bm->bmih.biHeight, 
+        GetRowMemory(bm->bmih.biWidth, bm->bmih.biBitCount));
+
+    // Indicate that bm has been initialized
+    bm->state = BITMAPWAG_STATE_INITIALIZED;
+
+    // Initialize color used array
+    if(bm->bmih.biBitCount <= 8 && bm->colorUsed != NULL)
+    {
+        SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
+        BuildPaletteHashBitmapWag(bm);
+    }
+
+    return retVal;
+#else
+    (void) mode;
+    return BITMAPWAG_MAP_NOT_SUPPORTED;
+#endif
+}
+
+BitmapWagError ReadBitmapWagMapped(BitmapWagImg * bm, const char * filePath,
+    const BitmapWagMapMode mode)
+{
+    BITMAPWAG_TIME_START(start);
+    const BitmapWagError retVal = MapImageBitmapWag(bm, filePath, mode);
+
+    BITMAPWAG_TIME_END(readNs, start);
+
+    return retVal;
+}
+
+/**
+ * GetPaletteSizeBitmapWag gets the size in bytes of the color palette that is
+ * written to a file
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @return size of the color palette in bytes, zero if there is none
+ */
+static size_t GetPaletteSizeBitmapWag(const BitmapWagImg * bm)
+{
+    if(bm->bmih.biBitCount > 8)
+    {
+        return 0;
+    }
+
+    if(bm->bmih.biClrUsed > 0)
+    {
+        return bm->bmih.biClrUsed * sizeof(BitmapWagRgbQuad);
+    }
+
+    // Calculate number of colors based on biBitCount
+    size_t numColors = 1 << bm->bmih.biBitCount;
+    return numColors * sizeof(BitmapWagRgbQuad);
+}
+
+/**
+ * EncodeRleBitmapWag run length encodes the image bits of an 8 or 4 bit per 
+ * pixel bitmap as BI_RLE8 or BI_RLE4. Runs of three or more equal pixels are 
+ * encoded, anything else is written in absolute mode. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct with 4 or 8 bits per pixel
+ * @param data pointer to populate with the allocated encoded data, the caller 
+ *        frees it
+ * @param size pointer to populate with the size of the encoded data in bytes
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError EncodeRleBitmapWag(const BitmapWagImg * bm, 
+    uint8_t ** data, size_t * size)
+{
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    const uint32_t height = bm->bmih.biHeight;
+
+    // No run or literal takes more than two bytes per pixel, plus the end of 
+    // line after every row and the end of bitmap
+    uint8_t * output = (uint8_t *) 
+        AllocBitmapWag(height * (2*(size_t) width + 2) + 2);
+    uint8_t * indices = (uint8_t *) AllocBitmapWag(width ? width : 1);
+
+    if(output == NULL || indices == NULL)
+    {
+        free(output);
+        free(indices);
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    size_t n = 0;
+
+    for(uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t * row = RowBitmapWag(bm, y);
+
+        for(uint32_t x = 0; x < width; x++)
+        {
+            indices[x] = (bitsPerPixel == 8) ? row[x] 
+                : ((x & 1) ? (row[x >> 1] & 0x0F) : (row[x >> 1] >> 4));
+        }
+
+        uint32_t x = 0;
+
+        while(x < width)
+        {
+            uint32_t run = 1;
+
+            while(x + run < width && run < 255 
+                && indices[x + run] == indices[x])
+            {
+                run++;
+            }
+
+            // A literal runs up to the next three equal pixels
+            uint32_t end = x;
+
+            if(run < 3)
+            {
+                while(end < width && end - x < 255 
+                    && !(end + 2 < width && indices[end] == indices[end + 1] 
+                    && indices[end] == indices[end + 2]))
+                {
+                    end++;
+                }
+            }
+
+            // Absolute mode needs at least three pixels
+            if(end - x < 3)
+            {
+                output[n++] = (uint8_t) run;
+                output[n++] = (bitsPerPixel == 8) ? indices[x] 
+                    : (uint8_t) ((indices[x] << 4) | indices[x]);
+                x += run;
+                continue;
+            }
+
+            const uint32_t count = end - x;
+
+            output[n++] = 0;
+            output[n++] = (uint8_t) count;
+
+            if(bitsPerPixel == 8)
+            {
+                memcpy(&output[n], &indices[x], count);
+                n += count;
+            }
+            else
+            {
+                for(uint32_t k = 0; k < count; k += 2)
+                {
+                    output[n++] = (uint8_t) ((indices[x + k] << 4) 
+                        | ((k + 1 < count) ? indices[x + k + 1] : 0));
+                }
+            }
+
+            // Literals are padded to a 16 bit boundary
+            if(n & 1)
+            {
+                output[n++] = 0;
+            }
+
+            x = end;
+        }
+
+        // End of line, the last row ends with the end of bitmap instead
+        if(y + 1 < height)
+        {
+            output[n++] = 0;
+            output[n++] = 0;
+        }
+    }
+
+    output[n++] = 0;
+    output[n++] = 1;
+
+    free(indices);
+
+    *data = output;
+    *size = n;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * GetFileHeadersBitmapWag builds the headers written in front of the palette 
+ * and image bits. Headers read from a file may be larger than the 40 byte 
+ * header this library writes, so the sizes and offsets are always recomputed. 
+ * Channel masks follow a 40 byte header, or are part of a BITMAPV4HEADER 
+ * when there is an alpha mask. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param compression value of biCompression to write
+ * @param imageSize number of bytes of image bits that will be written
+ * @param bmfh pointer to populate with the file header
+ * @param bmih pointer to populate with the info header
+ * @param extra array of BITMAPWAG_V4_HEADER_SIZE bytes to populate with what 
+ *        is written between the info header and the palette
+ * @return number of bytes written to extra
+ */
+static size_t GetFileHeadersBitmapWag(const BitmapWagImg * bm, 
+    const uint32_t compression, const size_t imageSize, BitmapWagBmfh * bmfh, 
+    BitmapWagBmih * bmih, uint8_t * extra)
+{
+    size_t extraSize = 0;
+
+    *bmfh = bm->bmfh;
+    *bmih = bm->bmih;
+
+    bmih->biSize = sizeof(*bmih);
+
+    if(bm->topDown)
+    {
+        bmih->biHeight = 0u - bm->bmih.biHeight;
+    }
+
+    if(compression == BITMAPWAG_BI_BITFIELDS)
+    {
+        const uint32_t * masks = bm->bitfields->masks;
+
+        memset(extra, 0, BITMAPWAG_V4_HEADER_SIZE - sizeof(*bmih));
+
+        for(size_t i = 0; i < 16; i++)
+        {
+            extra[i] = (uint8_t) (masks[i >> 2] >> (8*(i & 3)));
+        }
+
+        if(masks[3] != 0)
+        {
+            const uint32_t colorSpace = BITMAPWAG_LCS_SRGB;
+
+            // The color space follows the masks, the end points and gamma 
+            // after it are zero
+            memcpy(&extra[16], &colorSpace, sizeof(colorSpace));
+            extraSize = BITMAPWAG_V4_HEADER_SIZE - sizeof(*bmih);
+            bmih->biSize = BITMAPWAG_V4_HEADER_SIZE;
+        }
+        else
+        {
+            extraSize = 3*sizeof(uint32_t);
+        }
+    }
+
+    const size_t offBits = sizeof(*bmfh) + sizeof(*bmih) + extraSize
+        + GetPaletteSizeBitmapWag(bm);
+
+    ((char *)&(bmfh->bfType))[0] = 'B';
+    ((char *)&(bmfh->bfType))[1] = 'M';
+    bmfh->bfOffBits = offBits;
+    bmfh->bfSize = offBits + imageSize;
+
+    bmih->biCompression = compression;
+    bmih->biSizeImage = (compression == BITMAPWAG_BI_RGB) ? 0 : imageSize;
+
+    return extraSize;
+}
+
+/**
+ * EncodeImageBitmapWag gets the image bits as they will be written, applying 
+ * the compression set with SetBitmapWagWriteOptions. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct that passed CheckWriteBitmapWag
+ * @param data pointer to populate with the image bits to write
+ * @param size pointer to populate with the size of the image bits in bytes
+ * @param compression pointer to populate with the value of biCompression
+ * @return BITMAPWAG_SUCCESS if successful, data shall be freed by the caller 
+ *         if it isn't aBitmapBits
+ */
+static BitmapWagError EncodeImageBitmapWag(const BitmapWagImg * bm, 
+    const uint8_t ** data, size_t * size, uint32_t * compression)
+{
+    if(bm->writeOptions.compression == BITMAPWAG_COMPRESSION_RLE)
+    {
+        uint8_t * encoded;
+        BitmapWagError error = EncodeRleBitmapWag(bm, &encoded, size);
+
+        if(error)
+        {
+            return error;
+        }
+
+        *data = encoded;
+        *compression = (bm->bmih.biBitCount == 8) ? BITMAPWAG_BI_RLE8 
+            : BITMAPWAG_BI_RLE4;
+        return BITMAPWAG_SUCCESS;
+    }
+
+    *data = bm->aBitmapBits;
+    *size = GetRowMemory(bm->bmih.biWidth, bm->bmih.biBitCount) 
+        * bm->bmih.biHeight;
+    *compression = (bm->bitfields != NULL) ? BITMAPWAG_BI_BITFIELDS 
+        : BITMAPWAG_BI_RGB;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * CheckWriteBitmapWag validates a bitmap before it is written
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @return BITMAPWAG_SUCCESS if the bitmap can be written
+ */
+static BitmapWagError CheckWriteBitmapWag(const BitmapWagImg * bm)
+{
+    // Check for null pointers before anything is done in this function.
+    if(bm == NULL) 
+    {
+        return BITMAPWAG_NULL;
+    }
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+    if(bm->bmih.biBitCount <= 8 && bm->aColors == NULL)
+    {
+        return BITMAPWAG_COLOR_PALETTE_NULL;
+    }
+    // Run length encoding is only defined for 4 and 8 bits per pixel, 
+    // stored bottom row first
+    if(bm->writeOptions.compression == BITMAPWAG_COMPRESSION_RLE 
+        && ((bm->bmih.biBitCount != 4 && bm->bmih.biBitCount != 8) 
+        || bm->topDown))
+    {
+        return BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * WriteImageBitmapWag writes a whole bitmap through a BitmapWagIo, it is the 
+ * body of WriteBitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to an initialized bitmap struct
+ * @param io BitmapWagIo to write to
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError WriteImageBitmapWag(const BitmapWagImg * bm, 
+    const BitmapWagIo * io)
+{
+    size_t itemsWritten;
+    BitmapWagError retVal = CheckWriteBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if(io == NULL || io->write == NULL)
+    {
+        return BITMAPWAG_IO_NULL;
+    }
+
+    const uint8_t * imageData;
+    size_t imageSize;
+    uint32_t compression;
+    BitmapWagBmfh bmfh;
+    BitmapWagBmih bmih;
+    uint8_t extra[BITMAPWAG_V4_HEADER_SIZE];
+
+    retVal = EncodeImageBitmapWag(bm, &imageData, &imageSize, &compression);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    const size_t extraSize = GetFileHeadersBitmapWag(bm, compression, 
+        imageSize, &bmfh, &bmih, extra);
+
+    // Write the bitmap file header 
+    itemsWritten = WriteIoBitmapWag(io, &bmfh, sizeof(bmfh));
+
+    if(itemsWritten != 1)
+    {
+        retVal = BITMAPWAG_BMFH_NOT_WRITTEN;
+    }
+
+    // Write the bitmap info header 
+    if(retVal == BITMAPWAG_SUCCESS)
+    {
+        itemsWritten = WriteIoBitmapWag(io, &bmih, sizeof(bmih));
+
+        // Followed by the channel masks
+        if(itemsWritten == 1 && extraSize > 0)
+        {
+            itemsWritten = WriteIoBitmapWag(io, extra, extraSize);
+        }
+
+        if(itemsWritten != 1)
+        {
+            retVal = BITMAPWAG_BMIH_NOT_WRITTEN;
+        }
+    }
+
+    // Write the color palette if we're using 256-colors or less
+    if(retVal == BITMAPWAG_SUCCESS)
+    {
+        itemsWritten = WriteIoBitmapWag(io, bm->aColors, 
+            GetPaletteSizeBitmapWag(bm));
+
+        if(itemsWritten != 1)
+        {
+            retVal = BITMAPWAG_PALETTE_NOT_WRITTEN;
+        }
+    }
+
+    const size_t rowMemory = GetRowMemory(bm->bmih.biWidth, 
+        bm->bmih.biBitCount);
+
+    // Write the image bits
+    if(retVal == BITMAPWAG_SUCCESS && imageData == bm->aBitmapBits 
+        && GetStrideBitmapWag(bm) != rowMemory)
+    {
+        const size_t stride = GetStrideBitmapWag(bm);
+
+        // The rows of an external image are written one at a time, without 
+        // the bytes between them
+        for(uint32_t i = 0; i < bm->bmih.biHeight; i++)
+        {
+            itemsWritten = WriteIoBitmapWag(io, imageData + i*stride, 
+                rowMemory);
+
+            if(itemsWritten != 1)
+            {
+                retVal = BITMAPWAG_IMAGE_NOT_WRITTEN;
+                break;
+            }
+        }
+    }
+    else if(retVal == BITMAPWAG_SUCCESS)
+    {
+        itemsWritten = WriteIoBitmapWag(io, imageData, imageSize);
+
+        if(itemsWritten != 1)
+        {
+            retVal = BITMAPWAG_IMAGE_NOT_WRITTEN;
+        }
+    }
+
+    if(imageData != bm->aBitmapBits)
+    {
+        free((void *) imageData);
+    }
+
+    return retVal;
+}
+
+BitmapWagError WriteBitmapWagIo(const BitmapWagImg * bm, 
+    const BitmapWagIo * io)
+{
+    BITMAPWAG_TIME_START(start);
+    const BitmapWagError retVal = WriteImageBitmapWag(bm, io);
+
+    BITMAPWAG_TIME_END(writeNs, start);
+
+    return retVal;
+}
+
+BitmapWagError WriteBitmapWag(const BitmapWagImg * bm, 
+    const char * filePath)
+{
+    BitmapWagIo io;
+    FILE *fp;
+    BitmapWagError retVal = CheckWriteBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if (filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+
+    // open filePath as binary file for writing 
+    fp = fopen(filePath, "wb");
+
+    if(fp == NULL)
+    {
+        return BITMAPWAG_CANNOT_OPEN_FILE;
+    }
+
+    SetFileIoBitmapWag(&io, fp);
+    retVal = WriteBitmapWagIo(bm, &io);
+
+    //close the file
+    fclose(fp);
+
+    return retVal;
+}
+
+BitmapWagError GetBitmapWagEncodedSize(const BitmapWagImg * bm, 
+    size_t * size)
+{
+    BitmapWagError retVal = CheckWriteBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if(size == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    const uint8_t * imageData;
+    size_t imageSize;
+    uint32_t compression;
+
+    // The size of compressed image bits is only known after encoding them
+    retVal = EncodeImageBitmapWag(bm, &imageData, &imageSize, &compression);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    if(imageData != bm->aBitmapBits)
+    {
+        free((void *) imageData);
+    }
+
+    BitmapWagBmfh bmfh;
+    BitmapWagBmih bmih;
+    uint8_t extra[BITMAPWAG_V4_HEADER_SIZE];
+
+    GetFileHeadersBitmapWag(bm, compression, imageSize, &bmfh, &bmih, extra);
+
+    *size = bmfh.bfSize;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError SetBitmapWagWriteOptions(BitmapWagImg * bm, 
+    const BitmapWagWriteOptions * options)
+{
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+    if(options == NULL)
+    {
+        return BITMAPWAG_WRITE_OPTIONS_NULL;
+    }
+    if(options->compression != BITMAPWAG_COMPRESSION_NONE 
+        && options->compression != BITMAPWAG_COMPRESSION_RLE)
+    {
+        return BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
+    }
+
+    bm->writeOptions = *options;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError GetBitmapWagWriteOptions(const BitmapWagImg * bm, 
+    BitmapWagWriteOptions * options)
+{
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+    if(options == NULL)
+    {
+        return BITMAPWAG_WRITE_OPTIONS_NULL;
+    }
+
+    *options = bm->writeOptions;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError WriteBitmapWagToBuffer(const BitmapWagImg * bm, 
+    void * buffer, const size_t bufferSize, size_t * size)
+{
+    BitmapWagIo io;
+    BitmapWagMemory memory = {0};
+    size_t encodedSize;
+    BitmapWagError retVal = GetBitmapWagEncodedSize(bm, &encodedSize);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if(buffer == NULL || size == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    *size = encodedSize;
+
+    if(bufferSize < encodedSize)
+    {
+        return BITMAPWAG_BUFFER_TOO_SMALL;
+    }
+
+    memory.data = (uint8_t *) buffer;
+    memory.size = bufferSize;
+    SetMemoryIoBitmapWag(&io, &memory);
+
+    return WriteBitmapWagIo(bm, &io);
+}
+
+BitmapWagError WriteBitmapWagToMemory(const BitmapWagImg * bm, 
+    void ** buffer, size_t * size)
+{
+    size_t encodedSize;
+    BitmapWagError retVal = GetBitmapWagEncodedSize(bm, &encodedSize);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if(buffer == NULL || size == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    *buffer = AllocBitmapWag(encodedSize);
+
+    if(*buffer == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    retVal = WriteBitmapWagToBuffer(bm, *buffer, encodedSize, size);
+
+    if(retVal)
+    {
+        free(*buffer);
+        *buffer = NULL;
+    }
+
+    return retVal;
+}
+
+// Default number of writes WriteBitmapWagAsync queues before callers wait
+#define BITMAPWAG_WRITE_QUEUE_DEPTH 64
+
+struct BitmapWagWrite {
+    // next write in the queue
+    BitmapWagWrite * next;
+    // image to write and free when the I/O thread owns it, NULL otherwise
+    BitmapWagImg * bm;
+    // encoded bitmap file to write when the image was not handed over
+    void * data;
+    size_t size;
+    BitmapWagWriteCallback callback;
+    void * user;
+    BitmapWagError error;
+    uint8_t done;
+    // detached writes have no handle and are freed as soon as they finish
+    uint8_t detached;
+    char filePath[];
+};
+
+// BitmapWagWriter holds the I/O thread and the queue of writes it works on
+typedef struct {
+#ifdef BITMAPWAG_HAS_THREADS
+    // lock guards every member below it and the done member of every write
+    pthread_mutex_t lock;
+    // wake is signalled when a write is queued or the thread is stopped
+    pthread_cond_t wake;
+    // finished is broadcast when a write leaves the queue, a write finishes
+    // or the thread has been stopped
+    pthread_cond_t finished;
+    pthread_t thread;
+    uint8_t running;
+    uint8_t stop;
+    BitmapWagWrite * head;
+    BitmapWagWrite * tail;
+    // queued is the number of writes in the queue or being encoded for it
+    uint32_t queued;
+    // pending is the number of writes queued and not finished
+    uint32_t pending;
+#endif
+    uint32_t depth;
+} BitmapWagWriter;
+
+static BitmapWagWriter writer = {
+#ifdef BITMAPWAG_HAS_THREADS
+    .lock = PTHREAD_MUTEX_INITIALIZER, .wake = PTHREAD_COND_INITIALIZER, 
+    .finished = PTHREAD_COND_INITIALIZER, 
+#endif
+    .depth = BITMAPWAG_WRITE_QUEUE_DEPTH};
+
+/**
+ * RunWriteBitmapWag writes the file of a queued write, calls its callback 
+ * and frees what the write owns, the write itself is not freed
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param write the write to run
+ */
+static void RunWriteBitmapWag(BitmapWagWrite * write)
+{
+    if(write->bm != NULL)
+    {
+        write->error = WriteBitmapWag(write->bm, write->filePath);
+    }
+    else
+    {
+        FILE * fp = fopen(write->filePath, "wb");
+
+        if(fp == NULL)
+        {
+            write->error = BITMAPWAG_CANNOT_OPEN_FILE;
+        }
+        else
+        {
+            if(fwrite(write->data, 1, write->size, fp) != write->size)
+            {
+                write->error = BITMAPWAG_IMAGE_NOT_WRITTEN;
+            }
+            if(fclose(fp) != 0 && write->error == BITMAPWAG_SUCCESS)
+            {
+                write->error = BITMAPWAG_IMAGE_NOT_WRITTEN;
+            }
+        }
+    }
+
+    if(write->callback != NULL)
+    {
+        write->callback(write->user, write->filePath, write->error);
+    }
+
+    FreeBitmapWag(write->bm);
+    write->bm = NULL;
+    free(write->data);
+    write->data = NULL;
+}
+
+#ifdef BITMAPWAG_HAS_THREADS
+/**
+ * WriterBitmapWag is the body of the I/O thread, it runs queued writes until
+ * it is stopped and the queue is empty
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param arg unused
+ * @return NULL
+ */
+static void * WriterBitmapWag(void * arg)
+{
+    (void) arg;
+
+    pthread_mutex_lock(&writer.lock);
+
+    for(;;)
+    {
+        while(writer.head == NULL && !writer.stop)
+        {
+            pthread_cond_wait(&writer.wake, &writer.lock);
+        }
+
+        BitmapWagWrite * write = writer.head;
+
+        if(write == NULL)
+        {
+            pthread_mutex_unlock(&writer.lock);
+            return NULL;
+        }
+
+        writer.head = write->next;
+        if(writer.head == NULL)
+        {
+            writer.tail = NULL;
+        }
+        writer.queued--;
+        pthread_cond_broadcast(&writer.finished);
+        pthread_mutex_unlock(&writer.lock);
+
+        RunWriteBitmapWag(write);
+
+        pthread_mutex_lock(&writer.lock);
+        writer.pending--;
+        if(write->detached)
+        {
+            free(write);
+        }
+        else
+        {
+            write->done = 1;
+        }
+        pthread_cond_broadcast(&writer.finished);
+    }
+}
+#endif
+
+BitmapWagError WriteBitmapWagAsync(BitmapWagImg * bm, const char * filePath, 
+    const BitmapWagAsyncOptions * options, BitmapWagWrite ** write)
+{
+    const BitmapWagAsyncOptions defaults = {0};
+    BitmapWagError retVal = CheckWriteBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+    if(filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
+    if(options == NULL)
+    {
+        options = &defaults;
+    }
+
+    const size_t pathSize = strlen(filePath) + 1;
+    BitmapWagWrite * queued = (BitmapWagWrite *) 
+        AllocBitmapWag(sizeof(BitmapWagWrite) + pathSize);
+
+    if(queued == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    *queued = (BitmapWagWrite){0};
+    memcpy(queued->filePath, filePath, pathSize);
+    queued->callback = options->callback;
+    queued->user = options->user;
+    queued->detached = (write == NULL);
+
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+
+    // Wait for a flush to finish stopping the thread, then for room
+    while(writer.stop || writer.queued >= writer.depth)
+    {
+        if(!writer.stop && options->noWait)
+        {
+            pthread_mutex_unlock(&writer.lock);
+            free(queued);
+            return BITMAPWAG_WRITE_QUEUE_FULL;
+        }
+        pthread_cond_wait(&writer.finished, &writer.lock);
+    }
+
+    if(!writer.running)
+    {
+        if(pthread_create(&writer.thread, NULL, WriterBitmapWag, NULL) != 0)
+        {
+            pthread_mutex_unlock(&writer.lock);
+            free(queued);
+            return BITMAPWAG_CREATE_THREAD_FAILED;
+        }
+        writer.running = 1;
+    }
+
+    // Hold the place in the queue while the image is encoded
+    writer.queued++;
+    pthread_mutex_unlock(&writer.lock);
+#endif
+
+    if(options->takeOwnership)
+    {
+        queued->bm = bm;
+    }
+    else
+    {
+        retVal = WriteBitmapWagToMemory(bm, &queued->data, &queued->size);
+    }
+
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+
+    if(retVal)
+    {
+        writer.queued--;
+        pthread_cond_broadcast(&writer.finished);
+        pthread_mutex_unlock(&writer.lock);
+        free(queued);
+        return retVal;
+    }
+
+    if(writer.tail != NULL)
+    {
+        writer.tail->next = queued;
+    }
+    else
+    {
+        writer.head = queued;
+    }
+    writer.tail = queued;
+    writer.pending++;
+    pthread_cond_signal(&writer.wake);
+    pthread_mutex_unlock(&writer.lock);
+#else
+    if(retVal)
+    {
+        free(queued);
+        return retVal;
+    }
+
+    RunWriteBitmapWag(queued);
+    queued->done = 1;
+
+    if(queued->detached)
+    {
+        free(queued);
+    }
+#endif
+
+    if(write != NULL)
+    {
+        *write = queued;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError PollBitmapWagWrite(const BitmapWagWrite * write, 
+    BitmapWagError * error)
+{
+    if(write == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+#endif
+    const uint8_t done = write->done;
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_unlock(&writer.lock);
+#endif
+
+    if(!done)
+    {
+        return BITMAPWAG_WRITE_PENDING;
+    }
+    if(error != NULL)
+    {
+        *error = write->error;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError WaitBitmapWagWrite(BitmapWagWrite * write)
+{
+    if(write == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+    while(!write->done)
+    {
+        pthread_cond_wait(&writer.finished, &writer.lock);
+    }
+    pthread_mutex_unlock(&writer.lock);
+#endif
+
+    const BitmapWagError retVal = write->error;
+
+    free(write);
+
+    return retVal;
+}
+
+BitmapWagError SetBitmapWagWriteQueueDepth(const uint32_t depth)
+{
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+#endif
+    writer.depth = (depth == 0) ? BITMAPWAG_WRITE_QUEUE_DEPTH : depth;
+#ifdef BITMAPWAG_HAS_THREADS
+    // A deeper queue may let waiting callers in
+    pthread_cond_broadcast(&writer.finished);
+    pthread_mutex_unlock(&writer.lock);
+#endif
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError FlushBitmapWagWrites(void)
+{
+#ifdef BITMAPWAG_HAS_THREADS
+    pthread_mutex_lock(&writer.lock);
+
+    // Let another flush finish stopping the thread first
+    while(writer.stop)
+    {
+        pthread_cond_wait(&writer.finished, &writer.lock);
+    }
+
+    while(writer.pending > 0 || writer.queued > 0)
+    {
+        pthread_cond_wait(&writer.finished, &writer.lock);
+    }
+
+    if(writer.running)
+    {
+        writer.stop = 1;
+        pthread_cond_signal(&writer.wake);
+        pthread_mutex_unlock(&writer.lock);
+
+        pthread_join(writer.thread, NULL);
+
+        pthread_mutex_lock(&writer.lock);
+        writer.running = 0;
+        writer.stop = 0;
+        pthread_cond_broadcast(&writer.finished);
+    }
+
+    pthread_mutex_unlock(&writer.lock);
+#endif
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * SetHeadersBitmapWag fills in the bitmap file header and every member of the
+ * bitmap info header except biClrUsed for an uncompressed image. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to bitmap to populate
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel
+ * @param sizeOfPalette size of the color palette in bytes
+ */
+static void SetHeadersBitmapWag(BitmapWagImg * bm, const uint32_t height, 
+    const uint32_t width, const uint16_t bitsPerPixel, 
+    const size_t sizeOfPalette)
+{
+    const size_t bytesForImage = GetRowMemory(width, bitsPerPixel) * height;
+
+    // Set bmfh
+    ((char *)&(bm->bmfh.bfType))[0] = 'B';
+    ((char *)&(bm->bmfh.bfType))[1] = 'M';
+
+    bm->bmfh.bfSize = sizeof(bm->bmih) + sizeof(bm->bmfh) + sizeOfPalette 
+        + bytesForImage;
+
+    bm->bmfh.bfReserved1 = 0;
+    bm->bmfh.bfReserved2 = 0;
+    bm->bmfh.bfOffBits = sizeof(bm->bmfh) + sizeof(bm->bmih) + sizeOfPalette;
+
+    // Set bmih
+    bm->bmih.biSize = sizeof(bm->bmih);
+    bm->bmih.biWidth = width;
+    bm->bmih.biHeight = height;
+    bm->bmih.biPlanes = 1;
+
+    bm->bmih.biBitCount = bitsPerPixel;
+    bm->bmih.biCompression = 0;
+    bm->bmih.biSizeImage = 0;
+    // 72 DPI
+    bm->bmih.biXPelsPerMeter = 28346;
+    bm->bmih.biYPelsPerMeter = 28346;
+
+    bm->bmih.biClrImportant = 0;
+}
+
+/**
+ * InitializeImageBitmapWag initializes a constructed bitmap on its own, 
+ * zeroed image bits or on image bits given by the caller
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm bitmap image
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel 
+ * @param bits image bits to use as they are, NULL to allocate them
+ * @param stride bytes from the start of one row of bits to the next
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError InitializeImageBitmapWag(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel,
+    uint8_t * bits, const size_t stride)
+{
+    // Contains the size of the palette array 
+    size_t sizeOfPalette = 0; 
+    BitmapWagError retVal = BITMAPWAG_SUCCESS;
+
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    bm->colorUsed = NULL;
+
+    // Find the amount of memory that needs to be allocated for the image array
+    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+    
+    size_t bytesForImage = rowMemory * height;
+
+    if(bits != NULL)
+    {
+        bm->aBitmapBits = bits;
+        SetRowsBitmapWag(bm, height, stride);
+        bm->state = BITMAPWAG_STATE_INITIALIZED;
+    }
+    else
+    {
+        // Allocate the memory for the image
+        bm->aBitmapBits = (uint8_t *) ReserveBitmapWag(bm, 
+            &(bm->bitsBuffer), &(bm->bitsCapacity), bytesForImage, 
+            BITMAPWAG_BITS_ALIGN);
+
+        if(bm->aBitmapBits == NULL)
+        {
+            return BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED;
+        }
+
+        SetRowsBitmapWag(bm, height, rowMemory);
+
+        // Indicate that the bitmap has been initialized 
+        bm->state = BITMAPWAG_STATE_INITIALIZED;
+
+        // Make the entire color array point to the zeroth color palette 
+        // index or make it colored black 
+        BitmapWagClearJob clearJob = {bm->aBitmapBits, rowMemory};
+        RunRowsBitmapWag(ClearRowsBitmapWag, &clearJob, height, rowMemory);
+    }
+
+    // Allocate memory for the color palette if one is needed 
+    // And allocate memory for the colorsUsed array if one is needed
+    if(bitsPerPixel <= 8)
+    {
+        // Calculate number of colors based on biBitCount
+        size_t numColors = 1 << bitsPerPixel;
+        size_t sizeOfColorUsed = numColors * sizeof(uint8_t);
+        sizeOfPalette = numColors * sizeof(BitmapWagRgbQuad);
+
+        bm->aColors = (BitmapWagRgbQuad *) ReserveBitmapWag(bm, 
+            &(bm->colorsBuffer), &(bm->colorsCapacity), sizeOfPalette, 
+            BITMAPWAG_ALIGN);
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_ALLOCATE_PALETTE_FAILED;
+        }
+
+        bm->bmih.biClrUsed = numColors;
+
+        // Make the entire color palette black
+        for(size_t i = 0; i < numColors; i++)
+        {
+            (bm->aColors)[i] = (BitmapWagRgbQuad){0x00, 0x00, 0x00, 0};
+        }
+
+        // Allocate the space for the colorUsed record
+        bm->colorUsed = (uint8_t *) ReserveBitmapWag(bm, 
+            &(bm->colorUsedBuffer), &(bm->colorUsedCapacity), 
+            sizeOfColorUsed, BITMAPWAG_ALIGN);
+
+        // if colorUsed failed to allocate, it's not an error, and there are 
+        // fallbacks but it will really  slow down the performance of the 
+        // library so the application should be notified 
+        if(bm->colorUsed == NULL)
+        {
+            retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
+        }
+        else
+        {
+            // Initialize all values in colorUsed to be all zeros
+            for(size_t i = 0; i < numColors; i++)
+            {
+                (bm->colorUsed)[i] = 0;
+            }
+        }
+    }
+    else
+    {
+        bm->bmih.biClrUsed = 0;
+        bm->aColors = NULL;
+        bm->colorUsed = NULL;
+    }
+
+    // Now that everything has been allocated, start initializing all the 
+    // member variables
+    SetHeadersBitmapWag(bm, height, width, bitsPerPixel, sizeOfPalette);
+
+    // Start with an empty palette hash table
+    BuildPaletteHashBitmapWag(bm);
+
+    return retVal;
+}
+
+BitmapWagError InitializeBitmapWag(BitmapWagImg * bm, const uint32_t height, 
+    const uint32_t width, const uint16_t bitsPerPixel)
+{
+    return InitializeImageBitmapWag(bm, height, width, bitsPerPixel, NULL, 0);
+}
+
+BitmapWagError InitializeBitmapWagExternal(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel,
+    void * pixels, const size_t stride, 
+    const BitmapWagExternalOptions * options)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    if(pixels == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    const size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+
+    if(stride != 0 && stride < rowMemory)
+    {
+        return BITMAPWAG_BUFFER_TOO_SMALL;
+    }
+
+    bm->topDown = (options != NULL && options->topDown);
+
+    BitmapWagError retVal = InitializeImageBitmapWag(bm, height, width, 
+        bitsPerPixel, (uint8_t *) pixels, stride ? stride : rowMemory);
+
+    if(retVal != BITMAPWAG_SUCCESS 
+        && retVal != BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+    {
+        return retVal;
+    }
+
+    if(options != NULL && options->takeOwnership)
+    {
+        bm->ownsPixels = 1;
+        bm->freePixels = options->freePixels;
+        bm->freeUser = options->user;
+    }
+
+    if(bitsPerPixel <= 8)
+    {
+        if(options != NULL && options->palette != NULL)
+        {
+            const uint16_t possibleColors = GetPossibleColorsBitmapWag(bm);
+
+            for(uint32_t i = 0; i < options->numColors 
+                && i < possibleColors; i++)
+            {
+                (bm->aColors)[i] = (options->palette)[i];
+            }
+        }
+
+        // The pixels already index the palette, find the entries they use
+        if(bm->colorUsed != NULL)
+        {
+            SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
+            BuildPaletteHashBitmapWag(bm);
+        }
+    }
+
+    return retVal;
+}
+
+BitmapWagError InitializeBitmapWagBitfields(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel, 
+    const uint32_t redMask, const uint32_t greenMask, const uint32_t blueMask,
+    const uint32_t alphaMask)
+{
+    const uint32_t masks[4] = {redMask, greenMask, blueMask, alphaMask};
+    BitmapWagBitfields * bitfields;
+
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    BitmapWagError retVal = CreateBitfieldsBitmapWag(masks, bitsPerPixel, 
+        bm, &bitfields);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    retVal = InitializeBitmapWag(bm, height, width, bitsPerPixel);
+
+    // The tables stay in the buffer of bm for FreeBitmapWag to free
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return retVal;
+    }
+
+    bm->bitfields = bitfields;
+    bm->bmih.biCompression = BITMAPWAG_BI_BITFIELDS;
+
+    return retVal;
+}
+
+BitmapWagError InitializeBitmapWagTopDown(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object hasn't already been initialized
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_ALREADY_INIT;
+    }
+
+    BitmapWagError retVal = InitializeBitmapWag(bm, height, width, 
+        bitsPerPixel);
+
+    // Every row is zero, so only the order the rows are found in changes
+    if(bm->aBitmapBits != NULL)
+    {
+        bm->topDown = 1;
+        SetRowsBitmapWag(bm, height, GetRowMemory(width, bitsPerPixel));
+    }
+
+    return retVal;
+}
+
+/**
+ * ReleaseBitsBitmapWag unmaps the file aBitmapBits points into or releases 
+ * the external pixels the image owns. Image bits in bitsBuffer are kept. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ */
+static void ReleaseBitsBitmapWag(BitmapWagImg * bm)
+{
+#ifdef BITMAPWAG_HAS_MMAP
+    if(bm->mapping != NULL)
+    {
+        // aBitmapBits points into the mapping, so it is not freed
+        munmap(bm->mapping, bm->mappingSize);
+        bm->mapping = NULL;
+        bm->aBitmapBits = NULL;
+    }
+#endif
+
+    if(bm->ownsPixels)
+    {
+        if(bm->freePixels != NULL)
+        {
+            bm->freePixels(bm->freeUser, bm->aBitmapBits);
+        }
+        else
+        {
+            free(bm->aBitmapBits);
+        }
+        bm->ownsPixels = 0;
+        bm->aBitmapBits = NULL;
+    }
+}
+
+BitmapWagError FreeBitmapWag(BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+    
+    if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    {
+        ReleaseBitsBitmapWag(bm);
+    }
+    
+    if(bm->state == BITMAPWAG_STATE_INITIALIZED || 
+       bm->state == BITMAPWAG_STATE_CONSTRUCTED)
+    {
+        // A reset image still holds its buffers
+        FreeWithBitmapWag(&(bm->allocator), bm->bitsBuffer);
+        FreeWithBitmapWag(&(bm->allocator), bm->colorsBuffer);
+        FreeWithBitmapWag(&(bm->allocator), bm->colorUsedBuffer);
+        FreeWithBitmapWag(&(bm->allocator), bm->bitfieldsBuffer);
+        bm->aBitmapBits = NULL;
+        bm->aColors = NULL;
+        bm->colorUsed = NULL;
+        bm->bitfields = NULL;
+
+        // The struct holds the allocator, so it's copied out first
+        const BitmapWagAllocator allocator = bm->allocator;
+
+        FreeWithBitmapWag(&allocator, bm);
+        bm = NULL;
+    }
+    else
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+
+    return BITMAPWAG_SUCCESS; 
+}
+
+BitmapWagError ResetBitmapWag(BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(bm->state == BITMAPWAG_STATE_NONE)
+    {
+        return BITMAPWAG_NOSTATE;
+    }
+
+    ReleaseBitsBitmapWag(bm);
+
+    // Everything but the allocator and the buffers goes back to how 
+    // ConstructBitmapWag left it
+    BitmapWagImg reset = {0};
+
+    reset.allocator = bm->allocator;
+    reset.bitsBuffer = bm->bitsBuffer;
+    reset.bitsCapacity = bm->bitsCapacity;
+    reset.colorsBuffer = bm->colorsBuffer;
+    reset.colorsCapacity = bm->colorsCapacity;
+    reset.colorUsedBuffer = bm->colorUsedBuffer;
+    reset.colorUsedCapacity = bm->colorUsedCapacity;
+    reset.bitfieldsBuffer = bm->bitfieldsBuffer;
+    reset.state = BITMAPWAG_STATE_CONSTRUCTED;
+    *bm = reset;
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError ReinitializeBitmapWag(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel)
+{
+    BitmapWagError retVal = ResetBitmapWag(bm);
+
+    if(retVal)
+    {
+        return retVal;
+    }
+
+    return InitializeBitmapWag(bm, height, width, bitsPerPixel);
+}
+
+uint32_t GetBitmapWagHeight(const BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {   
+        return 0;
+    }
+    else
+    {
+        return bm->bmih.biHeight;
+    }
+}
+
+uint32_t GetBitmapWagWidth(const BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {   
+        return 0;
+    }
+    else
+    {
+        return bm->bmih.biWidth;
+    }
+}
+
+uint16_t GetBitmapWagBitsPerPixel(const BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {   
+        return 0;
+    }
+    else
+    {
+        return bm->bmih.biBitCount;
+    }
+}
+
+uint8_t GetBitmapWagTopDown(const BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {   
+        return 0;
+    }
+    else
+    {
+        return bm->topDown;
+    }
+}
+
+// BitmapWagFlipJob is the job SetBitmapWagTopDown runs to reverse the rows
+typedef struct {
+    uint8_t * bits;
+    size_t stride;
+    size_t rowMemory;
+    uint32_t height;
+} BitmapWagFlipJob;
+
+/**
+ * FlipRowsBitmapWag swaps a band of rows from the bottom half of the image 
+ * bits with the rows mirroring them in the top half
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagFlipJob
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS
+ */
+static BitmapWagError FlipRowsBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagFlipJob * job = (const BitmapWagFlipJob *) ctx;
+
+    for(uint32_t j = y0; j < y1; j++)
+    {
+        uint8_t * low = job->bits + (size_t) j*job->stride;
+        uint8_t * high = job->bits + (size_t) (job->height - 1 - j)
+            *job->stride;
+
+        for(size_t i = 0; i < job->rowMemory; i++)
+        {
+            const uint8_t swap = low[i];
+
+            low[i] = high[i];
+            high[i] = swap;
+        }
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError SetBitmapWagTopDown(BitmapWagImg * bm, const uint8_t topDown)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if((topDown != 0) == (bm->topDown != 0))
+    {
+        return BITMAPWAG_SUCCESS;
+    }
+
+    if(bm->readOnly)
+    {
+        return BITMAPWAG_READ_ONLY;
+    }
+
+    const uint32_t height = bm->bmih.biHeight;
+    const size_t stride = GetStrideBitmapWag(bm);
+    const size_t rowMemory = GetRowMemory(bm->bmih.biWidth, 
+        bm->bmih.biBitCount);
+
+    // Reverse the rows in memory so every row keeps its y
+    BitmapWagFlipJob job = {bm->aBitmapBits, stride, rowMemory, height};
+    RunRowsBitmapWag(FlipRowsBitmapWag, &job, height / 2, 2*rowMemory);
+
+    bm->topDown = (topDown != 0);
+    SetRowsBitmapWag(bm, height, stride);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError GetBitmapWagView(BitmapWagImg * bm, BitmapWagView * view)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(view == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    const uint32_t height = bm->bmih.biHeight;
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+
+    view->bits = bm->aBitmapBits;
+    // The first row stored is the top row of a top-down image
+    if(bm->topDown && height > 0)
+    {
+        view->bits = RowBitmapWag(bm, height - 1);
+    }
+    view->stride = GetStrideBitmapWag(bm);
+    view->width = bm->bmih.biWidth;
+    view->height = height;
+    view->bitsPerPixel = bitsPerPixel;
+    view->topDown = bm->topDown;
+    view->readOnly = bm->readOnly;
+    view->palette = NULL;
+    view->numColors = 0;
+
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        view->masks[i] = 0;
+    }
+
+    if(bitsPerPixel <= 8)
+    {
+        view->palette = bm->aColors;
+        view->numColors = GetPossibleColorsBitmapWag(bm);
+    }
+    else if(bm->bitfields != NULL)
+    {
+        for(uint32_t i = 0; i < 4; i++)
+        {
+            view->masks[i] = bm->bitfields->masks[i];
+        }
+    }
+    // The fixed layouts SetBitmapWagPixel writes
+    else if(bitsPerPixel == 16)
+    {
+        view->masks[0] = 0x001F;
+        view->masks[1] = 0x03E0;
+        view->masks[2] = 0x7C00;
+    }
+    else
+    {
+        view->masks[0] = 0x00FF0000;
+        view->masks[1] = 0x0000FF00;
+        view->masks[2] = 0x000000FF;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError GetBitmapWagRowPointers(BitmapWagImg * bm, uint8_t ** rows, 
+    const uint32_t numRows)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(rows == NULL)
+    {
+        return BITMAPWAG_BUFFER_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(numRows < bm->bmih.biHeight)
+    {
+        return BITMAPWAG_BUFFER_TOO_SMALL;
+    }
+
+    for(uint32_t y = 0; y < bm->bmih.biHeight; y++)
+    {
+        rows[y] = RowBitmapWag(bm, y);
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError SyncBitmapWagView(BitmapWagImg * bm)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Without the colorUsed array every lookup scans the image anyway
+    if(bm->bmih.biBitCount > 8 || bm->colorUsed == NULL)
+    {
+        return BITMAPWAG_SUCCESS;
+    }
+
+    const uint16_t possibleColors = GetPossibleColorsBitmapWag(bm);
+
+    for(uint16_t i = 0; i < possibleColors; i++)
+    {
+        (bm->colorUsed)[i] = 0;
+    }
+
+    BitmapWagError retVal = SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
+
+    BuildPaletteHashBitmapWag(bm);
+
+    return retVal;
+}
+
+BitmapWagError SetBitmapWagPixel(BitmapWagImg * bm, const uint32_t x, 
+    const uint32_t y, const uint8_t r, const uint8_t g, const uint8_t b)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(bm->readOnly)
+    {
+        return BITMAPWAG_READ_ONLY;
+    }
+
+    const size_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    const uint32_t height = bm->bmih.biHeight;
+
+    if(x >= width)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(y >= height)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    BITMAPWAG_COUNT(pixelsSet, 1);
+
+    // Row y of the image, wherever it is stored
+    uint8_t * row = RowBitmapWag(bm, y);
+
+    // If a color palette is being used 
+    if(bm->bmih.biBitCount <= 8)
+    {
+        BitmapWagRgbQuad color = {b, g, r, 0};
+        uint8_t indexOfColor; 
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        // Get the value at the byte
+        uint8_t value = row[x >> (4 - ceilLog2b16_t(bitsPerPixel))];
+
+        // Find the index of the color specified in the input, adding it to 
+        // the palette if it is not there yet
+        BitmapWagError error = FindPaletteIndexBitmapWag(bm, color, 
+            &indexOfColor);
+
+        if(error)
+        {
+            return error;
+        }
+
+        // Amount to shift palette index by
+        uint8_t sftAmnt = (bitsPerPixel * 
+            ((~x) & (~(0xFFFFFFFF << (4 - ceilLog2b16_t(bitsPerPixel))))));
+
+        // Mask holds the right shifted bit mask
+        uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+        // First iteration sets the index of color to the correct bit width
+        uint8_t value2 = (indexOfColor & (0xFF >> (8 - bitsPerPixel)));
+        // Second iteration shifts palette index to the correct byte position
+        value2 = value2 << sftAmnt;
+        // Third iteration masks out value for value2 to be inserted in 
+        value = value & (~(mask << sftAmnt));
+        // Fourth iteration combines the values
+        value = value | value2;
+
+        row
+            [(x >> (4 - ceilLog2b16_t(bitsPerPixel)))] = value;
+    }
+
+    // Images with channel masks, pixels are set fully opaque
+    else if(bm->bitfields != NULL)
+    {
+        const BitmapWagRgbQuad color = {b, g, r, 0};
+        const uint32_t bytesPerPixel = bitsPerPixel >> 3;
+
+        StorePixelBitmapWag(&row[bytesPerPixel*x],
+            bytesPerPixel, EncodeBitfieldsBitmapWag(bm->bitfields, color));
+    }
+
+    // biBitCount will either be 16 or 24 when a color palette is not being used
+    else if (bm->bmih.biBitCount == 16)
+    {
+        // Byte access, rows of external and mapped images need not be aligned
+        StorePixelBitmapWag(&row[2*x], 2, ((0x1F & b) << 10) 
+            | ((0x1F & g) << 5) | ((0x1F & r) << 0));
+    }
+
+    else if(bm->bmih.biBitCount == 24)
+    {
+        row[3*x] = b;
+        row[3*x + 1] = g;
+        row[3*x + 2] = r;
+    }
+
+    else if(bm->bmih.biBitCount == 32)
+    {
+        row[4*x] = b;
+        row[4*x + 1] = g;
+        row[4*x + 2] = r;
+        row[4*x + 3] = 0;
+    }
+
+    else
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+        
+
+    return BITMAPWAG_SUCCESS;
+}
+
+
+BitmapWagError GetBitmapWagPixel(const BitmapWagImg * bm, 
+    const uint32_t x, const uint32_t y, BitmapWagRgbQuad * color)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(color == NULL)
+    {
+        return BITMAPWAG_COLOR_PALETTE_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    const size_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    const uint32_t height = bm->bmih.biHeight;
+
+    if(x >= width)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(y >= height)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    BITMAPWAG_COUNT(pixelsGot, 1);
+
+    // Row y of the image, wherever it is stored
+    const uint8_t * row = RowBitmapWag(bm, y);
+
+    // If a color palette is being used 
+    if(bm->bmih.biBitCount <= 8)
+    {
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        // Get the value at the byte
+        uint8_t value = row[x >> (4 - ceilLog2b16_t(bitsPerPixel))];
+
+        // Amount to shift palette index by
+        uint8_t sftAmnt = (bitsPerPixel * 
+            ((~x) & (~(0xFFFFFFFF << (4 - ceilLog2b16_t(bitsPerPixel))))));
+
+        // Mask holds the right shifted bit masks
+        uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+        // Snipe out the bit(s) of the pixel that are used to look up a color 
+        // in the palette 
+        value = (value >> sftAmnt) & mask;
+
+        color->rgbBlue = (bm->aColors)[value].rgbBlue;
+        color->rgbGreen = (bm->aColors)[value].rgbGreen;
+        color->rgbRed = (bm->aColors)[value].rgbRed;
+        color->rgbReserved = (bm->aColors)[value].rgbReserved;
+    }
+
+    // Images with channel masks
+    else if(bm->bitfields != NULL)
+    {
+        const uint32_t bytesPerPixel = bitsPerPixel >> 3;
+
+        *color = DecodeBitfieldsBitmapWag(bm->bitfields, LoadPixelBitmapWag(
+            &row[bytesPerPixel*x], bytesPerPixel));
+    }
+
+    // biBitCount will either be 16 or 24 when a color palette is not being used
+    else if (bm->bmih.biBitCount == 16)
+    {
+        // Byte access, rows of external and mapped images need not be aligned
+        const uint32_t pixel = LoadPixelBitmapWag(&row[2*x], 2);
+
+        color->rgbBlue = (pixel >> 10) & 0x001F;
+        color->rgbGreen = (pixel >> 5) & 0x001F;
+        color->rgbRed = (pixel >> 0) & 0x001F;
+        color->rgbReserved = 0;
+    }
+
+    else if(bm->bmih.biBitCount == 24)
+    {
+        color->rgbBlue = row[3*x];
+        color->rgbGreen = row[3*x + 1];
+        color->rgbRed = row[3*x + 2];
+        color->rgbReserved = 0;
+    }
+    else if(bm->bmih.biBitCount == 32)
+    {
+        color->rgbBlue = row[4*x];
+        color->rgbGreen = row[4*x + 1];
+        color->rgbRed = row[4*x + 2];
+        color->rgbReserved = row[4*x + 3];
+    }
+    else
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+    
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * EncodeSpanBitmapWag writes a run of colors into one row of the image bits. 
+ * The geometry of the row is computed once for the whole run. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param row pointer to the first byte of the row in aBitmapBits
+ * @param x0 horizontal coordinate of the first pixel (from left)
+ * @param colors array of count colors to write
+ * @param count number of pixels to write
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError EncodeSpanBitmapWag(BitmapWagImg * bm, uint8_t * row, 
+    const uint32_t x0, const BitmapWagRgbQuad * colors, const uint32_t count)
+{
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+
+    // If a color palette is being used 
+    if(bitsPerPixel <= 8)
+    {
+        // Number of bits to shift x by to find the byte holding the pixel
+        const uint16_t pixelShift = 4 - ceilLog2b16_t(bitsPerPixel);
+        // Mask of the pixel position within a byte
+        const uint32_t pixelMask = ~(0xFFFFFFFF << pixelShift);
+        // Mask holds the right shifted bit mask
+        const uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const BitmapWagRgbQuad color = {colors[i].rgbBlue, 
+                colors[i].rgbGreen, colors[i].rgbRed, 0};
+            uint8_t indexOfColor;
+
+            BitmapWagError error = FindPaletteIndexBitmapWag(bm, color, 
+                &indexOfColor);
+            if(error)
+            {
+                return error;
+            }
+
+            const uint32_t x = x0 + i;
+
+            if(bitsPerPixel == 8)
+            {
+                row[x] = indexOfColor;
+            }
+            else
+            {
+                // Amount to shift palette index by
+                const uint8_t sftAmnt = bitsPerPixel * ((~x) & pixelMask);
+                uint8_t * byte = &row[x >> pixelShift];
+
+                *byte = (*byte & (~(mask << sftAmnt))) 
+                    | ((indexOfColor & mask) << sftAmnt);
+            }
+        }
+    }
+
+    else if(bm->bitfields != NULL)
+    {
+        const uint32_t bytesPerPixel = bitsPerPixel >> 3;
+        uint8_t * pixel = row + bytesPerPixel*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            StorePixelBitmapWag(pixel, bytesPerPixel, 
+                EncodeBitfieldsBitmapWag(bm->bitfields, colors[i]));
+            pixel += bytesPerPixel;
+        }
+    }
+
+    else if(bitsPerPixel == 16)
+    {
+        uint8_t * pixel = row + 2*x0;
+
+        // Byte access, rows of external and mapped images need not be aligned
+        for(uint32_t i = 0; i < count; i++)
+        {
+            StorePixelBitmapWag(pixel, 2, ((0x1F & colors[i].rgbBlue) << 10) 
+                | ((0x1F & colors[i].rgbGreen) << 5) 
+                | ((0x1F & colors[i].rgbRed) << 0));
+            pixel += 2;
+        }
+    }
+
+    else if(bitsPerPixel == 24)
+    {
+        uint8_t * pixel = row + 3*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            pixel[0] = colors[i].rgbBlue;
+            pixel[1] = colors[i].rgbGreen;
+            pixel[2] = colors[i].rgbRed;
+            pixel += 3;
+        }
+    }
+
+    else if(bitsPerPixel == 32)
+    {
+        uint8_t * pixel = row + 4*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            pixel[0] = colors[i].rgbBlue;
+            pixel[1] = colors[i].rgbGreen;
+            pixel[2] = colors[i].rgbRed;
+            pixel[3] = 0;
+            pixel += 4;
+        }
+    }
+
+    else
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * DecodeSpanBitmapWag reads a run of colors out of one row of the image bits. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param row pointer to the first byte of the row in aBitmapBits
+ * @param x0 horizontal coordinate of the first pixel (from left)
+ * @param colors array of count colors to populate
+ * @param count number of pixels to read
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError DecodeSpanBitmapWag(const BitmapWagImg * bm, 
+    const uint8_t * row, const uint32_t x0, BitmapWagRgbQuad * colors, 
+    const uint32_t count)
+{
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+
+    // If a color palette is being used 
+    if(bitsPerPixel <= 8)
+    {
+        const uint16_t pixelShift = 4 - ceilLog2b16_t(bitsPerPixel);
+        const uint32_t pixelMask = ~(0xFFFFFFFF << pixelShift);
+        const uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t x = x0 + i;
+            const uint8_t sftAmnt = bitsPerPixel * ((~x) & pixelMask);
+
+            colors[i] = (bm->aColors)[(row[x >> pixelShift] >> sftAmnt) & mask];
+        }
+    }
+
+    else if(bm->bitfields != NULL)
+    {
+        const uint32_t bytesPerPixel = bitsPerPixel >> 3;
+        const uint8_t * pixel = row + bytesPerPixel*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            colors[i] = DecodeBitfieldsBitmapWag(bm->bitfields, 
+                LoadPixelBitmapWag(pixel, bytesPerPixel));
+            pixel += bytesPerPixel;
+        }
+    }
+
+    else if(bitsPerPixel == 16)
+    {
+        const uint8_t * pixel = row + 2*x0;
+
+        // Byte access, rows of external and mapped images need not be aligned
+        for(uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t value = LoadPixelBitmapWag(pixel, 2);
+
+            colors[i].rgbBlue = (value >> 10) & 0x001F;
+            colors[i].rgbGreen = (value >> 5) & 0x001F;
+            colors[i].rgbRed = (value >> 0) & 0x001F;
+            colors[i].rgbReserved = 0;
+            pixel += 2;
+        }
+    }
+
+    else if(bitsPerPixel == 24)
+    {
+        const uint8_t * pixel = row + 3*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            colors[i].rgbBlue = pixel[0];
+            colors[i].rgbGreen = pixel[1];
+            colors[i].rgbRed = pixel[2];
+            colors[i].rgbReserved = 0;
+            pixel += 3;
+        }
+    }
+
+    else if(bitsPerPixel == 32)
+    {
+        const uint8_t * pixel = row + 4*x0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            colors[i].rgbBlue = pixel[0];
+            colors[i].rgbGreen = pixel[1];
+            colors[i].rgbRed = pixel[2];
+            colors[i].rgbReserved = pixel[3];
+            pixel += 4;
+        }
+    }
+
+    else
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * CheckSpanBitmapWag validates the arguments common to the span functions
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param bm pointer to a bitmap struct
+ * @param x0 horizontal coordinate of the first pixel (from left)
+ * @param y vertical coordinate of the row (from bottom)
+ * @param colors color array passed to the span function
+ * @param count number of pixels in the span
+ * @return BITMAPWAG_SUCCESS if the span lies within the image
+ */
+static BitmapWagError CheckSpanBitmapWag(const BitmapWagImg * bm, 
+    const uint32_t x0, const uint32_t y, const BitmapWagRgbQuad * colors, 
+    const uint32_t count)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(colors == NULL)
+    {
+        return BITMAPWAG_COLOR_PTR_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(x0 > bm->bmih.biWidth || count > bm->bmih.biWidth - x0)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(y >= bm->bmih.biHeight)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError SetBitmapWagSpan(BitmapWagImg * bm, const uint32_t x0, 
+    const uint32_t y, const BitmapWagRgbQuad * colors, const uint32_t count)
+{
+    BitmapWagError error = CheckSpanBitmapWag(bm, x0, y, colors, count);
+
+    if(error)
+    {
+        return error;
+    }
+
+    if(bm->readOnly)
+    {
+        return BITMAPWAG_READ_ONLY;
+    }
+
+    BITMAPWAG_COUNT(pixelsSet, count);
+
+    return EncodeSpanBitmapWag(bm, RowBitmapWag(bm, y), x0, colors, count);
+}
+
+BitmapWagError SetBitmapWagRow(BitmapWagImg * bm, const uint32_t y, 
+    const BitmapWagRgbQuad * colors)
+{
+    return SetBitmapWagSpan(bm, 0, y, colors, GetBitmapWagWidth(bm));
+}
+
+BitmapWagError GetBitmapWagSpan(const BitmapWagImg * bm, const uint32_t x0, 
+    const uint32_t y, BitmapWagRgbQuad * colors, const uint32_t count)
+{
+    BitmapWagError error = CheckSpanBitmapWag(bm, x0, y, colors, count);
+
+    if(error)
+    {
+        return error;
+    }
+
+    BITMAPWAG_COUNT(pixelsGot, count);
+
+    return DecodeSpanBitmapWag(bm, RowBitmapWag(bm, y), x0, colors, count);
+}
+
+// BitmapWagFillJob is the job FillBitmapWagRect runs on bands of rows
+typedef struct {
+    // first byte of the bottom row of the rectangle and the bytes from one 
+    // row to the row above it
+    uint8_t * firstRow;
+    ptrdiff_t rowStride;
+    // Palette images: bytes of the row the rectangle covers, the masks of 
+    // the pixels in the first and last byte and the repeated palette index
+    size_t firstByte;
+    size_t lastByte;
+    uint8_t firstMask;
+    uint8_t lastMask;
+    uint8_t pattern;
+    // Other images: the filled bottom row of the rectangle and its length
+    const uint8_t * span;
+    size_t spanBytes;
+} BitmapWagFillJob;
+
+/**
+ * FillPaletteRowsBitmapWag fills a band of rows of a palette image 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagFillJob
+ * @param y0 first row of the band, relative to the bottom of the rectangle
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS
+ */
+static BitmapWagError FillPaletteRowsBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagFillJob * job = (const BitmapWagFillJob *) ctx;
+    const size_t firstByte = job->firstByte;
+    const size_t lastByte = job->lastByte;
+
+    for(uint32_t j = y0; j < y1; j++)
+    {
+        uint8_t * row = job->firstRow + (ptrdiff_t) j*job->rowStride;
+
+        row[firstByte] = (row[firstByte] & ~job->firstMask) 
+            | (job->pattern & job->firstMask);
+
+        if(lastByte > firstByte)
+        {
+            memset(&row[firstByte + 1], job->pattern, 
+                lastByte - firstByte - 1);
+            row[lastByte] = (row[lastByte] & ~job->lastMask) 
+                | (job->pattern & job->lastMask);
+        }
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * FillCopyRowsBitmapWag copies the filled bottom row of the rectangle to a 
+ * band of the rows above it
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagFillJob
+ * @param y0 first row of the band, counted from the row above the bottom row
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS
+ */
+static BitmapWagError FillCopyRowsBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagFillJob * job = (const BitmapWagFillJob *) ctx;
+
+    for(uint32_t j = y0; j < y1; j++)
+    {
+        memcpy((uint8_t *) job->span + (ptrdiff_t) (j + 1)*job->rowStride, 
+            job->span, job->spanBytes);
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError FillBitmapWagRect(BitmapWagImg * bm, const uint32_t x, 
+    const uint32_t y, const uint32_t w, const uint32_t h, 
+    const BitmapWagRgbQuad color)
+{
+    // Null check on bitmap pointer
+    if(bm == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the object has already been initialized
+    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    // Check to on the bitmap bits pointer
+    if(bm->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(bm->readOnly)
+    {
+        return BITMAPWAG_READ_ONLY;
+    }
+
+    const uint16_t bitsPerPixel = bm->bmih.biBitCount;
+    const uint32_t width = bm->bmih.biWidth;
+    const uint32_t height = bm->bmih.biHeight;
+
+    if(x > width || w > width - x)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(y > height || h > height - y)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    if(w == 0 || h == 0)
+    {
+        return BITMAPWAG_SUCCESS;
+    }
+
+    uint8_t * firstRow = RowBitmapWag(bm, y);
+
+    // If a color palette is being used, the palette index is looked up once 
+    // and repeated across whole bytes
+    if(bitsPerPixel <= 8)
+    {
+        const BitmapWagRgbQuad paletteColor = {color.rgbBlue, color.rgbGreen,
+            color.rgbRed, 0};
+        uint8_t indexOfColor;
+
+        if(bm->aColors == NULL)
+        {
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        BitmapWagError error = FindPaletteIndexBitmapWag(bm, paletteColor, 
+            &indexOfColor);
+
+        if(error)
+        {
+            return error;
+        }
+
+        // Number of bits to shift x by to find the byte holding the pixel
+        const uint16_t pixelShift = 4 - ceilLog2b16_t(bitsPerPixel);
+        // Number of pixels in a byte
+        const uint32_t pixelsPerByte = 1 << pixelShift;
+        // Mask holds the right shifted bit mask
+        const uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+
+        // Byte with every pixel set to the palette index
+        uint8_t pattern = 0;
+        for(uint32_t i = 0; i < pixelsPerByte; i++)
+        {
+            pattern |= (indexOfColor & mask) << (i * bitsPerPixel);
+        }
+
+        const size_t firstByte = x >> pixelShift;
+        const size_t lastByte = (x + w - 1) >> pixelShift;
+
+        // Masks of the pixels to set in the partly covered bytes at each end 
+        // of the row, the first pixel of a byte is in its high bits
+        uint8_t firstMask = 0;
+        uint8_t lastMask = 0;
+        for(uint32_t i = 0; i < pixelsPerByte; i++)
+        {
+            const uint8_t pixelBits = mask << 
+                (bitsPerPixel * (pixelsPerByte - 1 - i));
+
+            if(i >= (x & (pixelsPerByte - 1)))
+            {
+                firstMask |= pixelBits;
+            }
+            if(i <= ((x + w - 1) & (pixelsPerByte - 1)))
+            {
+                lastMask |= pixelBits;
+            }
+        }
+
+        if(firstByte == lastByte)
+        {
+            firstMask &= lastMask;
+        }
+
+        BitmapWagFillJob job = {firstRow, bm->rowStride, firstByte, lastByte, 
+            firstMask, lastMask, pattern, NULL, 0};
+
+        return RunRowsBitmapWag(FillPaletteRowsBitmapWag, &job, h, 
+            lastByte - firstByte + 1);
+    }
+
+    // Set the first row of the rectangle, then copy it to the other rows
+    const size_t bytesPerPixel = bitsPerPixel >> 3;
+    const size_t spanBytes = w * bytesPerPixel;
+    uint8_t * span = firstRow + x*bytesPerPixel;
+
+    BitmapWagError error = EncodeSpanBitmapWag(bm, span, 0, &color, 1);
+
+    if(error)
+    {
+        return error;
+    }
+
+    // Double the number of pixels set with each copy
+    size_t bytesSet = bytesPerPixel;
+    while(bytesSet < spanBytes)
+    {
+        size_t bytesToCopy = (bytesSet < spanBytes - bytesSet) ? 
+            bytesSet : spanBytes - bytesSet;
+
+        memcpy(span + bytesSet, span, bytesToCopy);
+        bytesSet += bytesToCopy;
+    }
+
+    BitmapWagFillJob job = {firstRow, bm->rowStride, 0, 0, 0, 0, 0, span, 
+        spanBytes};
+
+    return RunRowsBitmapWag(FillCopyRowsBitmapWag, &job, h - 1, spanBytes);
+}
+
+/**
+ * CopyBitsBitmapWag copies a run of bits between two rows of packed pixels. 
+ * Bits are counted from the most significant bit of the first byte, the 
+ * order sub-byte pixels are stored in. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param dst row to copy the bits to
+ * @param dstBit offset of the first bit to write in dst
+ * @param src row to copy the bits from, shall not overlap dst
+ * @param srcBit offset of the first bit to read in src
+ * @param numBits number of bits to copy, greater than zero
+ */
+static void CopyBitsBitmapWag(uint8_t * dst, const size_t dstBit, 
+    const uint8_t * src, const size_t srcBit, const size_t numBits)
+{
+    const size_t endBit = dstBit + numBits;
+    const size_t firstByte = dstBit >> 3;
+    const size_t lastByte = (endBit - 1) >> 3;
+    size_t k = firstByte;
+
+    while(k <= lastByte)
+    {
+        const size_t startBit = (k == firstByte) ? dstBit : (k << 3);
+        const size_t stopBit = (k == lastByte) ? endBit : ((k + 1) << 3);
+
+        // Whole bytes lined up the same way in both rows are copied as is
+        if(startBit == (k << 3) && stopBit == ((k + 1) << 3) 
+            && ((srcBit ^ dstBit) & 7) == 0)
+        {
+            const size_t numBytes = ((endBit >> 3) > k) ? (endBit >> 3) - k 
+                : 1;
+            const size_t srcByte = (srcBit + (startBit - dstBit)) >> 3;
+
+            memcpy(&dst[k], &src[srcByte], numBytes);
+            k += numBytes;
+            continue;
+        }
+
+        // Read the source bits that land in this byte into the high bits of 
+        // value, then move them to their position in the byte
+        const size_t position = srcBit + (startBit - dstBit);
+        const size_t count = stopBit - startBit;
+        uint16_t window = src[position >> 3] << 8;
+
+        if((position & 7) + count > 8)
+        {
+            window |= src[(position >> 3) + 1];
+        }
+
+        const uint8_t value = (uint8_t) (((window << (position & 7)) >> 8) 
+            >> (startBit & 7));
+        const uint8_t mask = (uint8_t) ((0xFF >> (startBit & 7)) 
+            & (0xFF << (((k + 1) << 3) - stopBit)));
+
+        dst[k] = (dst[k] & ~mask) | (value & mask);
+        k++;
+    }
+}
+
+BitmapWagError BlitBitmapWag(BitmapWagImg * dst, const uint32_t dx, 
+    const uint32_t dy, const BitmapWagImg * src, const uint32_t sx, 
+    const uint32_t sy, const uint32_t w, const uint32_t h)
+{
+    // Null check on bitmap pointers
+    if(dst == NULL || src == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that both objects have already been initialized
+    if(dst->state != BITMAPWAG_STATE_INITIALIZED 
+        || src->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    if(dst->aBitmapBits == NULL || src->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(dst->readOnly)
+    {
+        return BITMAPWAG_READ_ONLY;
+    }
+
+    const uint16_t srcBits = src->bmih.biBitCount;
+    const uint16_t dstBits = dst->bmih.biBitCount;
+
+    if((srcBits <= 8 && src->aColors == NULL) 
+        || (dstBits <= 8 && dst->aColors == NULL))
+    {
+        return BITMAPWAG_COLOR_PALETTE_NULL;
+    }
+
+    if(sx > src->bmih.biWidth || w > src->bmih.biWidth - sx 
+        || dx > dst->bmih.biWidth || w > dst->bmih.biWidth - dx)
+    {
+        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+    }
+
+    if(sy > src->bmih.biHeight || h > src->bmih.biHeight - sy 
+        || dy > dst->bmih.biHeight || h > dst->bmih.biHeight - dy)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
+
+    if(w == 0 || h == 0)
+    {
+        return BITMAPWAG_SUCCESS;
+    }
+
+    const size_t srcRowMemory = GetRowMemory(src->bmih.biWidth, srcBits);
+
+    // Maps the palette indices of src to the palette indices of dst
+    uint8_t indexMap[256];
+    int sameIndices = (src == dst);
+
+    if(srcBits <= 8 && dstBits <= 8 && src != dst)
+    {
+        const uint16_t srcPixelShift = 4 - ceilLog2b16_t(srcBits);
+        const uint32_t srcPixelMask = ~(0xFFFFFFFF << srcPixelShift);
+        const uint8_t srcMask = (0xFF >> (8 - srcBits));
+        uint8_t used[256] = {0};
+
+        // Only the colors inside the rectangle are added to the palette of 
+        // dst, so a small palette isn't filled with unused colors
+        for(uint32_t j = 0; j < h; j++)
+        {
+            const uint8_t * srcRow = RowBitmapWag(src, sy + j);
+
+            for(uint32_t i = sx; i < sx + w; i++)
+            {
+                const uint8_t sftAmnt = srcBits * ((~i) & srcPixelMask);
+
+                used[(srcRow[i >> srcPixelShift] >> sftAmnt) & srcMask] = 1;
+            }
+        }
+
+        sameIndices = (srcBits == dstBits);
+
+        for(uint16_t i = 0; i <= srcMask; i++)
+        {
+            if(used[i])
+            {
+                const BitmapWagRgbQuad color = {(src->aColors)[i].rgbBlue,
+                    (src->aColors)[i].rgbGreen, (src->aColors)[i].rgbRed, 0};
+
+                BitmapWagError error = FindPaletteIndexBitmapWag(dst, color, 
+                    &indexMap[i]);
+
+                if(error)
+                {
+                    return error;
+                }
+
+                sameIndices = sameIndices && (indexMap[i] == i);
+            }
+        }
+    }
+
+    // When a bitmap is blit onto itself the rows are copied in the order that 
+    // reads every source row before it is overwritten
+    const int bottomUp = (src != dst || dy <= sy);
+
+    // Pixels of images with channel masks are only copied as they are 
+    // between images with the same masks
+    const uint8_t sameLayout = (src->bitfields == NULL) 
+        ? (dst->bitfields == NULL) 
+        : (dst->bitfields != NULL && memcmp(src->bitfields->masks, 
+            dst->bitfields->masks, sizeof(src->bitfields->masks)) == 0);
+
+    // Same format, every row is copied with memmove or a bit shifted copy
+    if(srcBits == dstBits && sameLayout && (srcBits > 8 || sameIndices))
+    {
+        uint8_t * scratch = NULL;
+
+        // Sub-byte rows of the same bitmap are staged so the copy can't 
+        // overwrite bits it still has to read
+        if(srcBits < 8 && src == dst)
+        {
+            scratch = (uint8_t *) AllocBitmapWag(srcRowMemory);
+
+            if(scratch == NULL)
+            {
+                return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+            }
+        }
+
+        for(uint32_t n = 0; n < h; n++)
+        {
+            const uint32_t j = bottomUp ? n : h - 1 - n;
+            const uint8_t * srcRow = RowBitmapWag(src, sy + j);
+            uint8_t * dstRow = RowBitmapWag(dst, dy + j);
+
+            if(srcBits >= 8)
+            {
+                memmove(dstRow + dx*(dstBits >> 3), srcRow + sx*(srcBits >> 3), 
+                    w*(srcBits >> 3));
+            }
+            else
+            {
+                if(scratch != NULL)
+                {
+                    memcpy(scratch, srcRow, srcRowMemory);
+                    srcRow = scratch;
+                }
+
+                CopyBitsBitmapWag(dstRow, (size_t) dx*dstBits, srcRow, 
+                    (size_t) sx*srcBits, (size_t) w*srcBits);
+            }
+        }
+
+        free(scratch);
+
+        return BITMAPWAG_SUCCESS;
+    }
+
+    // Palette to palette, every index goes through the index map
+    if(srcBits <= 8 && dstBits <= 8)
+    {
+        const uint16_t srcPixelShift = 4 - ceilLog2b16_t(srcBits);
+        const uint32_t srcPixelMask = ~(0xFFFFFFFF << srcPixelShift);
+        const uint8_t srcMask = (0xFF >> (8 - srcBits));
+        const uint16_t dstPixelShift = 4 - ceilLog2b16_t(dstBits);
+        const uint32_t dstPixelMask = ~(0xFFFFFFFF << dstPixelShift);
+        const uint8_t dstMask = (0xFF >> (8 - dstBits));
+
+        for(uint32_t j = 0; j < h; j++)
+        {
+            const uint8_t * srcRow = RowBitmapWag(src, sy + j);
+            uint8_t * dstRow = RowBitmapWag(dst, dy + j);
+
+            for(uint32_t i = 0; i < w; i++)
+            {
+                const uint32_t srcX = sx + i;
+                const uint32_t dstX = dx + i;
+                const uint8_t srcSft = srcBits * ((~srcX) & srcPixelMask);
+                const uint8_t dstSft = dstBits * ((~dstX) & dstPixelMask);
+                const uint8_t index = 
+                    indexMap[(srcRow[srcX >> srcPixelShift] >> srcSft) 
+                    & srcMask];
+                uint8_t * byte = &dstRow[dstX >> dstPixelShift];
+
+                *byte = (*byte & (~(dstMask << dstSft))) 
+                    | ((index & dstMask) << dstSft);
+            }
+        }
+
+        return BITMAPWAG_SUCCESS;
+    }
+
+    // Different formats go through a row of BitmapWagRgbQuad
+    BitmapWagRgbQuad * scratch = (BitmapWagRgbQuad *) 
+        AllocBitmapWag(w * sizeof(BitmapWagRgbQuad));
+
+    if(scratch == NULL)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    BitmapWagError error = BITMAPWAG_SUCCESS;
+
+    for(uint32_t j = 0; j < h && error == BITMAPWAG_SUCCESS; j++)
+    {
+        error = DecodeSpanBitmapWag(src, RowBitmapWag(src, sy + j), sx, 
+            scratch, w);
+
+        if(error == BITMAPWAG_SUCCESS)
+        {
+            error = EncodeSpanBitmapWag(dst, RowBitmapWag(dst, dy + j), dx, 
+                scratch, w);
+        }
+    }
+
+    free(scratch);
+
+    return error;
+}
+
+/**
+ * ExpandPaletteRowBitmapWag converts a row of palette indices to 24 or 32 
+ * bits per pixel using a table of the palette colors
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param srcRow row of palette indices, not overlapping dstRow
+ * @param srcBitsPerPixel bits per pixel of srcRow, 1, 2, 4 or 8
+ * @param dstRow row to write the colors to
+ * @param dstBytesPerPixel 3 or 4
+ * @param lut palette colors as blue, green, red, zero bytes
+ * @param width number of pixels in the row
+ */
+static void ExpandPaletteRowBitmapWag(const uint8_t * restrict srcRow, 
+    const uint16_t srcBitsPerPixel, uint8_t * restrict dstRow, 
+    const uint32_t dstBytesPerPixel, const uint8_t lut[256][4], 
+    const uint32_t width)
+{
+    const uint16_t pixelShift = 4 - ceilLog2b16_t(srcBitsPerPixel);
+    const uint32_t pixelMask = ~(0xFFFFFFFF << pixelShift);
+    const uint8_t mask = (0xFF >> (8 - srcBitsPerPixel));
+
+    if(dstBytesPerPixel == 4)
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const uint8_t sftAmnt = srcBitsPerPixel * ((~x) & pixelMask);
+            const uint8_t * color = 
+                lut[(srcRow[x >> pixelShift] >> sftAmnt) & mask];
+
+            dstRow[4*x] = color[0];
+            dstRow[4*x + 1] = color[1];
+            dstRow[4*x + 2] = color[2];
+            dstRow[4*x + 3] = 0;
+        }
+    }
+    else
+    {
+        for(uint32_t x = 0; x < width; x++)
+        {
+            const uint8_t sftAmnt = srcBitsPerPixel * ((~x) & pixelMask);
+            const uint8_t * color = 
+                lut[(srcRow[x >> pixelShift] >> sftAmnt) & mask];
+
+            dstRow[3*x] = color[0];
+            dstRow[3*x + 1] = color[1];
+            dstRow[3*x + 2] = color[2];
+        }
+    }
+}
+
+/**
+ * Convert24To32RowBitmapWag copies a row of 24 bit pixels to 32 bits per 
+ * pixel, with a zero fourth byte
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert24To32RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    size_t x = 0;
+
+    // Every pixel but the last can be loaded as 4 bytes, the fourth being 
+    // the first byte of the next pixel
+    for(; x + 1 < width; x++)
+    {
+        uint32_t value;
+
+        memcpy(&value, src + 3*x, sizeof(value));
+        value &= 0x00FFFFFF;
+        memcpy(dst + 4*x, &value, sizeof(value));
+    }
+
+    for(; x < width; x++)
+    {
+        dst[4*x] = src[3*x];
+        dst[4*x + 1] = src[3*x + 1];
+        dst[4*x + 2] = src[3*x + 2];
+        dst[4*x + 3] = 0;
+    }
+}
+
+/**
+ * Convert32To24RowBitmapWag copies a row of 32 bit pixels to 24 bits per 
+ * pixel, dropping the fourth byte
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert32To24RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    for(size_t x = 0; x < width; x++)
+    {
+        dst[3*x] = src[4*x];
+        dst[3*x + 1] = src[4*x + 1];
+        dst[3*x + 2] = src[4*x + 2];
+    }
+}
+
+/**
+ * Convert16To24RowBitmapWag expands a row of 16 bit pixels to 24 bits per 
+ * pixel
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert16To24RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    for(size_t x = 0; x < width; x++)
+    {
+        uint16_t value;
+
+        memcpy(&value, src + 2*x, sizeof(value));
+        dst[3*x] = (value >> 10) & 0x001F;
+        dst[3*x + 1] = (value >> 5) & 0x001F;
+        dst[3*x + 2] = (value >> 0) & 0x001F;
+    }
+}
+
+/**
+ * Convert16To32RowBitmapWag expands a row of 16 bit pixels to 32 bits per 
+ * pixel, with a zero fourth byte
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert16To32RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    for(size_t x = 0; x < width; x++)
+    {
+        uint16_t value;
+
+        memcpy(&value, src + 2*x, sizeof(value));
+
+        // Whole pixels are stored at once, blue in the first byte
+        const uint32_t pixel = ((value >> 10) & 0x001F) 
+            | (((value >> 5) & 0x001F) << 8) 
+            | (((value >> 0) & 0x001F) << 16);
+
+        memcpy(dst + 4*x, &pixel, sizeof(pixel));
+    }
+}
+
+/**
+ * Convert24To16RowBitmapWag packs a row of 24 bit pixels into 16 bits per 
+ * pixel
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert24To16RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    for(size_t x = 0; x < width; x++)
+    {
+        const uint16_t value = 0 
+            | ((0x1F & src[3*x]) << 10) 
+            | ((0x1F & src[3*x + 1]) << 5) 
+            | ((0x1F & src[3*x + 2]) << 0);
+
+        dst[2*x] = (uint8_t) value;
+        dst[2*x + 1] = (uint8_t) (value >> 8);
+    }
+}
+
+/**
+ * Convert32To16RowBitmapWag packs a row of 32 bit pixels into 16 bits per 
+ * pixel
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src row to read, not overlapping dst
+ * @param dst row to write
+ * @param width number of pixels in the row
+ */
+static void Convert32To16RowBitmapWag(const uint8_t * restrict src, 
+    uint8_t * restrict dst, const uint32_t width)
+{
+    for(size_t x = 0; x < width; x++)
+    {
+        const uint16_t value = 0 
+            | ((0x1F & src[4*x]) << 10) 
+            | ((0x1F & src[4*x + 1]) << 5) 
+            | ((0x1F & src[4*x + 2]) << 0);
+
+        dst[2*x] = (uint8_t) value;
+        dst[2*x + 1] = (uint8_t) (value >> 8);
+    }
+}
+
+/**
+ * ConvertRowsBitmapWag converts a band of rows from one bitmap to another 
+ * bitmap of the same size with a different number of bits per pixel. 
+ * The common conversions have their own row functions, the rest go through a
+ * row of BitmapWagRgbQuad. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param src bitmap to convert from
+ * @param dst bitmap to convert to
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @param scratch array of width colors
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ConvertRowsBitmapWag(const BitmapWagImg * src, 
+    BitmapWagImg * dst, const uint32_t y0, const uint32_t y1, 
+    BitmapWagRgbQuad * scratch)
+{
+    const uint16_t srcBits = src->bmih.biBitCount;
+    const uint16_t dstBits = dst->bmih.biBitCount;
+    const uint32_t width = src->bmih.biWidth;
+    uint8_t lut[256][4] = {{0}};
+    // The loops below are for the fixed layouts, images with channel masks 
+    // go through a row of BitmapWagRgbQuad
+    const uint8_t fixedLayouts = (src->bitfields == NULL 
+        && dst->bitfields == NULL);
+
+    // Table of palette colors for expanding palette indices
+    if(srcBits <= 8 && (dstBits == 24 || dstBits == 32))
+    {
+        const uint16_t possibleColors = GetPossibleColorsBitmapWag(src);
+
+        for(uint16_t i = 0; i < possibleColors; i++)
+        {
+            lut[i][0] = (src->aColors)[i].rgbBlue;
+            lut[i][1] = (src->aColors)[i].rgbGreen;
+            lut[i][2] = (src->aColors)[i].rgbRed;
+        }
+    }
+
+    for(uint32_t y = y0; y < y1; y++)
+    {
+        const uint8_t * srcRow = RowBitmapWag(src, y);
+        uint8_t * dstRow = RowBitmapWag(dst, y);
+
+        if(!fixedLayouts)
+        {
+            BitmapWagError error = DecodeSpanBitmapWag(src, srcRow, 0, 
+                scratch, width);
+
+            if(error == BITMAPWAG_SUCCESS)
+            {
+                error = EncodeSpanBitmapWag(dst, dstRow, 0, scratch, width);
+            }
+
+            if(error)
+            {
+                return error;
+            }
+        }
+        else if(srcBits == 24 && dstBits == 32)
+        {
+            Convert24To32RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits == 32 && dstBits == 24)
+        {
+            Convert32To24RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits == 16 && dstBits == 24)
+        {
+            Convert16To24RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits == 16 && dstBits == 32)
+        {
+            Convert16To32RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits == 24 && dstBits == 16)
+        {
+            Convert24To16RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits == 32 && dstBits == 16)
+        {
+            Convert32To16RowBitmapWag(srcRow, dstRow, width);
+        }
+        else if(srcBits <= 8 && (dstBits == 24 || dstBits == 32))
+        {
+            ExpandPaletteRowBitmapWag(srcRow, srcBits, dstRow, dstBits >> 3, 
+                (const uint8_t (*)[4]) lut, width);
+        }
+        else
+        {
+            BitmapWagError error = DecodeSpanBitmapWag(src, srcRow, 0, 
+                scratch, width);
+
+            if(error == BITMAPWAG_SUCCESS)
+            {
+                error = EncodeSpanBitmapWag(dst, dstRow, 0, scratch, width);
+            }
+
+            if(error)
+            {
+                return error;
+            }
+        }
+    }
+
+    return BITMAPWAG_SUCCESS;
+}
+
+// BitmapWagConvertJob is the job ConvertBitmapWag runs on bands of rows
+typedef struct {
+    const BitmapWagImg * src;
+    BitmapWagImg * dst;
+} BitmapWagConvertJob;
+
+/**
+ * ConvertBandBitmapWag converts a band of rows to a format without a palette, 
+ * so bands never touch shared state. 
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param ctx pointer to a BitmapWagConvertJob
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError ConvertBandBitmapWag(void * ctx, const uint32_t y0, 
+    const uint32_t y1)
+{
+    const BitmapWagConvertJob * job = (const BitmapWagConvertJob *) ctx;
+    const uint32_t width = job->src->bmih.biWidth;
+
+    // Row of colors for the conversions without their own loop
+    BitmapWagRgbQuad * scratch = (BitmapWagRgbQuad *) 
+        AllocBitmapWag(width * sizeof(BitmapWagRgbQuad));
+
+    if(scratch == NULL && width > 0)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    BitmapWagError error = ConvertRowsBitmapWag(job->src, job->dst, y0, y1, 
+        scratch);
+
+    free(scratch);
+
+    return error;
+}
+
+BitmapWagError ConvertBitmapWag(const BitmapWagImg * src, BitmapWagImg * dst,
+    const uint16_t bitsPerPixel)
+{
+    BitmapWagError retVal;
+
+    if(src == NULL || dst == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    // Check to make sure that the source has already been initialized
+    if(src->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    if(src->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(src->bmih.biBitCount <= 8 && src->aColors == NULL)
+    {
+        return BITMAPWAG_COLOR_PALETTE_NULL;
+    }
+
+    const uint16_t srcBits = src->bmih.biBitCount;
+
+    if(srcBits != 1 && srcBits != 2 && srcBits != 4 && srcBits != 8 
+        && srcBits != 16 && srcBits != 24 && srcBits != 32)
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4 
+        && bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 24 
+        && bitsPerPixel != 32)
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    const uint32_t width = src->bmih.biWidth;
+    const uint32_t height = src->bmih.biHeight;
+
+    retVal = InitializeBitmapWag(dst, height, width, bitsPerPixel);
+
+    if(retVal != BITMAPWAG_SUCCESS 
+        && retVal != BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+    {
+        return retVal;
+    }
+
+    // dst keeps the row order of src, its rows are all zero so far
+    dst->topDown = src->topDown;
+    SetRowsBitmapWag(dst, height, GetRowMemory(width, bitsPerPixel));
+
+    // Same format, the image bits and the palette are copied as they are
+    if(srcBits == bitsPerPixel && src->bitfields == NULL)
+    {
+        const size_t rowMemory = GetRowMemory(width, srcBits);
+
+        if(GetStrideBitmapWag(src) == rowMemory)
+        {
+            memcpy(dst->aBitmapBits, src->aBitmapBits, rowMemory * height);
+        }
+        // The rows of an external image may be further apart
+        else
+        {
+            for(uint32_t y = 0; y < height; y++)
+            {
+                memcpy(RowBitmapWag(dst, y), RowBitmapWag(src, y), 
+                    rowMemory);
+            }
+        }
+
+        if(srcBits <= 8)
+        {
+            const uint16_t possibleColors = GetPossibleColorsBitmapWag(src);
+
+            memcpy(dst->aColors, src->aColors, 
+                possibleColors * sizeof(BitmapWagRgbQuad));
+
+            if(dst->colorUsed != NULL)
+            {
+                SetColorUsedArrayBitmapWag(dst, dst->colorUsed);
+                BuildPaletteHashBitmapWag(dst);
+            }
+        }
+
+        return retVal;
+    }
+
+    // Converting to a palette adds colors to the palette of dst as it goes, 
+    // so only the other formats are split over the thread pool
+    if(bitsPerPixel > 8)
+    {
+        BitmapWagConvertJob job = {src, dst};
+        BitmapWagError error = RunRowsBitmapWag(ConvertBandBitmapWag, &job, 
+            height, GetRowMemory(width, bitsPerPixel));
+
+        return error ? error : retVal;
+    }
+
+    // Row of colors for the conversions without their own loop
+    BitmapWagRgbQuad * scratch = (BitmapWagRgbQuad *) 
+        AllocBitmapWag(width * sizeof(BitmapWagRgbQuad));
+
+    if(scratch == NULL && width > 0)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    BitmapWagError error = ConvertRowsBitmapWag(src, dst, 0, height, scratch);
+
+    free(scratch);
+
+    return error ? error : retVal;
+}
+
+// Bits of each channel kept by the quantization histogram and the inverse
+// color map, and the number of cells they have
+#define BITMAPWAG_QUANT_BITS 5
+#define BITMAPWAG_QUANT_SIDE (1 << BITMAPWAG_QUANT_BITS)
+#define BITMAPWAG_QUANT_CELLS (1 << (3 * BITMAPWAG_QUANT_BITS))
+
+// BitmapWagQuantCell is one cell of the quantization histogram
+typedef struct {
+    // number of pixels in the cell
+    uint64_t count;
+    // sums of the red, green and blue of the pixels in the cell
+    uint64_t sum[3];
+    // first color seen in the cell, and whether any other color was seen
+    BitmapWagRgbQuad color;
+    uint8_t mixed;
+} BitmapWagQuantCell;
+
+// BitmapWagQuantBox is a box of histogram cells being cut by median cut
+typedef struct {
+    // lowest and highest red, green and blue cell of the box, inclusive
+    uint8_t lo[3];
+    uint8_t hi[3];
+    // number of pixels in the box
+    uint64_t count;
+} BitmapWagQuantBox;
+
+// BitmapWagQuantizeJob is the job QuantizeBitmapWag runs on bands of rows
+typedef struct {
+    const BitmapWagImg * src;
+    BitmapWagImg * dst;
+    // palette being quantized to
+    const BitmapWagRgbQuad * palette;
+    uint16_t numColors;
+    // inverse color map, one plus the palette index of the color nearest
+    // each histogram cell, zero until the cell is first looked up
+    uint16_t * inverse;
+    BitmapWagDither dither;
+    // strength of ordered dithering, the largest offset added to a channel
+    int32_t spread;
+} BitmapWagQuantizeJob;
+
+// 4x4 Bayer matrix of ordered dithering
+static const uint8_t bayerBitmapWag[4][4] = {
+    { 0,  8,  2, 10},
+    {12,  4, 14,  6},
+    { 3, 11,  1,  9},
+    {15,  7, 13,  5}
+};
+
+/**
+ * QuantCellBitmapWag finds the histogram cell of a color
+ * This is used internally by the libBitmapWag library.
+ *
+ * @return index of the cell
+ */
+static uint32_t QuantCellBitmapWag(const uint8_t r, const uint8_t g,
+    const uint8_t b)
+{
+    const uint8_t drop = 8 - BITMAPWAG_QUANT_BITS;
+
+    return ((uint32_t) (r >> drop) << (2 * BITMAPWAG_QUANT_BITS))
+        | ((uint32_t) (g >> drop) << BITMAPWAG_QUANT_BITS) | (b >> drop);
+}
+
+/**
+ * ShrinkQuantBoxBitmapWag shrinks a box to the smallest box holding the same
+ * pixels, and counts them
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param histogram quantization histogram
+ * @param box box to shrink
+ */
+static void ShrinkQuantBoxBitmapWag(const BitmapWagQuantCell * histogram,
+    BitmapWagQuantBox * box)
+{
+    uint8_t lo[3] = {BITMAPWAG_QUANT_SIDE, BITMAPWAG_QUANT_SIDE,
+        BITMAPWAG_QUANT_SIDE};
+    uint8_t hi[3] = {0, 0, 0};
+    uint64_t count = 0;
+
+    for(uint32_t r = box->lo[0]; r <= box->hi[0]; r++)
+    {
+        for(uint32_t g = box->lo[1]; g <= box->hi[1]; g++)
+        {
+            for(uint32_t b = box->lo[2]; b <= box->hi[2]; b++)
+            {
+                const uint64_t cellCount = histogram[
+                    (r << (2 * BITMAPWAG_QUANT_BITS))
+                    | (g << BITMAPWAG_QUANT_BITS) | b].count;
+                const uint8_t c[3] = {r, g, b};
+
+                if(cellCount == 0)
+                {
+                    continue;
+                }
+
+                count += cellCount;
+
+                for(unsigned k = 0; k < 3; k++)
+                {
+                    lo[k] = (c[k] < lo[k]) ? c[k] : lo[k];
+                    hi[k] = (c[k] > hi[k]) ? c[k] : hi[k];
+                }
+            }
+        }
+    }
+
+    box->count = count;
+
+    if(count > 0)
+    {
+        memcpy(box->lo, lo, sizeof(lo));
+        memcpy(box->hi, hi, sizeof(hi));
+    }
+}
+
+/**
+ * MedianCutBitmapWag builds a palette by cutting the histogram into boxes
+ * with about the same number of pixels on each side of every cut. The most
+ * populated box is cut until three quarters of the boxes are made, then the
+ * box with the largest product of pixels and volume, so sparse areas of the
+ * histogram still get colors.
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param histogram quantization histogram
+ * @param maxColors most colors to put in the palette
+ * @param palette palette to populate, with the average color of each box
+ * @return number of colors in the palette
+ */
+static uint16_t MedianCutBitmapWag(const BitmapWagQuantCell * histogram,
+    const uint16_t maxColors, BitmapWagRgbQuad * palette)
+{
+    BitmapWagQuantBox boxes[256];
+    uint16_t numBoxes = 1;
+
+    boxes[0] = (BitmapWagQuantBox) {{0, 0, 0}, {BITMAPWAG_QUANT_SIDE - 1,
+        BITMAPWAG_QUANT_SIDE - 1, BITMAPWAG_QUANT_SIDE - 1}, 0};
+    ShrinkQuantBoxBitmapWag(histogram, &boxes[0]);
+
+    while(numBoxes < maxColors)
+    {
+        const int byVolume = (numBoxes >= (maxColors * 3) / 4);
+        uint64_t bestScore = 0;
+        int best = -1;
+
+        for(uint16_t i = 0; i < numBoxes; i++)
+        {
+            const BitmapWagQuantBox * box = &boxes[i];
+            const uint64_t volume = (uint64_t) (box->hi[0] - box->lo[0] + 1)
+                * (box->hi[1] - box->lo[1] + 1)
+                * (box->hi[2] - box->lo[2] + 1);
+            const uint64_t score = byVolume ? box->count * volume
+                : box->count;
+
+            // A box of a single cell can't be cut
+            if(volume > 1 && score > bestScore)
+            {
+                bestScore = score;
+                best = i;
+            }
+        }
+
+        if(best < 0)
+        {
+            break;
+        }
+
+        BitmapWagQuantBox * box = &boxes[best];
+        unsigned axis = 0;
+
+        // Cut across the longest side of the box
+        for(unsigned k = 1; k < 3; k++)
+        {
+            if(box->hi[k] - box->lo[k] > box->hi[axis] - box->lo[axis])
+            {
+                axis = k;
+            }
+        }
+
+        // Number of pixels in each slice of the box along the axis
+        uint64_t slices[BITMAPWAG_QUANT_SIDE] = {0};
+
+        for(uint32_t r = box->lo[0]; r <= box->hi[0]; r++)
+        {
+            for(uint32_t g = box->lo[1]; g <= box->hi[1]; g++)
+            {
+                for(uint32_t b = box->lo[2]; b <= box->hi[2]; b++)
+                {
+                    const uint8_t c[3] = {r, g, b};
+
+                    slices[c[axis]] += histogram[
+                        (r << (2 * BITMAPWAG_QUANT_BITS))
+                        | (g << BITMAPWAG_QUANT_BITS) | b].count;
+                }
+            }
+        }
+
+        // The box is shrunk, so the first and last slices hold pixels and
+        // cutting before the last slice leaves pixels on both sides
+        uint8_t cut = box->lo[axis];
+        uint64_t below = slices[cut];
+
+        while(cut + 1 < box->hi[axis] && below < (box->count + 1) / 2)
+        {
+            cut++;
+            below += slices[cut];
+        }
+
+        boxes[numBoxes] = *box;
+        box->hi[axis] = cut;
+        boxes[numBoxes].lo[axis] = cut + 1;
+        ShrinkQuantBoxBitmapWag(histogram, box);
+        ShrinkQuantBoxBitmapWag(histogram, &boxes[numBoxes]);
+        numBoxes++;
+    }
+
+    // The color of each box is the average of its pixels
+    for(uint16_t i = 0; i < numBoxes; i++)
+    {
+        const BitmapWagQuantBox * box = &boxes[i];
+        uint64_t sum[3] = {0, 0, 0};
+
+        for(uint32_t r = box->lo[0]; r <= box->hi[0]; r++)
+        {
+            for(uint32_t g = box->lo[1]; g <= box->hi[1]; g++)
+            {
+                for(uint32_t b = box->lo[2]; b <= box->hi[2]; b++)
+                {
+                    const BitmapWagQuantCell * cell = &histogram[
+                        (r << (2 * BITMAPWAG_QUANT_BITS))
+                        | (g << BITMAPWAG_QUANT_BITS) | b];
+
+                    for(unsigned k = 0; k < 3; k++)
+                    {
+                        sum[k] += cell->sum[k];
+                    }
+                }
+            }
+        }
+
+        const uint64_t count = box->count ? box->count : 1;
+
+        palette[i] = (BitmapWagRgbQuad) {
+            (uint8_t) ((sum[2] + count / 2) / count),
+            (uint8_t) ((sum[1] + count / 2) / count),
+            (uint8_t) ((sum[0] + count / 2) / count), 0};
+    }
+
+    return numBoxes;
+}
+
+/**
+ * NearestColorBitmapWag finds the palette color nearest a color through the
+ * inverse color map, searching the palette for the centre of the color's
+ * histogram cell the first time the cell is looked up. Bands fill the map at
+ * the same time, every band stores the same index so relaxed atomics are
+ * enough.
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param job quantization job
+ * @return palette index of the nearest color
+ */
+static uint8_t NearestColorBitmapWag(const BitmapWagQuantizeJob * job,
+    const uint8_t r, const uint8_t g, const uint8_t b)
+{
+    const uint32_t cell = QuantCellBitmapWag(r, g, b);
+    uint16_t entry = __atomic_load_n(&(job->inverse)[cell], __ATOMIC_RELAXED);
+
+    if(entry == 0)
+    {
+        // Centre of the cell
+        const uint8_t half = 1 << (7 - BITMAPWAG_QUANT_BITS);
+        const uint8_t keep = (uint8_t) (0xFF << (8 - BITMAPWAG_QUANT_BITS));
+        const int32_t cr = (r & keep) | half;
+        const int32_t cg = (g & keep) | half;
+        const int32_t cb = (b & keep) | half;
+        int32_t bestDistance = INT32_MAX;
+
+        for(uint16_t i = 0; i < job->numColors; i++)
+        {
+            const int32_t dr = (job->palette)[i].rgbRed - cr;
+            const int32_t dg = (job->palette)[i].rgbGreen - cg;
+            const int32_t db = (job->palette)[i].rgbBlue - cb;
+            const int32_t distance = dr*dr + dg*dg + db*db;
+
+            if(distance < bestDistance)
+            {
+                bestDistance = distance;
+                entry = i + 1;
+            }
+        }
+
+        __atomic_store_n(&(job->inverse)[cell], entry, __ATOMIC_RELAXED);
+    }
+
+    return entry - 1;
+}
+
+/**
+ * SetQuantIndexBitmapWag sets the palette index of a pixel in a zeroed row
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param row row of the palette image
+ * @param x horizontal coordinate of the pixel
+ * @param bitsPerPixel bits per pixel of the image, 1, 2, 4 or 8
+ * @param index palette index of the pixel
+ */
+static void SetQuantIndexBitmapWag(uint8_t * row, const uint32_t x,
+    const uint16_t bitsPerPixel, const uint8_t index)
+{
+    // Number of bits to shift x by to find the byte holding the pixel
+    const uint16_t pixelShift = 4 - ceilLog2b16_t(bitsPerPixel);
+    // Pixels of a byte are stored from the high bits down
+    const uint8_t sftAmnt = 8 - bitsPerPixel
+        - bitsPerPixel * (x & ((1u << pixelShift) - 1));
+
+    row[x >> pixelShift] |= index << sftAmnt;
+}
+
+/**
+ * QuantizeRowsBitmapWag quantizes a band of rows without dithering or with
+ * ordered dithering
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param ctx pointer to a BitmapWagQuantizeJob
+ * @param y0 first row of the band
+ * @param y1 one past the last row of the band
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError QuantizeRowsBitmapWag(void * ctx, const uint32_t y0,
+    const uint32_t y1)
+{
+    const BitmapWagQuantizeJob * job = (const BitmapWagQuantizeJob *) ctx;
+    const BitmapWagImg * src = job->src;
+    BitmapWagImg * dst = job->dst;
+    const uint32_t width = src->bmih.biWidth;
+    const uint16_t bitsPerPixel = dst->bmih.biBitCount;
+
+    BitmapWagRgbQuad * colors = (BitmapWagRgbQuad *)
+        AllocBitmapWag(width * sizeof(BitmapWagRgbQuad));
+
+    if(colors == NULL && width > 0)
+    {
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    for(uint32_t j = y0; j < y1; j++)
+    {
+        uint8_t * row = RowBitmapWag(dst, j);
+
+        DecodeSpanBitmapWag(src, RowBitmapWag(src, j), 0, colors, width);
+
+        for(uint32_t i = 0; i < width; i++)
+        {
+            int32_t r = colors[i].rgbRed;
+            int32_t g = colors[i].rgbGreen;
+            int32_t b = colors[i].rgbBlue;
+
+            if(job->dither == BITMAPWAG_DITHER_ORDERED)
+            {
+                // Offset from -spread/2 to spread/2
+                const int32_t offset = ((2 * bayerBitmapWag[j & 3][i & 3]
+                    - 15) * job->spread) / 32;
+
+                r = (r + offset < 0) ? 0 : (r + offset > 255) ? 255
+                    : r + offset;
+                g = (g + offset < 0) ? 0 : (g + offset > 255) ? 255
+                    : g + offset;
+                b = (b + offset < 0) ? 0 : (b + offset > 255) ? 255
+                    : b + offset;
+            }
+
+            SetQuantIndexBitmapWag(row, i, bitsPerPixel,
+                NearestColorBitmapWag(job, r, g, b));
+        }
+    }
+
+    free(colors);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+/**
+ * DiffuseBitmapWag quantizes a whole image with Floyd-Steinberg dithering,
+ * going from the top row down and alternating the direction of every row.
+ * This is used internally by the libBitmapWag library.
+ *
+ * @param job quantization job
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError DiffuseBitmapWag(const BitmapWagQuantizeJob * job)
+{
+    const BitmapWagImg * src = job->src;
+    BitmapWagImg * dst = job->dst;
+    const uint32_t width = src->bmih.biWidth;
+    const uint32_t height = src->bmih.biHeight;
+    const uint16_t bitsPerPixel = dst->bmih.biBitCount;
+
+    BitmapWagRgbQuad * colors = (BitmapWagRgbQuad *)
+        AllocBitmapWag(width * sizeof(BitmapWagRgbQuad));
+    // Error carried to the current and the next row in sixteenths, three
+    // channels per pixel with a pixel of margin on both sides
+    int32_t * errors = (int32_t *)
+        AllocBitmapWag(2 * 3 * ((size_t) width + 2) * sizeof(int32_t));
+
+    if(colors == NULL || errors == NULL)
+    {
+        free(colors);
+        free(errors);
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    memset(errors, 0, 2 * 3 * ((size_t) width + 2) * sizeof(int32_t));
+
+    for(uint32_t n = 0; n < height; n++)
+    {
+        const uint32_t j = height - 1 - n;
+        uint8_t * row = RowBitmapWag(dst, j);
+        int32_t * current = &errors[3 * ((n & 1) ? (size_t) width + 2 : 0)];
+        int32_t * next = &errors[3 * ((n & 1) ? 0 : (size_t) width + 2)];
+        const int32_t step = (n & 1) ? -1 : 1;
+
+        DecodeSpanBitmapWag(src, RowBitmapWag(src, j), 0, colors, width);
+        memset(next, 0, 3 * ((size_t) width + 2) * sizeof(int32_t));
+
+        for(uint32_t k = 0; k < width; k++)
+        {
+            const uint32_t i = (n & 1) ? width - 1 - k : k;
+            // Position of the pixel in the error rows, after the margin
+            const size_t e = 3 * ((size_t) i + 1);
+            const int32_t original[3] = {colors[i].rgbRed,
+                colors[i].rgbGreen, colors[i].rgbBlue};
+            int32_t value[3];
+
+            for(unsigned c = 0; c < 3; c++)
+            {
+                // Round the carried error to the nearest whole step
+                const int32_t carried = current[e + c];
+
+                value[c] = original[c] + (carried + ((carried < 0) ? -8 : 8))
+                    / 16;
+                value[c] = (value[c] < 0) ? 0 : (value[c] > 255) ? 255
+                    : value[c];
+            }
+
+            const uint8_t index = NearestColorBitmapWag(job, value[0],
+                value[1], value[2]);
+            const int32_t chosen[3] = {(job->palette)[index].rgbRed,
+                (job->palette)[index].rgbGreen,
+                (job->palette)[index].rgbBlue};
+
+            SetQuantIndexBitmapWag(row, i, bitsPerPixel, index);
+
+            // Spread the error ahead in the row and onto the next row
+            for(unsigned c = 0; c < 3; c++)
+            {
+                const int32_t error = value[c] - chosen[c];
+
+                current[e + 3*step + c] += error * 7;
+                next[e - 3*step + c] += error * 3;
+                next[e + c] += error * 5;
+                next[e + 3*step + c] += error;
+            }
+        }
+    }
+
+    free(colors);
+    free(errors);
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError QuantizeBitmapWag(const BitmapWagImg * src, BitmapWagImg * dst,
+    const uint16_t bitsPerPixel, const BitmapWagQuantizeOptions * options)
+{
+    const BitmapWagQuantizeOptions defaultOptions = {0, BITMAPWAG_DITHER_NONE};
+    BitmapWagError retVal;
+
+    if(src == NULL || dst == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(options == NULL)
+    {
+        options = &defaultOptions;
+    }
+
+    // Check to make sure that the source has already been initialized
+    if(src->state != BITMAPWAG_STATE_INITIALIZED)
+    {
+        return BITMAPWAG_NOT_INIT;
+    }
+
+    if(src->aBitmapBits == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
+
+    if(src->bmih.biBitCount <= 8 && src->aColors == NULL)
+    {
+        return BITMAPWAG_COLOR_PALETTE_NULL;
+    }
+
+    const uint16_t srcBits = src->bmih.biBitCount;
+
+    if(srcBits != 1 && srcBits != 2 && srcBits != 4 && srcBits != 8
+        && srcBits != 16 && srcBits != 24 && srcBits != 32)
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4
+        && bitsPerPixel != 8)
+    {
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+    }
+
+    if(options->dither != BITMAPWAG_DITHER_NONE
+        && options->dither != BITMAPWAG_DITHER_ORDERED
+        && options->dither != BITMAPWAG_DITHER_FLOYD_STEINBERG)
+    {
+        return BITMAPWAG_DITHER_NOT_SUPPORTED;
+    }
+
+    const uint32_t width = src->bmih.biWidth;
+    const uint32_t height = src->bmih.biHeight;
+    const size_t srcRowMemory = GetRowMemory(width, srcBits);
+    const uint16_t maxColors = (options->maxColors == 0
+        || options->maxColors > (1 << bitsPerPixel)) ? 1 << bitsPerPixel
+        : options->maxColors;
+
+    retVal = InitializeBitmapWag(dst, height, width, bitsPerPixel);
+
+    if(retVal != BITMAPWAG_SUCCESS
+        && retVal != BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE)
+    {
+        return retVal;
+    }
+
+    // dst keeps the row order of src, its rows are all zero so far
+    dst->topDown = src->topDown;
+    SetRowsBitmapWag(dst, height, GetRowMemory(width, bitsPerPixel));
+
+    BitmapWagQuantCell * histogram = (BitmapWagQuantCell *)
+        AllocBitmapWag(BITMAPWAG_QUANT_CELLS * sizeof(BitmapWagQuantCell));
+    uint16_t * inverse = (uint16_t *)
+        AllocBitmapWag(BITMAPWAG_QUANT_CELLS * sizeof(uint16_t));
+    BitmapWagRgbQuad * colors = (BitmapWagRgbQuad *)
+        AllocBitmapWag(width * sizeof(BitmapWagRgbQuad));
+
+    if(histogram == NULL || inverse == NULL || (colors == NULL && width > 0))
+    {
+        free(histogram);
+        free(inverse);
+        free(colors);
+        return BITMAPWAG_ALLOCATE_BUFFER_FAILED;
+    }
+
+    memset(histogram, 0, BITMAPWAG_QUANT_CELLS * sizeof(BitmapWagQuantCell));
+    memset(inverse, 0, BITMAPWAG_QUANT_CELLS * sizeof(uint16_t));
+
+    // Count the colors of src into the histogram
+    for(uint32_t j = 0; j < height; j++)
+    {
+        DecodeSpanBitmapWag(src, RowBitmapWag(src, j), 0, colors, width);
+
+        for(uint32_t i = 0; i < width; i++)
+        {
+            const BitmapWagRgbQuad color = {colors[i].rgbBlue,
+                colors[i].rgbGreen, colors[i].rgbRed, 0};
+            BitmapWagQuantCell * cell = &histogram[QuantCellBitmapWag(
+                color.rgbRed, color.rgbGreen, color.rgbBlue)];
+
+            if(cell->count == 0)
+            {
+                cell->color = color;
+            }
+            else if(!CompareColors(cell->color, color))
+            {
+                cell->mixed = 1;
+            }
+
+            cell->count++;
+            cell->sum[0] += color.rgbRed;
+            cell->sum[1] += color.rgbGreen;
+            cell->sum[2] += color.rgbBlue;
+        }
+    }
+
+    free(colors);
+
+    BitmapWagRgbQuad palette[256] = {{0}};
+    uint16_t numColors = 0;
+    int exact = 1;
+
+    // Use the colors of src as they are if they fit in the palette and each
+    // has a histogram cell of its own
+    for(uint32_t i = 0; i < BITMAPWAG_QUANT_CELLS && exact; i++)
+    {
+        if(histogram[i].count == 0)
+        {
+            continue;
+        }
+
+        if(histogram[i].mixed || numColors >= maxColors)
+        {
+            exact = 0;
+            break;
+        }
+
+        palette[numColors] = histogram[i].color;
+        inverse[i] = ++numColors;
+    }
+
+    if(!exact)
+    {
+        memset(inverse, 0, BITMAPWAG_QUANT_CELLS * sizeof(uint16_t));
+        numColors = MedianCutBitmapWag(histogram, maxColors, palette);
+    }
+
+    // An image without pixels still gets one palette color
+    numColors = (numColors > 0) ? numColors : 1;
+
+    free(histogram);
+
+    memcpy(dst->aColors, palette, numColors * sizeof(BitmapWagRgbQuad));
+
+    // Strength of ordered dithering is about the distance between the levels
+    // of a channel in a uniform palette of the same size
+    uint16_t levels = 1;
+
+    while((levels + 1) * (levels + 1) * (levels + 1) <= numColors)
+    {
+        levels++;
+    }
+
+    BitmapWagQuantizeJob job = {src, dst, palette, numColors, inverse,
+        exact ? BITMAPWAG_DITHER_NONE : options->dither, 255 / (levels + 1)};
+    BitmapWagError error;
+
+    if(job.dither == BITMAPWAG_DITHER_FLOYD_STEINBERG)
+    {
+        error = DiffuseBitmapWag(&job);
+    }
+    else
+    {
+        error = RunRowsBitmapWag(QuantizeRowsBitmapWag, &job, height,
+            srcRowMemory);
+    }
+
+    free(inverse);
+
+    // Every palette color is kept for SetBitmapWagPixel, even if no pixel
+    // ended up using it
+    if(dst->colorUsed != NULL)
+    {
+        memset(dst->colorUsed, 1, numColors);
+        BuildPaletteHashBitmapWag(dst);
+    }
+
+    return error ? error : retVal;
+}
+
+// Largest amount of image data a stream holds before writing it to the file
+#define BITMAPWAG_STREAM_BUFFER_SIZE (1 << 20)
+
+// Struct containing the state of a bitmap being streamed to a file
+struct BitmapWagStream {
+    // img holds the headers and color palette of the image being written, 
+    // it has no image bits 
+    BitmapWagImg img;
+    // io the image is being written to
+    BitmapWagIo io;
+    // file opened by the stream, NULL when writing to a caller's BitmapWagIo
+    FILE * fp;
+    // buffer holds rows that have not been written to the file yet
+    uint8_t * buffer;
+    // bufferSize is the size of buffer in bytes, a whole number of rows
+    size_t bufferSize;
+    // bufferUsed is the number of bytes in buffer waiting to be written
+    size_t bufferUsed;
+    // rowMemory is the size of one row of the image in bytes
+    size_t rowMemory;
+    // rowsPushed is the number of rows given to the stream so far
+    uint32_t rowsPushed;
+    // error is the first error that occured writing to the file
+    BitmapWagError error;
+}; 
+
+/**
+ * FlushBitmapWagStream writes the rows held in the stream buffer to the file
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param stream pointer to a bitmap stream
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError FlushBitmapWagStream(BitmapWagStream * stream)
+{
+    if(stream->bufferUsed > 0 && stream->error == BITMAPWAG_SUCCESS)
+    {
+        size_t itemsWritten = WriteIoBitmapWag(&(stream->io), stream->buffer, 
+            stream->bufferUsed);
+
+        if(itemsWritten != 1)
+        {
+            stream->error = BITMAPWAG_IMAGE_NOT_WRITTEN;
+        }
+    }
+    stream->bufferUsed = 0;
+
+    return stream->error;
+}
+
+/**
+ * BeginStreamBitmapWag starts a stream writing to either a file or a 
+ * BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param stream pointer to the stream pointer to populate
+ * @param filePath path of the file to write, NULL to write to io
+ * @param io BitmapWagIo to write to when filePath is NULL
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel
+ * @param palette color palette of the image
+ * @param numColors number of colors in palette, zero for 1 << bitsPerPixel
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+static BitmapWagError BeginStreamBitmapWag(BitmapWagStream ** stream, 
+    const char * filePath, const BitmapWagIo * io, const uint32_t height, 
+    const uint32_t width, const uint16_t bitsPerPixel, 
+    const BitmapWagRgbQuad * palette, const uint32_t numColors)
+{
+    size_t sizeOfPalette = 0;
+    size_t itemsWritten;
 
-    // Read the image into memory 
-    itemsRead = fread(bm->aBitmapBits, bytesForImage, 1, fp);
+    *stream = NULL;
 
-    if(itemsRead != 1)
+    if(bitsPerPixel != 1 && bitsPerPixel != 2 && bitsPerPixel != 4 
+        && bitsPerPixel != 8 && bitsPerPixel != 16 && bitsPerPixel != 24 
+        && bitsPerPixel != 32)
     {
-        fclose(fp);
-        return BITMAPWAG_BITMAPBITS_NOT_READ;
+        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
     }
 
-    //close the file
-    fclose(fp);
+    BitmapWagStream * output = (BitmapWagStream *) 
+        AllocBitmapWag(sizeof(BitmapWagStream));
 
-    // Initialize color used array
-    if(bm->bmih.biBitCount <= 8 && bm->colorUsed != NULL)
+    if(output == NULL)
     {
-        SetColorUsedArrayBitmapWag(bm, bm->colorUsed);
-        // NOTE: We don't look at error values because none of them are valid
-        // for this function in this usage. 
+        return BITMAPWAG_ALLOCATE_STREAM_FAILED;
     }
 
-    // Return successful 
-    return retVal;
-}
-
-BitmapWagError WriteBitmapWag(const BitmapWagImg * bm, 
-    const char * filePath)
-{
-    // Pointer to the file
-    FILE *fp;
-    size_t itemsWritten;
+    *output = (BitmapWagStream){0};
+    output->img.allocator = defaultAllocator;
+    output->img.state = BITMAPWAG_STATE_INITIALIZED;
+    output->rowMemory = GetRowMemory(width, bitsPerPixel);
 
-    // Check for null pointers before anything is done in this function.
-    if(bm == NULL) 
+    // The palette has to be complete before any rows are written, every entry
+    // given is marked as used so rows of colors can only use these entries
+    if(bitsPerPixel <= 8)
     {
-        return BITMAPWAG_NULL;
+        const uint32_t maxColors = 1 << bitsPerPixel;
+        const uint32_t paletteColors = (numColors > 0) ? numColors : maxColors;
+
+        if(palette == NULL)
+        {
+            free(output);
+            return BITMAPWAG_COLOR_PALETTE_NULL;
+        }
+
+        if(paletteColors > maxColors)
+        {
+            free(output);
+            return BITMAPWAG_OUT_OF_COLORS;
+        }
+
+        sizeOfPalette = paletteColors * sizeof(BitmapWagRgbQuad);
+        output->img.aColors = (BitmapWagRgbQuad *) 
+            AllocBitmapWag(sizeOfPalette);
+        output->img.colorUsed = (uint8_t *) AllocBitmapWag(paletteColors);
+
+        if(output->img.aColors == NULL || output->img.colorUsed == NULL)
+        {
+            free(output->img.aColors);
+            free(output->img.colorUsed);
+            free(output);
+            return BITMAPWAG_ALLOCATE_PALETTE_FAILED;
+        }
+
+        for(uint32_t i = 0; i < paletteColors; i++)
+        {
+            (output->img.aColors)[i] = palette[i];
+            (output->img.colorUsed)[i] = 1;
+        }
+        output->img.bmih.biClrUsed = paletteColors;
     }
-    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+
+    SetHeadersBitmapWag(&(output->img), height, width, bitsPerPixel, 
+        sizeOfPalette);
+    BuildPaletteHashBitmapWag(&(output->img));
+
+    // Hold as many whole rows as fit in the buffer, but at least one
+    output->bufferSize = output->rowMemory;
+    if(output->rowMemory > 0 
+        && output->rowMemory < BITMAPWAG_STREAM_BUFFER_SIZE)
     {
-        return BITMAPWAG_NOT_INIT;
+        output->bufferSize = (BITMAPWAG_STREAM_BUFFER_SIZE / output->rowMemory)
+            * output->rowMemory;
     }
-    if (filePath == NULL)
+
+    output->buffer = (uint8_t *) AllocBitmapWag(output->bufferSize);
+
+    if(output->buffer == NULL && output->bufferSize > 0)
     {
-        return BITMAPWAG_FILE_PATH_NULL;
+        free(output->img.aColors);
+        free(output->img.colorUsed);
+        free(output);
+        return BITMAPWAG_ALLOCATE_STREAM_FAILED;
     }
-    // Check to on the bitmap bits pointer
-    if(bm->aBitmapBits == NULL)
+
+    if(filePath != NULL)
     {
-        return BITMAPWAG_BITMAPBITS_NULL;
-    }
+        // open filePath as binary file for writing 
+        output->fp = fopen(filePath, "wb");
 
-    // open filePath as binary file for writing 
-    fp = fopen(filePath, "wb");
+        if(output->fp == NULL)
+        {
+            free(output->buffer);
+            free(output->img.aColors);
+            free(output->img.colorUsed);
+            free(output);
+            return BITMAPWAG_CANNOT_OPEN_FILE;
+        }
 
-    if(fp == NULL)
+        SetFileIoBitmapWag(&(output->io), output->fp);
+    }
+    else
     {
-        return BITMAPWAG_CANNOT_OPEN_FILE;
+        output->io = *io;
     }
 
+    *stream = output;
+
     // Write the bitmap file header 
-    itemsWritten = fwrite(&(bm->bmfh), sizeof(bm->bmfh), 1, fp);
+    itemsWritten = WriteIoBitmapWag(&(output->io), &(output->img.bmfh), 
+        sizeof(output->img.bmfh));
 
     if(itemsWritten != 1)
     {
-        fclose(fp);
-        return BITMAPWAG_BMFH_NOT_WRITTEN;
+        output->error = BITMAPWAG_BMFH_NOT_WRITTEN;
+        return output->error;
     }
 
     // Write the bitmap info header 
-    itemsWritten = fwrite(&(bm->bmih), sizeof(bm->bmih), 1, fp);
+    itemsWritten = WriteIoBitmapWag(&(output->io), &(output->img.bmih), 
+        sizeof(output->img.bmih));
 
     if(itemsWritten != 1)
     {
-        fclose(fp);
-        return BITMAPWAG_BMIH_NOT_WRITTEN;
+        output->error = BITMAPWAG_BMIH_NOT_WRITTEN;
+        return output->error;
     }
-    
-    uint16_t bitsPerPixel = bm->bmih.biBitCount;
-    uint32_t width = bm->bmih.biWidth;
-    uint32_t height = bm->bmih.biHeight;
-
-    // Find the amount of memory that needs to be allocated for the image array
-    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
-    
-    size_t bytesForImage = rowMemory * height;
 
     // Write the color palette if we're using 256-colors or less
-    if(bm->bmih.biBitCount <= 8)
+    if(sizeOfPalette > 0)
     {
-        if(bm->aColors == NULL)
-        {
-            fclose(fp);
-            return BITMAPWAG_COLOR_PALETTE_NULL;
-        }
+        itemsWritten = WriteIoBitmapWag(&(output->io), output->img.aColors, 
+            sizeOfPalette);
 
-        size_t sizeOfPalette;
-        if(bm->bmih.biClrUsed > 0)
-        {
-            sizeOfPalette = bm->bmih.biClrUsed * sizeof(BitmapWagRgbQuad);
-        }
-        else
+        if(itemsWritten != 1)
         {
-            // Calculate number of colors based on biBitCount
-            size_t numColors = 1 << bm->bmih.biBitCount;
-            sizeOfPalette = numColors * sizeof(BitmapWagRgbQuad);
+            output->error = BITMAPWAG_PALETTE_NOT_WRITTEN;
+            return output->error;
         }
+    }
 
-        itemsWritten = fwrite(bm->aColors, sizeof(BitmapWagRgbQuad), 
-            sizeOfPalette/sizeof(BitmapWagRgbQuad), fp);
+    return BITMAPWAG_SUCCESS;
+}
 
-        if(itemsWritten != sizeOfPalette/sizeof(BitmapWagRgbQuad))
-        {
-            fclose(fp);
-            return BITMAPWAG_PALETTE_NOT_WRITTEN;
-        }
+BitmapWagError BeginBitmapWagStream(BitmapWagStream ** stream, 
+    const char * filePath, const uint32_t height, const uint32_t width, 
+    const uint16_t bitsPerPixel, const BitmapWagRgbQuad * palette, 
+    const uint32_t numColors)
+{
+    if(stream == NULL)
+    {
+        return BITMAPWAG_NULL;
     }
 
-    // Write the aBitmapBits array
-    itemsWritten = fwrite(bm->aBitmapBits, sizeof(uint8_t), 
-        bytesForImage/sizeof(uint8_t), fp);
+    *stream = NULL;
 
-    if(itemsWritten != bytesForImage/sizeof(uint8_t))
+    if(filePath == NULL)
     {
-        fclose(fp);
-        return BITMAPWAG_IMAGE_NOT_WRITTEN;
+        return BITMAPWAG_FILE_PATH_NULL;
     }
-    
-    //close the file
-    fclose(fp);
 
-    // Return successful 
-    return BITMAPWAG_SUCCESS;
+    return BeginStreamBitmapWag(stream, filePath, NULL, height, width, 
+        bitsPerPixel, palette, numColors);
 }
 
-BitmapWagError InitializeBitmapWag(BitmapWagImg * bm, const uint32_t height, 
-    const uint32_t width, const uint16_t bitsPerPixel)
+BitmapWagError BeginBitmapWagStreamIo(BitmapWagStream ** stream, 
+    const BitmapWagIo * io, const uint32_t height, const uint32_t width, 
+    const uint16_t bitsPerPixel, const BitmapWagRgbQuad * palette, 
+    const uint32_t numColors)
 {
-    // Contains the size of the palette array 
-    size_t sizeOfPalette = 0; 
-    BitmapWagError retVal = BITMAPWAG_SUCCESS;
-
-    // Null check on bitmap pointer
-    if(bm == NULL)
+    if(stream == NULL)
     {
         return BITMAPWAG_NULL;
     }
 
-    // Check to make sure that the object hasn't already been initialized
-    if(bm->state == BITMAPWAG_STATE_NONE)
-    {
-        return BITMAPWAG_NOSTATE;
-    }
-    else if(bm->state == BITMAPWAG_STATE_INITIALIZED)
+    *stream = NULL;
+
+    if(io == NULL || io->write == NULL)
     {
-        return BITMAPWAG_ALREADY_INIT;
+        return BITMAPWAG_IO_NULL;
     }
 
-    bm->colorUsed = NULL;
-
-    // Find the amount of memory that needs to be allocated for the image array
-    size_t rowMemory = GetRowMemory(width, bitsPerPixel);
-    
-    size_t bytesForImage = rowMemory * height;
+    return BeginStreamBitmapWag(stream, NULL, io, height, width, 
+        bitsPerPixel, palette, numColors);
+}
 
-    // Allocate the memory for the image
-    bm->aBitmapBits = (uint8_t *) malloc(bytesForImage);
+uint32_t GetBitmapWagStreamRowMemory(const BitmapWagStream * stream)
+{
+    // Null check on stream pointer
+    if(stream == NULL)
+    {   
+        return 0;
+    }
+    else
+    {
+        return stream->rowMemory;
+    }
+}
 
-    if(bm->aBitmapBits == NULL)
+BitmapWagError PushBitmapWagRows(BitmapWagStream * stream, 
+    const uint8_t * rows, const uint32_t numRows)
+{
+    if(stream == NULL)
     {
-        return BITMAPWAG_ALLOCATE_BITMAP_BITS_FAILED;
+        return BITMAPWAG_NULL;
     }
 
-    // Indicate that the bitmap has been initialized 
-    bm->state = BITMAPWAG_STATE_INITIALIZED;
+    if(rows == NULL)
+    {
+        return BITMAPWAG_BITMAPBITS_NULL;
+    }
 
-    // Make the entire color array point to the zeroth color palette index or 
-    // make it colored black 
-    for(size_t i = 0; i < bytesForImage; i++)
+    if(stream->error)
     {
-        (bm->aBitmapBits)[i] = 0x00;
+        return stream->error;
     }
 
-    // Allocate memory for the color palette if one is needed 
-    // And allocate memory for the colorsUsed array if one is needed
-    if(bitsPerPixel <= 8)
+    if(numRows > stream->img.bmih.biHeight - stream->rowsPushed)
     {
-        // Calculate number of colors based on biBitCount
-        size_t numColors = 1 << bitsPerPixel;
-        size_t sizeOfColorUsed = numColors * sizeof(uint8_t);
-        sizeOfPalette = numColors * sizeof(BitmapWagRgbQuad);
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
 
-        bm->aColors = (BitmapWagRgbQuad *) malloc(sizeOfPalette);
+    size_t bytesLeft = stream->rowMemory * numRows;
+    stream->rowsPushed += numRows;
 
-        if(bm->aColors == NULL)
+    // Large pushes go straight to the file rather than through the buffer
+    if(stream->bufferUsed == 0 && bytesLeft >= stream->bufferSize)
+    {
+        size_t itemsWritten = WriteIoBitmapWag(&(stream->io), rows, 
+            bytesLeft);
+
+        if(itemsWritten != 1)
         {
-            return BITMAPWAG_ALLOCATE_PALETTE_FAILED;
+            stream->error = BITMAPWAG_IMAGE_NOT_WRITTEN;
         }
+        return stream->error;
+    }
 
-        bm->bmih.biClrUsed = numColors;
-
-        // Make the entire color palette black
-        for(size_t i = 0; i < numColors; i++)
+    while(bytesLeft > 0)
+    {
+        size_t bytesToCopy = stream->bufferSize - stream->bufferUsed;
+        if(bytesToCopy > bytesLeft)
         {
-            (bm->aColors)[i] = (BitmapWagRgbQuad){0x00, 0x00, 0x00, 0};
+            bytesToCopy = bytesLeft;
         }
 
-        // Allocate the space for the colorUsed record
-        bm->colorUsed = (uint8_t *) malloc(sizeOfColorUsed);
+        memcpy(&(stream->buffer)[stream->bufferUsed], rows, bytesToCopy);
+        stream->bufferUsed += bytesToCopy;
+        rows += bytesToCopy;
+        bytesLeft -= bytesToCopy;
 
-        // if colorUsed failed to allocate, it's not an error, and there are 
-        // fallbacks but it will really  slow down the performance of the 
-        // library so the application should be notified 
-        if(bm->colorUsed == NULL)
-        {
-            retVal = BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE;
-        }
-        else
+        if(stream->bufferUsed == stream->bufferSize)
         {
-            // Initialize all values in colorUsed to be all zeros
-            for(size_t i = 0; i < numColors; i++)
+            if(FlushBitmapWagStream(stream))
             {
-                (bm->colorUsed)[i] = 0;
+                return stream->error;
             }
         }
     }
-    else
+
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError PushBitmapWagRowColors(BitmapWagStream * stream, 
+    const BitmapWagRgbQuad * colors)
+{
+    if(stream == NULL)
     {
-        bm->bmih.biClrUsed = 0;
-        bm->aColors = NULL;
-        bm->colorUsed = NULL;
+        return BITMAPWAG_NULL;
     }
 
-    // Now that everything has been allocated, start initializing all the 
-    // member variables
-    
-    // Set bmfh
-    ((char *)&(bm->bmfh.bfType))[0] = 'B';
-    ((char *)&(bm->bmfh.bfType))[1] = 'M';
+    if(colors == NULL)
+    {
+        return BITMAPWAG_COLOR_PTR_NULL;
+    }
 
-    bm->bmfh.bfSize = sizeof(bm->bmih) + sizeof(bm->bmfh) + sizeOfPalette 
-        + bytesForImage;
+    if(stream->error)
+    {
+        return stream->error;
+    }
 
-    bm->bmfh.bfReserved1 = 0;
-    bm->bmfh.bfReserved2 = 0;
-    bm->bmfh.bfOffBits = sizeof(bm->bmfh) + sizeof(bm->bmih) + sizeOfPalette;
+    if(stream->rowsPushed >= stream->img.bmih.biHeight)
+    {
+        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+    }
 
-    // Set bmih
-    bm->bmih.biSize = sizeof(bm->bmih);
-    bm->bmih.biWidth = width;
-    bm->bmih.biHeight = height;
-    bm->bmih.biPlanes = 1;
+    // Make room for the row in the buffer
+    if(stream->bufferUsed == stream->bufferSize)
+    {
+        if(FlushBitmapWagStream(stream))
+        {
+            return stream->error;
+        }
+    }
 
-    bm->bmih.biBitCount = bitsPerPixel;
-    bm->bmih.biCompression = 0;
-    bm->bmih.biSizeImage = 0;
-    // 72 DPI
-    bm->bmih.biXPelsPerMeter = 28346;
-    bm->bmih.biYPelsPerMeter = 28346;
+    uint8_t * row = &(stream->buffer)[stream->bufferUsed];
 
-    bm->bmih.biClrImportant = 0;
+    // Zero the row so the padding at the end of it is written as zeros
+    memset(row, 0, stream->rowMemory);
 
-    return retVal;
+    BitmapWagError error = EncodeSpanBitmapWag(&(stream->img), row, 0, colors, 
+        stream->img.bmih.biWidth);
+
+    if(error)
+    {
+        return error;
+    }
+
+    stream->bufferUsed += stream->rowMemory;
+    stream->rowsPushed++;
+
+    return BITMAPWAG_SUCCESS;
 }
 
-BitmapWagError FreeBitmapWag(BitmapWagImg * bm)
+BitmapWagError EndBitmapWagStream(BitmapWagStream * stream)
 {
-    // Null check on bitmap pointer
-    if(bm == NULL)
+    BitmapWagError retVal;
+
+    if(stream == NULL)
     {
         return BITMAPWAG_NULL;
     }
-    
-    if(bm->state == BITMAPWAG_STATE_INITIALIZED)
-    {
-        if(bm->aBitmapBits != NULL)
-        {
-            free(bm->aBitmapBits);
-            bm->aBitmapBits = NULL;
-        }
 
-        if(bm->aColors != NULL)
-        {
-            free(bm->aColors);
-            bm->aColors = NULL;
-        }
+    retVal = FlushBitmapWagStream(stream);
 
-        if(bm->colorUsed != NULL)
-        {
-            free(bm->colorUsed);
-            bm->colorUsed = NULL;
-        }
-    }
-    
-    if(bm->state == BITMAPWAG_STATE_INITIALIZED || 
-       bm->state == BITMAPWAG_STATE_CONSTRUCTED)
+    if(stream->fp != NULL && fclose(stream->fp) != 0 
+        && retVal == BITMAPWAG_SUCCESS)
     {
-        free(bm);
-        bm = NULL;
+        retVal = BITMAPWAG_IMAGE_NOT_WRITTEN;
     }
-    else
+
+    if(retVal == BITMAPWAG_SUCCESS 
+        && stream->rowsPushed != stream->img.bmih.biHeight)
     {
-        return BITMAPWAG_NOSTATE;
+        retVal = BITMAPWAG_STREAM_INCOMPLETE;
     }
 
-    return BITMAPWAG_SUCCESS; 
+    free(stream->buffer);
+    free(stream->img.aColors);
+    free(stream->img.colorUsed);
+    free(stream);
+
+    return retVal;
 }
 
-uint32_t GetBitmapWagHeight(const BitmapWagImg * bm)
+// Struct containing the state of a bitmap being read from a file row by row
+struct BitmapWagReader {
+    // img holds the headers and color palette of the image being read, it 
+    // has no image bits 
+    BitmapWagImg img;
+    // io the image is being read from
+    BitmapWagIo io;
+    // file opened by the reader, NULL when reading from a caller's BitmapWagIo
+    FILE * fp;
+    // buffer holds the batch of rows most recently read from the file
+    uint8_t * buffer;
+    // rowsPerBatch is the number of rows buffer can hold
+    uint32_t rowsPerBatch;
+    // rowsInBuffer is the number of rows currently in buffer
+    uint32_t rowsInBuffer;
+    // nextRow is the index in buffer of the next row to hand out
+    uint32_t nextRow;
+    // rowsRead is the number of rows read from the file so far
+    uint32_t rowsRead;
+    // rowMemory is the size of one row of the image in bytes
+    size_t rowMemory;
+}; 
+
+/**
+ * FillBitmapWagReader reads the next batch of rows into the reader buffer if 
+ * every row in the buffer has been handed out
+ * This is used internally by the libBitmapWag library. 
+ *
+ * @param reader pointer to a bitmap reader
+ * @return BITMAPWAG_SUCCESS if there are rows in the buffer to hand out
+ */
+static BitmapWagError FillBitmapWagReader(BitmapWagReader * reader)
 {
-    // Null check on bitmap pointer
-    if(bm == NULL)
-    {   
-        return 0;
+    if(reader->nextRow < reader->rowsInBuffer)
+    {
+        return BITMAPWAG_SUCCESS;
     }
-    else
+
+    uint32_t rowsLeft = reader->img.bmih.biHeight - reader->rowsRead;
+
+    if(rowsLeft == 0)
     {
-        return bm->bmih.biHeight;
+        return BITMAPWAG_END_OF_IMAGE;
     }
-}
 
-uint32_t GetBitmapWagWidth(const BitmapWagImg * bm)
-{
-    // Null check on bitmap pointer
-    if(bm == NULL)
-    {   
-        return 0;
+    if(rowsLeft > reader->rowsPerBatch)
+    {
+        rowsLeft = reader->rowsPerBatch;
     }
-    else
+
+    reader->nextRow = 0;
+    reader->rowsInBuffer = 0;
+
+    size_t itemsRead = ReadIoBitmapWag(&(reader->io), reader->buffer, 
+        reader->rowMemory * rowsLeft);
+
+    if(itemsRead != 1)
     {
-        return bm->bmih.biWidth;
+        return BITMAPWAG_BITMAPBITS_NOT_READ;
     }
+
+    reader->rowsInBuffer = rowsLeft;
+    reader->rowsRead += rowsLeft;
+
+    return BITMAPWAG_SUCCESS;
 }
 
 /**
- * compares color a to color b for equivalence
+ * OpenReaderBitmapWag opens a reader on either a file or a BitmapWagIo
+ * This is used internally by the libBitmapWag library. 
  *
- * @param a first color to compare
- * @param b second color to compare
- * @return 0 if identical
+ * @param reader pointer to the reader pointer to populate
+ * @param filePath path of the file to read, NULL to read from io
+ * @param io BitmapWagIo to read from when filePath is NULL
+ * @param rowsPerBatch number of rows read at a time, zero for the default
+ * @return BITMAPWAG_SUCCESS if successful
  */
-static uint32_t CompareColors(const BitmapWagRgbQuad a, 
-    const BitmapWagRgbQuad b)
+static BitmapWagError OpenReaderBitmapWag(BitmapWagReader ** reader, 
+    const char * filePath, const BitmapWagIo * io, 
+    const uint32_t rowsPerBatch)
 {
-    return (a.rgbBlue == b.rgbBlue) && (a.rgbGreen == b.rgbGreen) 
-        && (a.rgbRed == b.rgbRed) && (a.rgbReserved == b.rgbReserved);
-}
+    BitmapWagError retVal;
 
-BitmapWagError SetBitmapWagPixel(BitmapWagImg * bm, const uint32_t x, 
-    const uint32_t y, const uint8_t r, const uint8_t g, const uint8_t b)
-{
-    // colorUsedInt keeps track of which indicies in a color palette are in use
-    // Use a stack allocated array because it's relatively small and it's 
-    // much faster than dynamic allocations 
-    uint8_t colorUsedInt [256] = {0};
-    uint16_t possibleColors;
+    *reader = NULL;
 
-    // Null check on bitmap pointer
-    if(bm == NULL)
+    BitmapWagReader * output = (BitmapWagReader *) 
+        AllocBitmapWag(sizeof(BitmapWagReader));
+
+    if(output == NULL)
     {
-        return BITMAPWAG_NULL;
+        return BITMAPWAG_ALLOCATE_STREAM_FAILED;
     }
 
-    // Check to make sure that the object has already been initialized
-    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    *output = (BitmapWagReader){0};
+    output->img.allocator = defaultAllocator;
+    output->img.state = BITMAPWAG_STATE_CONSTRUCTED;
+
+    if(filePath != NULL)
     {
-        return BITMAPWAG_NOT_INIT;
-    }
+        // open filePath as binary file for reading 
+        output->fp = fopen(filePath, "rb");
 
-    // Check to on the bitmap bits pointer
-    if(bm->aBitmapBits == NULL)
+        if(output->fp == NULL)
+        {
+            free(output);
+            return BITMAPWAG_CANNOT_OPEN_FILE;
+        }
+
+        SetFileIoBitmapWag(&(output->io), output->fp);
+    }
+    else
     {
-        return BITMAPWAG_BITMAPBITS_NULL;
+        output->io = *io;
     }
 
-    const size_t bitsPerPixel = bm->bmih.biBitCount;
-    const uint32_t width = bm->bmih.biWidth;
-    const uint32_t height = bm->bmih.biHeight;
+    // Read the headers and the color palette, leaving the file at the first 
+    // row of the image
+    retVal = ReadHeadersBitmapWag(&(output->img), &(output->io), 0);
 
-    if(x >= width)
+    if(retVal == BITMAPWAG_SUCCESS 
+        && output->img.bmih.biCompression != BITMAPWAG_BI_RGB 
+        && output->img.bmih.biCompression != BITMAPWAG_BI_BITFIELDS)
     {
-        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+        retVal = BITMAPWAG_COMPRESSION_NOT_SUPPORTED;
     }
 
-    if(y >= height)
+    if(retVal)
     {
-        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+        CloseBitmapWagReader(output);
+        return retVal;
     }
 
-    // Find the amount of memory that needs to be allocated for the image array
-    const size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+    output->rowMemory = GetRowMemory(output->img.bmih.biWidth, 
+        output->img.bmih.biBitCount);
 
-    // If a color palette is being used 
-    if(bm->bmih.biBitCount <= 8)
+    // By default hold as many whole rows as fit in the stream buffer size
+    output->rowsPerBatch = rowsPerBatch;
+    if(output->rowsPerBatch == 0)
     {
-        BitmapWagRgbQuad color = {b, g, r, 0};
-        uint8_t colorNotFound = 1;
-        uint8_t indexOfColor; 
-
-        if(bm->aColors == NULL)
+        output->rowsPerBatch = 1;
+        if(output->rowMemory > 0 
+            && output->rowMemory < BITMAPWAG_STREAM_BUFFER_SIZE)
         {
-            return BITMAPWAG_COLOR_PALETTE_NULL;
+            output->rowsPerBatch = BITMAPWAG_STREAM_BUFFER_SIZE 
+                / output->rowMemory;
         }
+    }
 
-        // Get the value at the byte
-        uint8_t value = (bm->aBitmapBits)
-            [y*rowMemory + (x >> (4 - ceilLog2b16_t(bitsPerPixel)))];
-
-        if(bm->bmih.biClrUsed > 0)
-        {
-            possibleColors = bm->bmih.biClrUsed;
-        }
-        else
-        {
-            possibleColors = 1 << bm->bmih.biBitCount;
-        }
+    output->buffer = (uint8_t *) AllocBitmapWag(output->rowMemory 
+        * output->rowsPerBatch);
 
-        // Populate the contents of the colorUsed array
+    if(output->buffer == NULL && output->rowMemory > 0)
+    {
+        CloseBitmapWagReader(output);
+        return BITMAPWAG_ALLOCATE_STREAM_FAILED;
+    }
 
-        uint8_t * colorUsedPtr;
-        if(bm->colorUsed == NULL)
-        {
-            colorUsedPtr = colorUsedInt;
-            SetColorUsedArrayBitmapWag(bm, colorUsedPtr);
-        }
-        else
-        {
-            colorUsedPtr = bm->colorUsed;
-        }
+    output->img.state = BITMAPWAG_STATE_INITIALIZED;
+    *reader = output;
 
-        // Find the index of the color specified in the input
-        for(uint16_t i = 0; i < possibleColors; i++)
-        { 
-            if(CompareColors((bm->aColors)[i], color) && colorUsedPtr[i])
-            {
-                // If the colors are the same and the color is being used
-                // then set the index
-                colorNotFound = 0;
-                indexOfColor = i;
-                break;
-            }
-        }
+    return BITMAPWAG_SUCCESS;
+}
 
-        // If the color is not yet in the palette, find a new place for it
-        if(colorNotFound)
-        {
-            // Ensure colorNotFound is 1 because now it will be used to indicate
-            // if there is no space left in the color palette 
-            colorNotFound = 1;
+BitmapWagError OpenBitmapWagReader(BitmapWagReader ** reader, 
+    const char * filePath, const uint32_t rowsPerBatch)
+{
+    if(reader == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
 
-            // Find the index of the color specified in the input
-            for(uint16_t i = 0; i < possibleColors; i++)
-            {
-                if(!colorUsedPtr[i])
-                {
-                    colorUsedPtr[i] = 1;
-                    colorNotFound = 0;
-                    (bm->aColors)[i] = color;
-                    indexOfColor = i;
-                    break;
-                }
-            }
+    *reader = NULL;
 
-            // If there was no space left in the palette 
-            if(colorNotFound)
-            {
-                return BITMAPWAG_PALETTE_NOT_WRITTEN;
-            }
-        }
+    if(filePath == NULL)
+    {
+        return BITMAPWAG_FILE_PATH_NULL;
+    }
 
-        // Amount to shift palette index by
-        uint8_t sftAmnt = (bitsPerPixel * 
-            ((~x) & (~(0xFFFFFFFF << (4 - ceilLog2b16_t(bitsPerPixel))))));
+    return OpenReaderBitmapWag(reader, filePath, NULL, rowsPerBatch);
+}
 
-        // Mask holds the right shifted bit mask
-        uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+BitmapWagError OpenBitmapWagReaderIo(BitmapWagReader ** reader, 
+    const BitmapWagIo * io, const uint32_t rowsPerBatch)
+{
+    if(reader == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
 
-        // First iteration sets the index of color to the correct bit width
-        uint8_t value2 = (indexOfColor & (0xFF >> (8 - bitsPerPixel)));
-        // Second iteration shifts palette index to the correct byte position
-        value2 = value2 << sftAmnt;
-        // Third iteration masks out value for value2 to be inserted in 
-        value = value & (~(mask << sftAmnt));
-        // Fourth iteration combines the values
-        value = value | value2;
+    *reader = NULL;
 
-        (bm->aBitmapBits)
-            [y*rowMemory + (x >> (4 - ceilLog2b16_t(bitsPerPixel)))] = value;
+    if(io == NULL || io->read == NULL)
+    {
+        return BITMAPWAG_IO_NULL;
     }
 
-    // biBitCount will either be 16 or 24 when a color palette is not being used
-    else if (bm->bmih.biBitCount == 16)
+    return OpenReaderBitmapWag(reader, NULL, io, rowsPerBatch);
+}
+
+uint32_t GetBitmapWagReaderWidth(const BitmapWagReader * reader)
+{
+    // Null check on reader pointer
+    if(reader == NULL)
+    {   
+        return 0;
+    }
+    else
     {
-        uint16_t * bitmap16 = (uint16_t *) bm->aBitmapBits;
+        return reader->img.bmih.biWidth;
+    }
+}
 
-        bitmap16[y*rowMemory/2 + x] = 0 | ((0x1F & b) << 10) 
-            | ((0x1F & g) << 5) | ((0x1F & r) << 0);
+uint32_t GetBitmapWagReaderHeight(const BitmapWagReader * reader)
+{
+    // Null check on reader pointer
+    if(reader == NULL)
+    {   
+        return 0;
     }
+    else
+    {
+        return reader->img.bmih.biHeight;
+    }
+}
 
-    else if(bm->bmih.biBitCount == 24)
+uint16_t GetBitmapWagReaderBitsPerPixel(const BitmapWagReader * reader)
+{
+    // Null check on reader pointer
+    if(reader == NULL)
+    {   
+        return 0;
+    }
+    else
     {
-        (bm->aBitmapBits)[y*rowMemory + 3*x] = b;
-        (bm->aBitmapBits)[y*rowMemory + 3*x + 1] = g;
-        (bm->aBitmapBits)[y*rowMemory + 3*x + 2] = r;
+        return reader->img.bmih.biBitCount;
     }
+}
 
-    else if(bm->bmih.biBitCount == 32)
+uint8_t GetBitmapWagReaderTopDown(const BitmapWagReader * reader)
+{
+    // Null check on reader pointer
+    if(reader == NULL)
+    {   
+        return 0;
+    }
+    else
     {
-        (bm->aBitmapBits)[y*rowMemory + 4*x] = b;
-        (bm->aBitmapBits)[y*rowMemory + 4*x + 1] = g;
-        (bm->aBitmapBits)[y*rowMemory + 4*x + 2] = r;
-        (bm->aBitmapBits)[y*rowMemory + 4*x + 3] = 0;
+        return reader->img.topDown;
     }
+}
 
+uint32_t GetBitmapWagReaderRowMemory(const BitmapWagReader * reader)
+{
+    // Null check on reader pointer
+    if(reader == NULL)
+    {   
+        return 0;
+    }
     else
     {
-        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+        return reader->rowMemory;
     }
-        
+}
+
+BitmapWagError GetBitmapWagReaderPalette(const BitmapWagReader * reader, 
+    const BitmapWagRgbQuad ** palette, uint32_t * numColors)
+{
+    if(reader == NULL || palette == NULL || numColors == NULL)
+    {
+        return BITMAPWAG_NULL;
+    }
+
+    if(reader->img.aColors == NULL)
+    {
+        *palette = NULL;
+        *numColors = 0;
+        return BITMAPWAG_NO_COLOR_PALETTE;
+    }
+
+    *palette = reader->img.aColors;
+    *numColors = GetPossibleColorsBitmapWag(&(reader->img));
 
     return BITMAPWAG_SUCCESS;
 }
 
-
-BitmapWagError GetBitmapWagPixel(const BitmapWagImg * bm, 
-    const uint32_t x, const uint32_t y, BitmapWagRgbQuad * color)
+BitmapWagError NextBitmapWagRows(BitmapWagReader * reader, 
+    const uint8_t ** rows, uint32_t * numRows)
 {
-    // Null check on bitmap pointer
-    if(bm == NULL)
+    if(reader == NULL || numRows == NULL)
     {
         return BITMAPWAG_NULL;
     }
 
-    if(color == NULL)
+    if(rows == NULL)
     {
-        return BITMAPWAG_COLOR_PALETTE_NULL;
+        return BITMAPWAG_BITMAPBITS_NULL;
     }
 
-    // Check to make sure that the object has already been initialized
-    if(bm->state != BITMAPWAG_STATE_INITIALIZED)
+    *numRows = 0;
+
+    BitmapWagError error = FillBitmapWagReader(reader);
+
+    if(error)
     {
-        return BITMAPWAG_NOT_INIT;
+        return error;
     }
 
-    const size_t bitsPerPixel = bm->bmih.biBitCount;
-    const uint32_t width = bm->bmih.biWidth;
-    const uint32_t height = bm->bmih.biHeight;
+    // Hand out every row left in the buffer
+    *rows = &(reader->buffer)[reader->nextRow * reader->rowMemory];
+    *numRows = reader->rowsInBuffer - reader->nextRow;
+    reader->nextRow = reader->rowsInBuffer;
 
-    if(x >= width)
+    return BITMAPWAG_SUCCESS;
+}
+
+BitmapWagError NextBitmapWagRow(BitmapWagReader * reader, 
+    const uint8_t ** row)
+{
+    if(reader == NULL)
     {
-        return BITMAPWAG_COORDINATE_WIDTH_OUT;
+        return BITMAPWAG_NULL;
     }
 
-    if(y >= height)
+    if(row == NULL)
     {
-        return BITMAPWAG_COORDINATE_HEIGHT_OUT;
+        return BITMAPWAG_BITMAPBITS_NULL;
     }
 
-    // Find the amount of memory that needs to be allocated for the image array
-    const size_t rowMemory = GetRowMemory(width, bitsPerPixel);
+    BitmapWagError error = FillBitmapWagReader(reader);
 
-    // If a color palette is being used 
-    if(bm->bmih.biBitCount <= 8)
+    if(error)
     {
-        if(bm->aColors == NULL)
-        {
-            return BITMAPWAG_COLOR_PALETTE_NULL;
-        }
-
-        // Get the value at the byte
-        uint8_t value = (bm->aBitmapBits)
-            [y*rowMemory + (x >> (4 - ceilLog2b16_t(bitsPerPixel)))];
-
-        // Amount to shift palette index by
-        uint8_t sftAmnt = (bitsPerPixel * 
-            ((~x) & (~(0xFFFFFFFF << (4 - ceilLog2b16_t(bitsPerPixel))))));
+        return error;
+    }
 
-        // Mask holds the right shifted bit masks
-        uint8_t mask = (0xFF >> (8 - bitsPerPixel));
+    *row = &(reader->buffer)[reader->nextRow * reader->rowMemory];
+    reader->nextRow++;
 
-        // Snipe out the bit(s) of the pixel that are used to look up a color 
-        // in the palette 
-        value = (value >> sftAmnt) & mask;
+    return BITMAPWAG_SUCCESS;
+}
 
-        color->rgbBlue = (bm->aColors)[value].rgbBlue;
-        color->rgbGreen = (bm->aColors)[value].rgbGreen;
-        color->rgbRed = (bm->aColors)[value].rgbRed;
-        color->rgbReserved = (bm->aColors)[value].rgbReserved;
-    }
+BitmapWagError NextBitmapWagRowColors(BitmapWagReader * reader, 
+    BitmapWagRgbQuad * colors)
+{
+    const uint8_t * row;
 
-    // biBitCount will either be 16 or 24 when a color palette is not being used
-    else if (bm->bmih.biBitCount == 16)
+    if(colors == NULL)
     {
-        uint16_t * bitmap16 = (uint16_t *) bm->aBitmapBits;
-
-        color->rgbBlue = (bitmap16[y*rowMemory/2 + x] >> 10) & 0x001F;
-        color->rgbGreen = (bitmap16[y*rowMemory/2 + x] >> 5) & 0x001F;
-        color->rgbRed = (bitmap16[y*rowMemory/2 + x] >> 0) & 0x001F;
-        color->rgbReserved = 0;
+        return BITMAPWAG_COLOR_PTR_NULL;
     }
 
-    else if(bm->bmih.biBitCount == 24)
+    BitmapWagError error = NextBitmapWagRow(reader, &row);
+
+    if(error)
     {
-        color->rgbBlue = (bm->aBitmapBits)[y*rowMemory + 3*x];
-        color->rgbGreen = (bm->aBitmapBits)[y*rowMemory + 3*x + 1];
-        color->rgbRed = (bm->aBitmapBits)[y*rowMemory + 3*x + 2];
-        color->rgbReserved = 0;
+        return error;
     }
-    else if(bm->bmih.biBitCount == 32)
+
+    return DecodeSpanBitmapWag(&(reader->img), row, 0, colors, 
+        reader->img.bmih.biWidth);
+}
+
+BitmapWagError CloseBitmapWagReader(BitmapWagReader * reader)
+{
+    if(reader == NULL)
     {
-        color->rgbBlue = (bm->aBitmapBits)[y*rowMemory + 4*x];
-        color->rgbGreen = (bm->aBitmapBits)[y*rowMemory + 4*x + 1];
-        color->rgbRed = (bm->aBitmapBits)[y*rowMemory + 4*x + 2];
-        color->rgbReserved = (bm->aBitmapBits)[y*rowMemory + 4*x + 3];
+        return BITMAPWAG_NULL;
     }
-    else
+
+    if(reader->fp != NULL)
     {
-        return BITMAPWAG_BIBITS_NOT_SUPPORTED;
+        fclose(reader->fp);
     }
-    
+
+    free(reader->buffer);
+    free(reader->img.colorsBuffer);
+    free(reader->img.colorUsedBuffer);
+    free(reader->img.bitfieldsBuffer);
+    free(reader);
+
     return BITMAPWAG_SUCCESS;
 }
-
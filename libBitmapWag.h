@@ -22,6 +22,7 @@ extern "C" {
 #endif
 
 #include <inttypes.h> 
+#include <stddef.h>
 
 // Errors that can come from bitmap operations
 typedef enum {
@@ -52,11 +53,169 @@ typedef enum {
     BITMAPWAG_NOTCONSTRUCTED,
     BITMAPWAG_ALREADY_INIT,
     BITMAPWAG_NOSTATE,
-    BITMAPWAG_NOT_INIT
+    BITMAPWAG_NOT_INIT,
+    BITMAPWAG_READ_ONLY,
+    BITMAPWAG_MAP_FAILED,
+    BITMAPWAG_MAP_NOT_SUPPORTED,
+    BITMAPWAG_ALLOCATE_STREAM_FAILED,
+    BITMAPWAG_STREAM_INCOMPLETE,
+    BITMAPWAG_END_OF_IMAGE,
+    BITMAPWAG_BUFFER_NULL,
+    BITMAPWAG_BUFFER_TOO_SMALL,
+    BITMAPWAG_ALLOCATE_BUFFER_FAILED,
+    BITMAPWAG_IO_NULL,
+    BITMAPWAG_CREATE_THREAD_FAILED,
+    BITMAPWAG_THREADS_NOT_SUPPORTED,
+    BITMAPWAG_COMPRESSION_NOT_SUPPORTED,
+    BITMAPWAG_WRITE_OPTIONS_NULL,
+    BITMAPWAG_MASKS_NOT_SUPPORTED,
+    BITMAPWAG_STATS_NOT_SUPPORTED,
+    BITMAPWAG_DITHER_NOT_SUPPORTED,
+    BITMAPWAG_ALLOCATOR_NULL,
+    BITMAPWAG_ALLOCATE_ARENA_FAILED,
+    BITMAPWAG_WRITE_PENDING,
+    BITMAPWAG_WRITE_QUEUE_FULL,
+    BITMAPWAG_INVALID_FILE,
+    BITMAPWAG_IMAGE_TOO_LARGE
 } BitmapWagError;
 
+// How ReadBitmapWagMapped maps the image bits of a file
+typedef enum {
+    // Pixels can be read but not set
+    BITMAPWAG_MAP_READ_ONLY = 0,
+    // Pixels can be set, changed pages are copied and never reach the file
+    BITMAPWAG_MAP_COPY_ON_WRITE
+} BitmapWagMapMode;
+
+// Compression applied to the image bits when a bitmap is written
+typedef enum {
+    // Image bits are written uncompressed
+    BITMAPWAG_COMPRESSION_NONE = 0,
+    // Run length encoding, BI_RLE8 for 8 bit and BI_RLE4 for 4 bit images
+    BITMAPWAG_COMPRESSION_RLE
+} BitmapWagCompression;
+
+// Options applied every time a bitmap is written
+typedef struct {
+    BitmapWagCompression compression;
+} BitmapWagWriteOptions;
+
+// Handle of a write queued by WriteBitmapWagAsync
+typedef struct BitmapWagWrite BitmapWagWrite;
+
+// Called on the I/O thread once an asynchronous write has finished, with the
+// path written and the error WriteBitmapWag would have returned
+typedef void (*BitmapWagWriteCallback)(void * user, const char * filePath, 
+    BitmapWagError error);
+
+// Options of WriteBitmapWagAsync
+typedef struct {
+    // Nonzero hands the image to the I/O thread, which writes it and frees it 
+    // with FreeBitmapWag. Zero encodes a copy of the bitmap file on the 
+    // calling thread and leaves the image with the caller. 
+    uint8_t takeOwnership;
+    // Nonzero returns BITMAPWAG_WRITE_QUEUE_FULL instead of waiting for room 
+    // when the queue is full
+    uint8_t noWait;
+    // May be NULL
+    BitmapWagWriteCallback callback;
+    // Passed to callback
+    void * user;
+} BitmapWagAsyncOptions;
+
+// Dithering QuantizeBitmapWag applies to hide the steps between the colors 
+// of the palette it builds
+typedef enum {
+    // Every pixel gets the nearest palette color
+    BITMAPWAG_DITHER_NONE = 0,
+    // A 4x4 Bayer matrix offsets pixels before the nearest color is found, 
+    // rows are independent so the work is split over threads
+    BITMAPWAG_DITHER_ORDERED,
+    // The error of each pixel is spread to its neighbours, the best looking 
+    // and slowest, always runs on the calling thread
+    BITMAPWAG_DITHER_FLOYD_STEINBERG
+} BitmapWagDither;
+
+// Options of QuantizeBitmapWag
+typedef struct {
+    // Most colors in the palette built, 0 for 2^bitsPerPixel
+    uint16_t maxColors;
+    BitmapWagDither dither;
+} BitmapWagQuantizeOptions;
+
+// Library wide performance counters, see GetBitmapWagStats
+typedef struct {
+    // pixels passed to SetBitmapWagPixel, SetBitmapWagSpan and SetBitmapWagRow
+    uint64_t pixelsSet;
+    // pixels passed to GetBitmapWagPixel and GetBitmapWagSpan
+    uint64_t pixelsGot;
+    // colors looked up in a color palette, by any function setting pixels 
+    uint64_t paletteLookups;
+    // palette hash table slots or palette entries compared by those lookups,
+    // lookups answered by the last color looked up compare none
+    uint64_t paletteProbes;
+    // colors added to a color palette
+    uint64_t paletteInsertions;
+    // scans of a whole palette image to find the palette entries in use
+    uint64_t colorUsedRebuilds;
+    // rebuilds done for a single palette lookup because the colorUsed array 
+    // could not be allocated (BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE) 
+    uint64_t colorUsedFallbacks;
+    // bytes read and written through files, memory and BitmapWagIo, the image
+    // bits of ReadBitmapWagMapped are mapped rather than read
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+    // nanoseconds spent reading and writing whole images 
+    uint64_t readNs;
+    uint64_t writeNs;
+    // memory allocations made by the library and nanoseconds spent in them
+    uint64_t allocations;
+    uint64_t allocNs;
+} BitmapWagStats;
+
 typedef struct BitmapWagImg BitmapWagImg;
 
+// Functions an image's struct, image bits, color palette and other buffers 
+// are allocated and freed with. Every function is passed the user member as 
+// its first argument. 
+typedef struct {
+    // alloc returns size bytes aligned to align, a power of two, or NULL if 
+    // they could not be allocated
+    void * (*alloc)(void * user, size_t size, size_t align);
+    // free releases memory returned by alloc. May be NULL when memory is 
+    // released some other way, such as by an arena. 
+    void (*free)(void * user, void * memory);
+    void * user;
+} BitmapWagAllocator;
+
+// Bump arena, images allocated with its allocator are released all at once
+typedef struct BitmapWagArena BitmapWagArena;
+
+// Functions the library calls to read and write bitmap data, so bitmaps can
+// be read from and written to sockets, pipes or any other kind of stream. 
+// Every function is passed the user member as its first argument. 
+typedef struct {
+    // read reads up to size bytes into data and returns the number of bytes 
+    // read, zero at the end of the data or on error. Needed for reading. 
+    size_t (*read)(void * user, void * data, size_t size);
+    // write writes up to size bytes from data and returns the number of bytes
+    // written, zero on error. Needed for writing. 
+    size_t (*write)(void * user, const void * data, size_t size);
+    // seek moves like fseek with whence SEEK_SET, SEEK_CUR or SEEK_END and 
+    // returns zero if successful. May be NULL, bytes are read and thrown 
+    // away to skip ahead instead. 
+    int (*seek)(void * user, int64_t offset, int whence);
+    // tell returns the current offset like ftell, -1 if it isn't known. May 
+    // be NULL. 
+    int64_t (*tell)(void * user);
+    // user is passed to every function, such as a file or socket handle
+    void * user;
+} BitmapWagIo;
+
+typedef struct BitmapWagStream BitmapWagStream;
+
+typedef struct BitmapWagReader BitmapWagReader;
+
 // Red Green Blue quad struct
 // Does not need to be packed because members are all of the same type
 typedef struct {
@@ -70,6 +229,79 @@ typedef struct {
     uint8_t rgbReserved; 
 } BitmapWagRgbQuad; 
 
+// Image bits of a bitmap as they are stored, see GetBitmapWagView 
+typedef struct {
+    // bits is the first byte of the image bits, the first row stored 
+    uint8_t * bits;
+    // stride is the number of bytes from the start of one row stored to the 
+    // next, the 4 byte padded size of a row unless the image was made with 
+    // InitializeBitmapWagExternal
+    size_t stride;
+    uint32_t width;
+    uint32_t height;
+    uint16_t bitsPerPixel;
+    // topDown is non-zero if the top row is stored first, zero if the bottom
+    // row is
+    uint8_t topDown;
+    // readOnly is non-zero if bits must not be written, as for an image 
+    // mapped with BITMAPWAG_MAP_READ_ONLY
+    uint8_t readOnly;
+    // palette the pixels of 1, 2, 4 and 8 bit images index, NULL otherwise
+    const BitmapWagRgbQuad * palette;
+    // numColors is the number of entries in palette
+    uint32_t numColors;
+    // masks of the red, green, blue and alpha channels of 16, 24 and 32 bit
+    // pixels read as little-endian integers, in that order, zero for images
+    // with a palette and for channels the image does not have
+    uint32_t masks[4];
+} BitmapWagView;
+
+// Dimensions and layout of a bitmap file, see ReadBitmapWagInfo
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    uint16_t bitsPerPixel;
+    // topDown is non-zero if the top row is stored first, the file has a 
+    // negative biHeight
+    uint8_t topDown;
+    // compression the image bits are stored with
+    BitmapWagCompression compression;
+    // masks of the red, green, blue and alpha channels of BI_BITFIELDS 
+    // images, in that order, zero for other images
+    uint32_t masks[4];
+    // numColors is the number of palette entries, zero for images over 8 bits
+    // per pixel
+    uint32_t numColors;
+    // offset of the image bits from the start of the file in bytes
+    uint32_t offset;
+    // imageSize is the size of the image bits in the file in bytes, 64 bits 
+    // as a whole image at 32 bits per pixel may take more than 4 GiB
+    uint64_t imageSize;
+} BitmapWagInfo;
+
+// Called to release the pixels an image took ownership of, see 
+// InitializeBitmapWagExternal
+typedef void (*BitmapWagFreePixels)(void * user, void * pixels);
+
+// Options of InitializeBitmapWagExternal
+typedef struct {
+    // Nonzero hands the pixels to the image, which releases them with 
+    // freePixels when it is freed, reset or reinitialized. Zero leaves them 
+    // with the caller, who keeps them alive until then. 
+    uint8_t takeOwnership;
+    // Nonzero if the top row of the image is the first row in pixels
+    uint8_t topDown;
+    // Releases the pixels of an image that owns them, NULL to use free(). 
+    // Called on the I/O thread for images handed to WriteBitmapWagAsync. 
+    BitmapWagFreePixels freePixels;
+    // Passed to freePixels
+    void * user;
+    // numColors colors the pixels of 1, 2, 4 and 8 bit images index, copied
+    // into the palette of the image. NULL leaves every palette entry black.
+    const BitmapWagRgbQuad * palette;
+    uint32_t numColors;
+} BitmapWagExternalOptions;
+
 /**
  *  MajorVersionBitmapWag returns the major version number of the library
  *  This library uses symantic version numbering
@@ -98,12 +330,129 @@ const unsigned int PatchVersionBitmapWag(void);
  */ 
 const char * ErrorsToStringBitmapWag(const BitmapWagError error);
 
+/**
+ * SetBitmapWagAllocator sets the allocator of the images made by 
+ * ConstructBitmapWag from now on, images already constructed keep theirs. 
+ * Work buffers used within a single call are still allocated with malloc. 
+ *
+ * @param allocator allocator to copy, NULL to go back to malloc and free
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_ALLOCATOR_NULL if the 
+ *         alloc function is NULL
+ * @note Shall not be called while other threads are constructing images. 
+ */
+BitmapWagError SetBitmapWagAllocator(const BitmapWagAllocator * allocator);
+
+/**
+ * CreateBitmapWagArena creates a bump arena. Allocating from it is a pointer
+ * increment, and its memory is only given back by ResetBitmapWagArena or 
+ * DestroyBitmapWagArena, so batches of short lived images cost a handful of 
+ * mallocs. An arena is not thread safe, use one per thread. 
+ *
+ * @param arena pointer to populate with the new arena
+ * @param blockSize bytes the arena gets from malloc at a time, 0 for 1 MiB
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError CreateBitmapWagArena(BitmapWagArena ** arena, 
+    const size_t blockSize);
+
+/**
+ * GetBitmapWagArenaAllocator gets an allocator that allocates from an arena,
+ * for ConstructBitmapWagWithAllocator or SetBitmapWagAllocator
+ *
+ * @param arena pointer to an arena
+ * @param allocator pointer to populate with the allocator
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError GetBitmapWagArenaAllocator(BitmapWagArena * arena, 
+    BitmapWagAllocator * allocator);
+
+/**
+ * ResetBitmapWagArena releases everything allocated from an arena at once, 
+ * keeping its memory to be handed out again. 
+ *
+ * @param arena pointer to an arena
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Every image allocated from the arena shall no longer be used, 
+ *       FreeBitmapWag doesn't need to be called on them unless they were 
+ *       read with ReadBitmapWagMapped or own pixels given to 
+ *       InitializeBitmapWagExternal with takeOwnership. The arena doesn't 
+ *       know about either, only FreeBitmapWag unmaps the file or calls 
+ *       freePixels, so call it on those images before resetting the arena 
+ *       or they leak. Pixels left with the caller are never touched. 
+ */
+BitmapWagError ResetBitmapWagArena(BitmapWagArena * arena);
+
+/**
+ * DestroyBitmapWagArena releases everything allocated from an arena and 
+ * frees the arena
+ *
+ * @param arena pointer to an arena
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Images that are mapped or own their pixels shall be freed with 
+ *       FreeBitmapWag first, as for ResetBitmapWagArena. 
+ */
+BitmapWagError DestroyBitmapWagArena(BitmapWagArena * arena);
+
+/**
+ * SetBitmapWagThreads sets the number of threads whole image operations are 
+ * split over: InitializeBitmapWag, ConvertBitmapWag, FillBitmapWagRect, 
+ * QuantizeBitmapWag without Floyd-Steinberg dithering and the palette scan 
+ * done when reading palette images. The threads are started once and reused 
+ * by every call. Small images always run on the calling thread. 
+ *
+ * @param numThreads total number of threads including the calling thread, 1 
+ *        runs everything on the calling thread (the default) and 0 uses one 
+ *        thread per online processor
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Only supported on POSIX systems built without BITMAPWAG_NO_THREADS, 
+ *       BITMAPWAG_THREADS_NOT_SUPPORTED is returned for any number other 
+ *       than 1 otherwise. 
+ */
+BitmapWagError SetBitmapWagThreads(const uint32_t numThreads);
+
+/**
+ * @return the total number of threads whole image operations are split over
+ */
+uint32_t GetBitmapWagThreads(void);
+
+/**
+ * GetBitmapWagStats gets the performance counters of the library, summed 
+ * over every image and thread since the library was loaded or the counters 
+ * were last reset. 
+ *
+ * @param stats pointer to populate with the counters
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note The counters are only kept when the library is built with 
+ *       -DBITMAPWAG_STATS, BITMAPWAG_STATS_NOT_SUPPORTED is returned and 
+ *       every counter is zero otherwise. 
+ */
+BitmapWagError GetBitmapWagStats(BitmapWagStats * stats);
+
+/**
+ * ResetBitmapWagStats sets every performance counter of the library to zero
+ *
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_STATS_NOT_SUPPORTED if 
+ *         the library was built without -DBITMAPWAG_STATS
+ */
+BitmapWagError ResetBitmapWagStats(void);
+
 /**
  * @return an allocated pointer to a BitmapWagImg object. 
  * @note Shall be called before any other function in this library. 
  */
 BitmapWagImg * ConstructBitmapWag(void);
 
+/**
+ * ConstructBitmapWagWithAllocator constructs a bitmap whose struct, image 
+ * bits, color palette and other buffers are allocated with an allocator
+ * 
+ * @param allocator allocator to copy into the bitmap
+ * @return an allocated pointer to a BitmapWagImg object, NULL if allocator 
+ *         or its alloc function is NULL or the struct could not be allocated
+ */
+BitmapWagImg * ConstructBitmapWagWithAllocator(
+    const BitmapWagAllocator * allocator);
+
 /**
  * ReadBitmapWag reads a bitmap image file
  *
@@ -112,9 +461,114 @@ BitmapWagImg * ConstructBitmapWag(void);
  * @return BITMAPWAG_SUCCESS if successful  
  * @note Shall be called after ConstructBitmapWag(). 
  * @note If called after InitializeBitmapWag, memory leaks will occur. 
+ * @note Top-down files, with a negative biHeight, keep their row order, see
+ *       GetBitmapWagTopDown. 
+ * @note The image bits are read from bfOffBits, skipping any gap after the 
+ *       palette. Files whose bfOffBits points into the headers or the 
+ *       palette fail with BITMAPWAG_INVALID_FILE. 
+ * @note Files whose rows don't fit in 4 GiB, or whose image bits don't fit 
+ *       in memory, fail with BITMAPWAG_IMAGE_TOO_LARGE. 
  */
 BitmapWagError ReadBitmapWag(BitmapWagImg * bm, const char * filePath);
 
+/**
+ * ReadBitmapWagInto reads a bitmap image file into a bitmap that may already 
+ * hold an image, reusing its buffers when they are large enough. Reading 
+ * frames of the same size over and over allocates nothing after the first. 
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param filePath path to read a file from, relative or absolute.
+ * @return BITMAPWAG_SUCCESS if successful  
+ * @note Same as ResetBitmapWag followed by ReadBitmapWag. 
+ */
+BitmapWagError ReadBitmapWagInto(BitmapWagImg * bm, const char * filePath);
+
+/**
+ * ReadBitmapWagInfo reads the headers of a bitmap file without reading its 
+ * palette or image bits, no memory is allocated for them
+ *
+ * @param filePath path to read a file from, relative or absolute.
+ * @param info pointer to populate with the dimensions and layout of the file
+ * @return BITMAPWAG_SUCCESS if ReadBitmapWag would accept the headers
+ */
+BitmapWagError ReadBitmapWagInfo(const char * filePath, BitmapWagInfo * info);
+
+/**
+ * ReadBitmapWagInfoIo reads the headers of a bitmap file through caller 
+ * provided I/O functions, see ReadBitmapWagInfo
+ *
+ * @param io I/O functions to read the bitmap file with, read is required
+ * @param info pointer to populate with the dimensions and layout of the file
+ * @return BITMAPWAG_SUCCESS if ReadBitmapWag would accept the headers
+ * @note io is left at the color palette
+ */
+BitmapWagError ReadBitmapWagInfoIo(const BitmapWagIo * io, 
+    BitmapWagInfo * info);
+
+/**
+ * ReadBitmapWagRegion reads a rectangle of a bitmap file as an image of its 
+ * own, reading only the bytes of each row that the rectangle covers
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param filePath path to read a file from, relative or absolute.
+ * @param x left edge of the rectangle (from left)
+ * @param y bottom edge of the rectangle (from bottom)
+ * @param w width of the rectangle
+ * @param h height of the rectangle
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_COORDINATE_WIDTH_OUT or
+ *         BITMAPWAG_COORDINATE_HEIGHT_OUT if the rectangle doesn't fit in 
+ *         the image
+ * @note Shall be called after ConstructBitmapWag(). The image is w by h 
+ *       pixels, pixel (x, y) of the file is its pixel (0, 0), and it keeps 
+ *       the palette, channel masks and row order of the file. 
+ * @note Run length encoded files are decoded whole to find the rectangle, 
+ *       in memory from the allocator of bm that is freed before returning. 
+ */
+BitmapWagError ReadBitmapWagRegion(BitmapWagImg * bm, const char * filePath,
+    const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h);
+
+/**
+ * ReadBitmapWagIo reads a bitmap image through caller provided I/O functions
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param io I/O functions to read the bitmap file with, read is required
+ * @return BITMAPWAG_SUCCESS if successful  
+ * @note Shall be called after ConstructBitmapWag(). 
+ */
+BitmapWagError ReadBitmapWagIo(BitmapWagImg * bm, const BitmapWagIo * io);
+
+/**
+ * ReadBitmapWagFromMemory reads a bitmap image from a buffer holding the 
+ * contents of a bitmap file
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param data buffer holding the bitmap file
+ * @param size size of data in bytes
+ * @return BITMAPWAG_SUCCESS if successful  
+ * @note Shall be called after ConstructBitmapWag(). 
+ */
+BitmapWagError ReadBitmapWagFromMemory(BitmapWagImg * bm, const void * data,
+    const size_t size);
+
+/**
+ * ReadBitmapWagMapped reads a bitmap image file by memory mapping it. The 
+ * image bits are not copied, pixels are read straight from the mapped file. 
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param filePath path to read a file from, relative or absolute.
+ * @param mode BITMAPWAG_MAP_READ_ONLY or BITMAPWAG_MAP_COPY_ON_WRITE
+ * @return BITMAPWAG_SUCCESS if successful  
+ * @note Shall be called after ConstructBitmapWag(). 
+ * @note Only supported on POSIX systems, BITMAPWAG_MAP_NOT_SUPPORTED is 
+ *       returned otherwise. 
+ * @note Changes made to a copy on write image are written out by 
+ *       WriteBitmapWag, the mapped file itself is never modified. 
+ * @note Files too short to hold every row the headers describe fail with 
+ *       BITMAPWAG_BITMAPBITS_NOT_READ. 
+ */
+BitmapWagError ReadBitmapWagMapped(BitmapWagImg * bm, const char * filePath,
+    const BitmapWagMapMode mode);
+
 /**
  * InitializeBitmapWag creates a bitmap file 
  *
@@ -129,6 +583,91 @@ BitmapWagError ReadBitmapWag(BitmapWagImg * bm, const char * filePath);
 BitmapWagError InitializeBitmapWag(BitmapWagImg * bm, const uint32_t height, 
     const uint32_t width, const uint16_t bitsPerPixel);
 
+/**
+ * InitializeBitmapWagTopDown creates a bitmap file whose rows are stored top 
+ * row first and written with a negative biHeight, so rows produced top to 
+ * bottom fill the image bits in order. Pixels are still addressed with y 
+ * counted from the bottom. 
+ *
+ * @param bm pointer to bitmap to populate
+ * @param height of image
+ * @param width of image
+ * @param number of bits per pixel
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Shall be called after ConstructBitmapWag(). 
+ */
+BitmapWagError InitializeBitmapWagTopDown(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel);
+
+/**
+ * InitializeBitmapWagExternal initializes a bitmap on pixels the caller 
+ * already has, such as a frame from a camera or renderer, so they can be 
+ * read, edited and written without being copied
+ * 
+ * @param bm bitmap image
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel 
+ * @param pixels first byte of the first row, laid out like the image bits 
+ *        of a bitmap file
+ * @param stride bytes from the start of one row to the next, at least the 
+ *        4 byte padded size of a row, or zero for exactly that
+ * @param options pointer to the options, NULL to leave the pixels with the 
+ *        caller, stored bottom row first, with a black palette
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_BUFFER_TOO_SMALL if 
+ *         stride is less than the size of a row
+ * @note Shall be called after ConstructBitmapWag(). The pixels stay with the
+ *       caller if it fails with anything but 
+ *       BITMAPWAG_COLORUSED_FAILED_TO_ALLOCATE. 
+ * @note Images with a palette find the entries in use from the pixels. 
+ */
+BitmapWagError InitializeBitmapWagExternal(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel,
+    void * pixels, const size_t stride, 
+    const BitmapWagExternalOptions * options);
+
+/**
+ * ReinitializeBitmapWag creates a bitmap file in a bitmap that may already 
+ * hold an image, reusing its buffers when they are large enough
+ *
+ * @param bm pointer to a constructed bitmap struct
+ * @param height of image
+ * @param width of image
+ * @param number of bits per pixel
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Same as ResetBitmapWag followed by InitializeBitmapWag. 
+ */
+BitmapWagError ReinitializeBitmapWag(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel);
+
+/**
+ * InitializeBitmapWagBitfields creates a 16 or 32 bit bitmap whose pixels are 
+ * laid out by channel masks, written as BI_BITFIELDS. For example RGB565 is 
+ * 0xF800, 0x07E0, 0x001F, 0 and ARGB8888 is 0x00FF0000, 0x0000FF00, 
+ * 0x000000FF, 0xFF000000. 
+ *
+ * @param bm pointer to bitmap to populate
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel 16 or 32
+ * @param redMask bits of a pixel holding the red channel
+ * @param greenMask bits of a pixel holding the green channel
+ * @param blueMask bits of a pixel holding the blue channel
+ * @param alphaMask bits of a pixel holding the alpha channel, or zero
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Shall be called after ConstructBitmapWag(). 
+ * @note Each mask shall be one run of bits and no two masks may overlap. 
+ * @note Channels are scaled to and from 0 - 255. Every function that sets 
+ *       pixels to colors sets alpha to 255 and ignores rgbReserved, reading
+ *       pixels returns alpha in rgbReserved. Only BlitBitmapWag between 
+ *       images with the same masks, which copies the pixels as they are, 
+ *       keeps their alpha. 
+ */
+BitmapWagError InitializeBitmapWagBitfields(BitmapWagImg * bm, 
+    const uint32_t height, const uint32_t width, const uint16_t bitsPerPixel, 
+    const uint32_t redMask, const uint32_t greenMask, const uint32_t blueMask,
+    const uint32_t alphaMask);
+
 /**
  * WriteBitmapWag writes a bitmap image file
  *
@@ -138,6 +677,144 @@ BitmapWagError InitializeBitmapWag(BitmapWagImg * bm, const uint32_t height,
  */
 BitmapWagError WriteBitmapWag(const BitmapWagImg * bm, const char * filePath);
 
+/**
+ * WriteBitmapWagIo writes a bitmap image through caller provided I/O 
+ * functions
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param io I/O functions to write the bitmap file with, write is required
+ * @return BITMAPWAG_SUCCESS if successful  
+ */
+BitmapWagError WriteBitmapWagIo(const BitmapWagImg * bm, 
+    const BitmapWagIo * io);
+
+/**
+ * SetBitmapWagWriteOptions sets the options used by every function that 
+ * writes the bitmap. Images start with BITMAPWAG_COMPRESSION_NONE, images 
+ * read from a run length encoded file start with BITMAPWAG_COMPRESSION_RLE. 
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param options options to copy into the bitmap
+ * @return BITMAPWAG_SUCCESS if successful  
+ * @note Writing a run length encoded image with other than 4 or 8 bits per 
+ *       pixel fails with BITMAPWAG_COMPRESSION_NOT_SUPPORTED. 
+ */
+BitmapWagError SetBitmapWagWriteOptions(BitmapWagImg * bm, 
+    const BitmapWagWriteOptions * options);
+
+/**
+ * GetBitmapWagWriteOptions gets the options used when the bitmap is written
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param options pointer to populate with the write options
+ * @return BITMAPWAG_SUCCESS if successful  
+ */
+BitmapWagError GetBitmapWagWriteOptions(const BitmapWagImg * bm, 
+    BitmapWagWriteOptions * options);
+
+/**
+ * GetBitmapWagEncodedSize gets the number of bytes WriteBitmapWag would write
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param size pointer to populate with the size of the bitmap file in bytes
+ * @return BITMAPWAG_SUCCESS if successful  
+ */
+BitmapWagError GetBitmapWagEncodedSize(const BitmapWagImg * bm, 
+    size_t * size);
+
+/**
+ * WriteBitmapWagToBuffer writes the contents of a bitmap file to a buffer 
+ * provided by the caller
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param buffer buffer to write to
+ * @param bufferSize size of buffer in bytes
+ * @param size pointer to populate with the number of bytes the bitmap file 
+ *        takes up, also set when BITMAPWAG_BUFFER_TOO_SMALL is returned
+ * @return BITMAPWAG_SUCCESS if successful  
+ */
+BitmapWagError WriteBitmapWagToBuffer(const BitmapWagImg * bm, 
+    void * buffer, const size_t bufferSize, size_t * size);
+
+/**
+ * WriteBitmapWagToMemory writes the contents of a bitmap file to a newly 
+ * allocated buffer
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param buffer pointer to populate with the buffer, which the caller frees
+ *        with free()
+ * @param size pointer to populate with the size of the buffer in bytes
+ * @return BITMAPWAG_SUCCESS if successful  
+ */
+BitmapWagError WriteBitmapWagToMemory(const BitmapWagImg * bm, 
+    void ** buffer, size_t * size);
+
+/**
+ * WriteBitmapWagAsync queues a bitmap image file to be written by a 
+ * background I/O thread, so the caller never waits on opening, writing or 
+ * closing the file. The I/O thread is started by the first call. 
+ *
+ * @param bm pointer to a Bitmap_img struct
+ * @param filePath path to write the file to, relative or absolute, copied
+ * @param options how the write is queued, NULL copies the image, waits for 
+ *        room in the queue and calls no callback
+ * @param write pointer to populate with a handle to pass to 
+ *        PollBitmapWagWrite and WaitBitmapWagWrite, or NULL to not keep one
+ * @return BITMAPWAG_SUCCESS if the write was queued, the write itself can 
+ *         still fail
+ * @note The image is never written to by the I/O thread, with 
+ *       takeOwnership it shall not be used by the caller once queued. If an 
+ *       error is returned the image stays with the caller. 
+ * @note Nothing is queued without threads, the image is written before 
+ *       WriteBitmapWagAsync returns and the callback is called on the 
+ *       calling thread. 
+ * @note The callback shall not call WaitBitmapWagWrite or 
+ *       FlushBitmapWagWrites or wait for room in the queue. 
+ */
+BitmapWagError WriteBitmapWagAsync(BitmapWagImg * bm, const char * filePath, 
+    const BitmapWagAsyncOptions * options, BitmapWagWrite ** write);
+
+/**
+ * PollBitmapWagWrite checks if a write queued by WriteBitmapWagAsync has 
+ * finished without waiting for it
+ *
+ * @param write handle of the write
+ * @param error pointer to populate with the error of the write once it has 
+ *        finished, may be NULL
+ * @return BITMAPWAG_SUCCESS if the write has finished, 
+ *         BITMAPWAG_WRITE_PENDING if it hasn't
+ */
+BitmapWagError PollBitmapWagWrite(const BitmapWagWrite * write, 
+    BitmapWagError * error);
+
+/**
+ * WaitBitmapWagWrite waits for a write queued by WriteBitmapWagAsync to 
+ * finish and frees its handle
+ *
+ * @param write handle of the write, which shall not be used afterwards
+ * @return the error of the write, BITMAPWAG_SUCCESS if it was written
+ */
+BitmapWagError WaitBitmapWagWrite(BitmapWagWrite * write);
+
+/**
+ * SetBitmapWagWriteQueueDepth sets how many writes may wait in the queue of
+ * WriteBitmapWagAsync, not counting the one being written. Calls finding 
+ * the queue full wait for room, or fail if asked not to. 
+ *
+ * @param depth most writes in the queue, 0 for the default of 64
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError SetBitmapWagWriteQueueDepth(const uint32_t depth);
+
+/**
+ * FlushBitmapWagWrites waits for every write queued by WriteBitmapWagAsync 
+ * to finish, then stops the I/O thread until the next write is queued. 
+ * Handles not yet waited on stay valid. 
+ *
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError FlushBitmapWagWrites(void);
+
 /**
  *  FreeBitmapWag frees memory of a bitmap
  *
@@ -146,6 +823,18 @@ BitmapWagError WriteBitmapWag(const BitmapWagImg * bm, const char * filePath);
  */
 BitmapWagError FreeBitmapWag(BitmapWagImg * bm);
 
+/**
+ * ResetBitmapWag takes a bitmap back to the state ConstructBitmapWag left it
+ * in, so InitializeBitmapWag or ReadBitmapWag can be called on it again. The 
+ * image bits, color palette and colorUsed buffers are kept for them to 
+ * reuse, and only grown when a larger image needs more. 
+ *
+ * @param bm bitmap pointer
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Write options are reset as well. 
+ */
+BitmapWagError ResetBitmapWag(BitmapWagImg * bm);
+
 /**
  * GetBitmapHeightWag gets the height of the bitmap
  * 
@@ -162,6 +851,78 @@ uint32_t GetBitmapWagHeight(const BitmapWagImg * bm);
  */
 uint32_t GetBitmapWagWidth(const BitmapWagImg * bm);
 
+/**
+ * GetBitmapWagBitsPerPixel gets the bits per pixel of the bitmap
+ * 
+ * @param bm bitmap image
+ * @return number of bits per pixel, 0 if the bitmap is not initialized
+ */
+uint16_t GetBitmapWagBitsPerPixel(const BitmapWagImg * bm);
+
+/**
+ * GetBitmapWagTopDown gets the order the rows of the bitmap are stored in
+ * 
+ * @param bm bitmap image
+ * @return non-zero if the top row is stored first, as in files with a 
+ *         negative biHeight, zero if the bottom row is
+ */
+uint8_t GetBitmapWagTopDown(const BitmapWagImg * bm);
+
+/**
+ * SetBitmapWagTopDown sets the order the rows of the bitmap are stored and 
+ * written in, reversing the rows in memory if it changes. Pixels keep their
+ * coordinates, y is always counted from the bottom. 
+ *
+ * @param bm pointer to an initialized bitmap
+ * @param topDown non-zero to store the top row first, zero for the bottom
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Top-down bitmaps can't be run length encoded, writing one with 
+ *       BITMAPWAG_COMPRESSION_RLE fails with 
+ *       BITMAPWAG_COMPRESSION_NOT_SUPPORTED. 
+ */
+BitmapWagError SetBitmapWagTopDown(BitmapWagImg * bm, const uint8_t topDown);
+
+/**
+ * GetBitmapWagView gets the image bits of the bitmap, so they can be read and
+ * written without a function call per pixel. Row y, counted from the bottom,
+ * starts at bits + (height - 1 - y)*stride when topDown is non-zero and at 
+ * bits + y*stride otherwise. 
+ *
+ * @param bm pointer to an initialized bitmap
+ * @param view pointer to populate with the view of the bitmap
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note The view is valid until the bitmap is freed, reset, reinitialized or
+ *       its row order is changed with SetBitmapWagTopDown. 
+ * @note After writing palette indices through the view, call 
+ *       SyncBitmapWagView before setting pixels with the library again. 
+ */
+BitmapWagError GetBitmapWagView(BitmapWagImg * bm, BitmapWagView * view);
+
+/**
+ * GetBitmapWagRowPointers fills a table with the first byte of every row of
+ * the bitmap, rows[y] being row y counted from the bottom
+ *
+ * @param bm pointer to an initialized bitmap
+ * @param rows pointer to the table to fill
+ * @param numRows number of entries rows can hold, at least the height
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_BUFFER_TOO_SMALL if 
+ *         numRows is less than the height of the bitmap
+ * @note The table is valid for as long as a view of the bitmap is. 
+ */
+BitmapWagError GetBitmapWagRowPointers(BitmapWagImg * bm, uint8_t ** rows, 
+    const uint32_t numRows);
+
+/**
+ * SyncBitmapWagView finds the palette entries in use again after palette 
+ * indices were written through a view, so SetBitmapWagPixel doesn't hand out
+ * an entry some pixel already uses
+ *
+ * @param bm pointer to an initialized bitmap
+ * @return BITMAPWAG_SUCCESS if successful, images without a palette have 
+ *         nothing to do
+ */
+BitmapWagError SyncBitmapWagView(BitmapWagImg * bm);
+
 /**
  * SetBitmapWagPixel sets a pixel on the bitmap to the specified color
  *
@@ -172,6 +933,8 @@ uint32_t GetBitmapWagWidth(const BitmapWagImg * bm);
  * @param g green component
  * @param b blue component 
  * @return BITMAPWAG_SUCCESS if successful
+ * @note Images with an alpha mask get a fully opaque pixel, see 
+ *       InitializeBitmapWagBitfields. 
  */
 BitmapWagError SetBitmapWagPixel(BitmapWagImg * bm, const uint32_t x, 
     const uint32_t y, const uint8_t r, const uint8_t g, const uint8_t b);
@@ -188,6 +951,339 @@ BitmapWagError SetBitmapWagPixel(BitmapWagImg * bm, const uint32_t x,
 BitmapWagError GetBitmapWagPixel(const BitmapWagImg * bm, 
     const uint32_t x, const uint32_t y, BitmapWagRgbQuad * color);
 
+/**
+ * SetBitmapWagSpan sets a horizontal run of pixels on one row of the bitmap. 
+ * The arguments are validated once for the whole run, so this is much faster
+ * than calling SetBitmapWagPixel for every pixel. 
+ *
+ * @param bm pointer to the bitmap image
+ * @param x0 horizontal coordinate of the first pixel (from left)
+ * @param y vertical coordinate of the row (from bottom)
+ * @param colors array of count colors, rgbReserved is ignored
+ * @param count number of pixels to set
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note If the color palette runs out of space part way through the run, the
+ *       pixels before it are set and BITMAPWAG_PALETTE_NOT_WRITTEN is returned
+ * @note Images with an alpha mask get fully opaque pixels, as with 
+ *       SetBitmapWagPixel. 
+ */
+BitmapWagError SetBitmapWagSpan(BitmapWagImg * bm, const uint32_t x0, 
+    const uint32_t y, const BitmapWagRgbQuad * colors, const uint32_t count);
+
+/**
+ * SetBitmapWagRow sets every pixel on one row of the bitmap
+ *
+ * @param bm pointer to the bitmap image
+ * @param y vertical coordinate of the row (from bottom)
+ * @param colors array of GetBitmapWagWidth(bm) colors, rgbReserved is 
+ *        ignored
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError SetBitmapWagRow(BitmapWagImg * bm, const uint32_t y, 
+    const BitmapWagRgbQuad * colors);
+
+/**
+ * GetBitmapWagSpan gets the colors of a horizontal run of pixels on one row
+ *
+ * @param bm pointer to a bitmap struct
+ * @param x0 horizontal coordinate of the first pixel (from left)
+ * @param y vertical coordinate of the row (from bottom)
+ * @param colors array of count colors to populate
+ * @param count number of pixels to get
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError GetBitmapWagSpan(const BitmapWagImg * bm, const uint32_t x0, 
+    const uint32_t y, BitmapWagRgbQuad * colors, const uint32_t count);
+
+/**
+ * FillBitmapWagRect sets every pixel in a rectangle to one color
+ *
+ * @param bm pointer to the bitmap image
+ * @param x horizontal coordinate of the left edge of the rectangle
+ * @param y vertical coordinate of the bottom edge of the rectangle
+ * @param w width of the rectangle
+ * @param h height of the rectangle
+ * @param color color to fill the rectangle with, rgbReserved is ignored
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Images with an alpha mask are filled fully opaque, see 
+ *       InitializeBitmapWagBitfields. 
+ */
+BitmapWagError FillBitmapWagRect(BitmapWagImg * bm, const uint32_t x, 
+    const uint32_t y, const uint32_t w, const uint32_t h, 
+    const BitmapWagRgbQuad color);
+
+/**
+ * BlitBitmapWag copies a rectangle of pixels from one bitmap to another. 
+ * Rows are copied whole when both bitmaps have the same format, otherwise 
+ * every pixel is converted to the format of dst. Palette colors of src that 
+ * are missing from the palette of dst are added to it. Converted pixels of 
+ * images with an alpha mask are fully opaque, as with SetBitmapWagSpan. 
+ *
+ * @param dst pointer to the bitmap to copy the pixels to
+ * @param dx horizontal coordinate of the left edge of the rectangle in dst
+ * @param dy vertical coordinate of the bottom edge of the rectangle in dst
+ * @param src pointer to the bitmap to copy the pixels from, may be dst
+ * @param sx horizontal coordinate of the left edge of the rectangle in src
+ * @param sy vertical coordinate of the bottom edge of the rectangle in src
+ * @param w width of the rectangle
+ * @param h height of the rectangle
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError BlitBitmapWag(BitmapWagImg * dst, const uint32_t dx, 
+    const uint32_t dy, const BitmapWagImg * src, const uint32_t sx, 
+    const uint32_t sy, const uint32_t w, const uint32_t h);
+
+/**
+ * ConvertBitmapWag converts a bitmap to a different number of bits per pixel.
+ * Every pixel of dst gets the color GetBitmapWagPixel returns for src. 
+ *
+ * @param src bitmap to convert
+ * @param dst constructed bitmap that is initialized to the size of src
+ * @param bitsPerPixel number of bits per pixel of dst
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_PALETTE_NOT_WRITTEN if 
+ *         src has more colors than the palette of dst can hold
+ * @note Shall be called after ConstructBitmapWag() on dst. 
+ */
+BitmapWagError ConvertBitmapWag(const BitmapWagImg * src, BitmapWagImg * dst,
+    const uint16_t bitsPerPixel);
+
+/**
+ * QuantizeBitmapWag converts a bitmap with any number of colors to a palette 
+ * bitmap. The palette is built by median cut over a histogram of the colors 
+ * of src with 5 bits per channel, and pixels find their palette color 
+ * through a 32x32x32 inverse color map. When src has no more colors than the
+ * palette can hold and no two of them share a histogram cell, they are used 
+ * exactly and no dithering is applied. 
+ *
+ * @param src bitmap to quantize
+ * @param dst constructed bitmap that is initialized to the size of src
+ * @param bitsPerPixel number of bits per pixel of dst, 1, 2, 4 or 8
+ * @param options palette size and dithering, NULL for a full palette 
+ *        without dithering
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Shall be called after ConstructBitmapWag() on dst. Palette entries 
+ *       past maxColors are left unused for SetBitmapWagPixel. 
+ */
+BitmapWagError QuantizeBitmapWag(const BitmapWagImg * src, BitmapWagImg * dst,
+    const uint16_t bitsPerPixel, const BitmapWagQuantizeOptions * options);
+
+/**
+ * BeginBitmapWagStream starts writing a bitmap image file one row at a time. 
+ * The headers and color palette are written straight away, after that only 
+ * a bounded buffer of rows is held in memory, so images larger than memory 
+ * can be written. 
+ *
+ * @param stream pointer to the stream pointer to populate
+ * @param filePath path to write the file to, relative or absolute.
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel
+ * @param palette color palette of the image, ignored when bitsPerPixel is 
+ *        greater than 8
+ * @param numColors number of colors in palette, zero for 1 << bitsPerPixel
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note If *stream is not NULL after an error, EndBitmapWagStream still needs
+ *       to be called on it. 
+ */
+BitmapWagError BeginBitmapWagStream(BitmapWagStream ** stream, 
+    const char * filePath, const uint32_t height, const uint32_t width, 
+    const uint16_t bitsPerPixel, const BitmapWagRgbQuad * palette, 
+    const uint32_t numColors);
+
+/**
+ * BeginBitmapWagStreamIo starts writing a bitmap image one row at a time 
+ * through caller provided I/O functions, see BeginBitmapWagStream
+ *
+ * @param stream pointer to the stream pointer to populate
+ * @param io I/O functions to write the bitmap file with, write is required
+ * @param height of image
+ * @param width of image
+ * @param bitsPerPixel number of bits per pixel
+ * @param palette color palette of the image, ignored when bitsPerPixel is 
+ *        greater than 8
+ * @param numColors number of colors in palette, zero for 1 << bitsPerPixel
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError BeginBitmapWagStreamIo(BitmapWagStream ** stream, 
+    const BitmapWagIo * io, const uint32_t height, const uint32_t width, 
+    const uint16_t bitsPerPixel, const BitmapWagRgbQuad * palette, 
+    const uint32_t numColors);
+
+/**
+ * GetBitmapWagStreamRowMemory gets the size of one row of the image in bytes,
+ * including the padding at the end of the row
+ *
+ * @param stream pointer to a bitmap stream
+ * @return size of a row in bytes
+ */
+uint32_t GetBitmapWagStreamRowMemory(const BitmapWagStream * stream);
+
+/**
+ * PushBitmapWagRows writes rows of image bits in file order, the bottom row 
+ * of the image first
+ *
+ * @param stream pointer to a bitmap stream
+ * @param rows numRows rows, each GetBitmapWagStreamRowMemory(stream) bytes
+ * @param numRows number of rows to write
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError PushBitmapWagRows(BitmapWagStream * stream, 
+    const uint8_t * rows, const uint32_t numRows);
+
+/**
+ * PushBitmapWagRowColors writes the next row of the image from an array of 
+ * colors
+ *
+ * @param stream pointer to a bitmap stream
+ * @param colors array of width colors, rgbReserved is ignored
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note When a color palette is used every color has to be in the palette 
+ *       given to BeginBitmapWagStream, otherwise 
+ *       BITMAPWAG_PALETTE_NOT_WRITTEN is returned. Colors match palette 
+ *       entries on red, green and blue, whatever their rgbReserved. 
+ */
+BitmapWagError PushBitmapWagRowColors(BitmapWagStream * stream, 
+    const BitmapWagRgbQuad * colors);
+
+/**
+ * EndBitmapWagStream finishes writing the file and frees the stream
+ *
+ * @param stream pointer to a bitmap stream
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_STREAM_INCOMPLETE if 
+ *         fewer rows than the height of the image were pushed
+ */
+BitmapWagError EndBitmapWagStream(BitmapWagStream * stream);
+
+/**
+ * OpenBitmapWagReader starts reading a bitmap image file one batch of rows at
+ * a time. The headers and color palette are read straight away, after that 
+ * only one batch of rows is held in memory. 
+ *
+ * @param reader pointer to the reader pointer to populate
+ * @param filePath path to read a file from, relative or absolute.
+ * @param rowsPerBatch number of rows read from the file at a time, zero to 
+ *        pick a batch size of about one megabyte
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError OpenBitmapWagReader(BitmapWagReader ** reader, 
+    const char * filePath, const uint32_t rowsPerBatch);
+
+/**
+ * OpenBitmapWagReaderIo starts reading a bitmap image one batch of rows at a
+ * time through caller provided I/O functions, see OpenBitmapWagReader
+ *
+ * @param reader pointer to the reader pointer to populate
+ * @param io I/O functions to read the bitmap file with, read is required
+ * @param rowsPerBatch number of rows read at a time, zero to pick a batch 
+ *        size of about one megabyte
+ * @return BITMAPWAG_SUCCESS if successful
+ * @note Without seek, the bytes between the palette and bfOffBits are read 
+ *       and discarded. 
+ */
+BitmapWagError OpenBitmapWagReaderIo(BitmapWagReader ** reader, 
+    const BitmapWagIo * io, const uint32_t rowsPerBatch);
+
+/**
+ * GetBitmapWagReaderWidth gets the width of the image being read
+ * 
+ * @param reader pointer to a bitmap reader
+ * @return width of bitmap image
+ */
+uint32_t GetBitmapWagReaderWidth(const BitmapWagReader * reader);
+
+/**
+ * GetBitmapWagReaderHeight gets the height of the image being read
+ * 
+ * @param reader pointer to a bitmap reader
+ * @return height of bitmap image
+ */
+uint32_t GetBitmapWagReaderHeight(const BitmapWagReader * reader);
+
+/**
+ * GetBitmapWagReaderBitsPerPixel gets the bits per pixel of the image being 
+ * read
+ * 
+ * @param reader pointer to a bitmap reader
+ * @return number of bits per pixel
+ */
+uint16_t GetBitmapWagReaderBitsPerPixel(const BitmapWagReader * reader);
+
+/**
+ * GetBitmapWagReaderTopDown gets the order the rows of the image being read 
+ * are stored in, which is the order they are handed out in
+ * 
+ * @param reader pointer to a bitmap reader
+ * @return non-zero if the top row comes first, zero if the bottom row does
+ */
+uint8_t GetBitmapWagReaderTopDown(const BitmapWagReader * reader);
+
+/**
+ * GetBitmapWagReaderRowMemory gets the size of one row of the image in bytes,
+ * including the padding at the end of the row
+ *
+ * @param reader pointer to a bitmap reader
+ * @return size of a row in bytes
+ */
+uint32_t GetBitmapWagReaderRowMemory(const BitmapWagReader * reader);
+
+/**
+ * GetBitmapWagReaderPalette gets the color palette of the image being read
+ *
+ * @param reader pointer to a bitmap reader
+ * @param palette pointer to populate with the color palette
+ * @param numColors pointer to populate with the number of palette entries
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_NO_COLOR_PALETTE if the
+ *         image does not use a color palette
+ */
+BitmapWagError GetBitmapWagReaderPalette(const BitmapWagReader * reader, 
+    const BitmapWagRgbQuad ** palette, uint32_t * numColors);
+
+/**
+ * NextBitmapWagRows gets the next batch of rows in file order, the bottom row
+ * of the image first unless GetBitmapWagReaderTopDown says otherwise
+ *
+ * @param reader pointer to a bitmap reader
+ * @param rows pointer to populate with the first row of the batch, rows are 
+ *        GetBitmapWagReaderRowMemory(reader) bytes apart
+ * @param numRows pointer to populate with the number of rows in the batch
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_END_OF_IMAGE once every
+ *         row has been handed out
+ * @note The rows are only valid until the next call on the reader. 
+ */
+BitmapWagError NextBitmapWagRows(BitmapWagReader * reader, 
+    const uint8_t ** rows, uint32_t * numRows);
+
+/**
+ * NextBitmapWagRow gets the next row in file order
+ *
+ * @param reader pointer to a bitmap reader
+ * @param row pointer to populate with the row
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_END_OF_IMAGE once every
+ *         row has been handed out
+ * @note The row is only valid until the next call on the reader. 
+ */
+BitmapWagError NextBitmapWagRow(BitmapWagReader * reader, 
+    const uint8_t ** row);
+
+/**
+ * NextBitmapWagRowColors gets the colors of the next row in file order
+ *
+ * @param reader pointer to a bitmap reader
+ * @param colors array of width colors to populate
+ * @return BITMAPWAG_SUCCESS if successful, BITMAPWAG_END_OF_IMAGE once every
+ *         row has been handed out
+ */
+BitmapWagError NextBitmapWagRowColors(BitmapWagReader * reader, 
+    BitmapWagRgbQuad * colors);
+
+/**
+ * CloseBitmapWagReader closes the file and frees the reader
+ *
+ * @param reader pointer to a bitmap reader
+ * @return BITMAPWAG_SUCCESS if successful
+ */
+BitmapWagError CloseBitmapWagReader(BitmapWagReader * reader);
+
 // Added to make library compatible with C and C++. 
 #ifdef __cplusplus
 }